@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cmdline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Measures the throughput of "line_parse" followed by "line_reset" over a corpus
+ * of short, long, heavily-quoted and many-pipe lines
+ *
+ * One tab separated line is printed per case, so that the results of two versions
+ * of libcmdline.so can be compared (LD_LIBRARY_PATH selects the library)
+ *
+ * usage: bench_cmdline [minimal number of bytes parsed per case, in MiB]
+ */
+
+/**
+ * Line of the corpus
+ */
+struct bench_case {
+  const char *name;
+  char *str;
+};
+
+/**
+ * Returns the current time in nanoseconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Returns a line made of "n" copies of "word", followed by "last"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static char *repeat(const char *first, const char *word, size_t n, const char *last) {
+  size_t len = strlen(first) + n * strlen(word) + strlen(last) + 1;
+  char *str = malloc(len);
+  if (str == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  char *p = stpcpy(str, first);
+  for (size_t i = 0; i < n; ++i) {
+    p = stpcpy(p, word);
+  }
+  strcpy(p, last);
+  return str;
+}
+
+/**
+ * Returns the number of allocations made so far by a struct line
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static size_t allocs(const struct line *li) {
+  return li->arena.n_allocs + li->n_allocs;
+}
+
+int main(int argc, char *argv[]) {
+  double mib = argc > 1 ? atof(argv[1]) : 64;
+  struct bench_case corpus[] = {
+    { "short", repeat("ls -l", "", 0, "\n") },
+    { "redirect", repeat("sort -r -n < input.txt > output.txt &", "", 0, "\n") },
+    { "long", repeat("echo", " argument", 1000, "\n") },
+    { "quoted", repeat("echo", " \"a quoted argument with  several   spaces\"", 200, "\n") },
+    { "pipes", repeat("cat file.txt", " | grep -v foo", 64, " > out.txt\n") },
+    { "huge", repeat("printf", " word \"quoted words\"", 50000, "\n") },
+  };
+  size_t n_cases = sizeof(corpus) / sizeof(corpus[0]);
+
+  printf("case\tbytes\tlines\tns_per_line\tmb_per_s\tallocs_first\tallocs_per_line\n");
+  for (size_t c = 0; c < n_cases; ++c) {
+    const char *str = corpus[c].str;
+    size_t bytes = strlen(str);
+    size_t lines = mib * (1 << 20) / bytes + 1;
+
+    struct line li;
+    line_init(&li);
+
+    /* the first line allocates the arrays and the arena, the next ones reuse them */
+    if (line_parse(&li, str) == -1) {
+      fprintf(stderr, "%s: parse error\n", corpus[c].name);
+      return 1;
+    }
+    size_t first = allocs(&li);
+    line_reset(&li);
+
+    size_t before = allocs(&li);
+    double start = now_ns();
+    for (size_t i = 0; i < lines; ++i) {
+      line_parse(&li, str);
+      line_reset(&li);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("%s\t%zu\t%zu\t%.1f\t%.1f\t%zu\t%.3f\n", corpus[c].name, bytes, lines,
+           elapsed / lines, bytes * lines / (elapsed / 1e9) / 1e6, first,
+           (double) (allocs(&li) - before) / lines);
+    fflush(stdout);
+    line_destroy(&li);
+    free(corpus[c].str);
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+#define _GNU_SOURCE
+#include "complete.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Measures the completion of the command names with a large PATH directory
+ *
+ * A temporary directory of "executables" empty executable files is the only one in
+ * PATH. The time to build the trie at the first completion, the mean and maximal
+ * time of "completions" completions of random prefixes, then the time of the first
+ * completion once an executable was added (the directory being read again), are
+ * printed as a tab separated line.
+ *
+ * usage: bench_complete [number of executables] [number of completions]
+ */
+
+static const char *const words[] = { "git", "make", "grep", "find", "python", "perl", "ssh", "tar" };
+
+/**
+ * Returns the current time in microseconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Creates an empty executable file
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void make_executable(const char *dir, const char *name) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  int fd = open(path, O_WRONLY | O_CREAT, 0700);
+  if (fd == -1) {
+    perror(path);
+    exit(1);
+  }
+  close(fd);
+}
+
+/**
+ * Sets the modification time of a directory in the past, as for the directories of
+ * PATH, else it is read again at each completion during the two first seconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void make_old(const char *dir, time_t age) {
+  struct timespec times[2] = { { .tv_nsec = UTIME_OMIT }, { .tv_sec = time(NULL) - age } };
+  utimensat(AT_FDCWD, dir, times, 0);
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_exec = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+  size_t n_completions = argc > 2 ? strtoul(argv[2], NULL, 10) : 10000;
+  size_t n_words = sizeof(words) / sizeof(words[0]);
+
+  char dir[] = "/tmp/bench_completeXXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char name[64];
+  for (size_t i = 0; i < n_exec; ++i) {
+    snprintf(name, sizeof(name), "%s-%zx", words[i % n_words], i * 2654435761u % 1000003);
+    make_executable(dir, name);
+  }
+  make_old(dir, 3600);
+  char *old_path = getenv("PATH") ? strdup(getenv("PATH")) : NULL;
+  setenv("PATH", dir, 1);
+
+  struct dircache cache;
+  struct completion c;
+  if (dircache_init(&cache, DIRCACHE_BUDGET) == -1 || complete_init(&c, NULL, 0, &cache) == -1) {
+    return 1;
+  }
+  char insert[256];
+  double start = now_us();
+  complete_word(&c, "gi", 2, insert, sizeof(insert));
+  double build = now_us() - start;
+
+  double total = 0, worst = 0;
+  size_t matches = 0;
+  srand(1);
+  for (size_t i = 0; i < n_completions; ++i) {
+    /* a prefix of 1 to 6 characters of a name */
+    const char *w = words[rand() % n_words];
+    snprintf(name, sizeof(name), "%s-%x", w, rand() % 16);
+    size_t len = 1 + rand() % (strlen(name) < 6 ? strlen(name) : 6);
+    name[len] = '\0';
+    start = now_us();
+    matches += complete_word(&c, name, len, insert, sizeof(insert));
+    double t = now_us() - start;
+    total += t;
+    worst = t > worst ? t : worst;
+  }
+
+  /* the mtime of the directory changes : the names are read again and merged */
+  make_executable(dir, "zz-new-command");
+  make_old(dir, 60);
+  start = now_us();
+  size_t found = complete_word(&c, "zz-", 3, insert, sizeof(insert));
+  double update = now_us() - start;
+
+  printf("executables\tbuild_ms\tcompletions\tmean_us\tmax_us\tupdate_ms\tnew_found\n");
+  printf("%zu\t%.2f\t%zu\t%.2f\t%.1f\t%.2f\t%s\n", n_exec, build / 1e3, n_completions,
+         total / n_completions, worst, update / 1e3, found == 1 && strcmp(insert, "new-command ") == 0 ? "yes" : "no");
+  (void) matches;
+
+  complete_destroy(&c);
+  dircache_destroy(&cache);
+  if (old_path != NULL) {
+    setenv("PATH", old_path, 1);
+    free(old_path);
+  }
+  char cmd[64 + sizeof(dir)];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  return system(cmd) == 0 ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+#define _GNU_SOURCE
+#include "expand.h"
+
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Compares the glob expansion of FiSH with glob(3) on a large tree of files
+ *
+ * The tree holds "files" empty files spread over 1000 directories, half of them
+ * ending with ".c", the other half with ".h". Each pattern is expanded "rounds"
+ * times by both engines, the best time being kept ; both must find the same number
+ * of paths. glob(3) has no "**" : these patterns are only run by FiSH. FiSH is
+ * measured twice : reading the directories each time, then with a warm directory
+ * cache. A tab separated line is printed per pattern.
+ *
+ * usage: bench_glob [number of files] [rounds] [existing tree]
+ */
+
+#define N_DIRS 1000
+
+/**
+ * Returns the current time in seconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Creates the tree of "n_files" files in the directory "root"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void make_tree(const char *root, size_t n_files) {
+  char path[256];
+  for (size_t d = 0; d < N_DIRS; ++d) {
+    snprintf(path, sizeof(path), "%s/d%03zu", root, d);
+    mkdir(path, 0700);
+  }
+  for (size_t i = 0; i < n_files; ++i) {
+    snprintf(path, sizeof(path), "%s/d%03zu/f%07zu.%c", root, i % N_DIRS, i, i % 2 ? 'h' : 'c');
+    int fd = open(path, O_WRONLY | O_CREAT, 0600);
+    if (fd == -1) {
+      perror(path);
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_files = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 3;
+  char root[] = "/tmp/bench_globXXXXXX";
+  bool made = argc <= 3;
+  if (!made) {
+    snprintf(root, sizeof(root), "%s", argv[3]);
+  } else if (mkdtemp(root) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  } else {
+    fprintf(stderr, "creating %zu files in %s\n", n_files, root);
+    make_tree(root, n_files);
+  }
+  if (chdir(root) == -1) {
+    perror(root);
+    return 1;
+  }
+
+  static const char *patterns[] = {
+    "d000/*",
+    "*/*.c",
+    "d00?/f[0-4]*.h",
+    "d[!0]*/*7.?",
+    "**/*98.c",
+  };
+  printf("pattern\tpaths\tfish_s\tcached_s\tglob3_s\tspeedup\tcached_speedup\n");
+  struct expansion e;
+  expand_init(&e);
+  struct expansion cached;
+  expand_init(&cached);
+  static struct dircache cache;
+  if (dircache_init(&cache, (size_t) 1 << 30) == -1) {
+    return 1;
+  }
+  cached.cache = &cache;
+  for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+    const char *pattern = patterns[p];
+    bool globstar = strstr(pattern, "**") != NULL;
+    double best_fish = 1e9, best_cached = 1e9, best_glob = 1e9;
+    ssize_t n_fish = 0;
+    size_t n_glob = 0;
+    expand_glob(&cached, pattern);
+    for (int r = 0; r < rounds; ++r) {
+      double start = now_s();
+      n_fish = expand_glob(&e, pattern);
+      double t = now_s() - start;
+      best_fish = t < best_fish ? t : best_fish;
+      start = now_s();
+      ssize_t n_cached = expand_glob(&cached, pattern);
+      t = now_s() - start;
+      best_cached = t < best_cached ? t : best_cached;
+      if (n_cached != n_fish) {
+        fprintf(stderr, "%s: %zd paths with the cache instead of %zd\n", pattern, n_cached, n_fish);
+      }
+      if (globstar) {
+        continue;
+      }
+      glob_t g;
+      start = now_s();
+      int err = glob(pattern, 0, NULL, &g);
+      t = now_s() - start;
+      best_glob = t < best_glob ? t : best_glob;
+      n_glob = err == 0 ? g.gl_pathc : 0;
+      globfree(&g);
+    }
+    if (globstar) {
+      printf("%s\t%zd\t%.4f\t%.4f\t-\t-\t-\n", pattern, n_fish, best_fish, best_cached);
+    } else {
+      printf("%s\t%zd\t%.4f\t%.4f\t%.4f\t%.2f\t%.2f%s\n", pattern, n_fish, best_fish, best_cached, best_glob,
+             best_glob / best_fish, best_glob / best_cached, n_fish == (ssize_t) n_glob ? "" : "\tMISMATCH");
+    }
+    fflush(stdout);
+  }
+  expand_destroy(&cached);
+  dircache_destroy(&cache);
+  expand_destroy(&e);
+
+  if (made) {
+    fprintf(stderr, "removing %s\n", root);
+    char path[256];
+    for (size_t i = 0; i < n_files; ++i) {
+      snprintf(path, sizeof(path), "d%03zu/f%07zu.%c", i % N_DIRS, i, i % 2 ? 'h' : 'c');
+      unlink(path);
+    }
+    for (size_t d = 0; d < N_DIRS; ++d) {
+      snprintf(path, sizeof(path), "d%03zu", d);
+      rmdir(path);
+    }
+    rmdir(root);
+  }
+  return 0;
+}
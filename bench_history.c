@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+#include "history.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Measures the history with a large file
+ *
+ * A temporary history file of "entries" command lines is written, then the time
+ * to open it and index its offsets, to append an entry, to find the newest entry
+ * starting with a prefix (Up key), and to find the entries containing a text
+ * (Ctrl-R) are printed as tab separated lines. The searches are made for a text
+ * only in the oldest entry and for a text in no entry, "searches" times each : the
+ * time of the first one, the mean time and the time of the last one (each search
+ * building some more filters of the blocks) are compared with a memmem over the
+ * whole file.
+ *
+ * usage: bench_history [number of entries] [number of searches]
+ */
+
+static const char *const commands[] = { "git commit -m", "make -j8", "grep -rn", "ls -la", "cd", "ssh",
+                                        "vim", "python3", "cat", "find . -name" };
+
+/**
+ * Returns the current time in microseconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Searches a text in the whole file with memmem, from the newest entry, as without index
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static const char *scan(const char *map, size_t size, const char *text) {
+  const char *found = NULL;
+  for (const char *p = map; (p = memmem(p, map + size - p, text, strlen(text))) != NULL; ++p) {
+    found = p;
+  }
+  return found;
+}
+
+/**
+ * Prints the time of the first of "n" searches of a text, their mean time and the
+ * time of the last one, once the filters are built, and the time of a memmem
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void bench_search(struct history *h, const char *what, const char *text, int flags, size_t n) {
+  double first = 0, last = 0, total = 0;
+  ssize_t found = -1;
+  for (size_t i = 0; i < n; ++i) {
+    double start = now_us();
+    found = history_search(h, text, strlen(text), SSIZE_MAX, flags);
+    last = now_us() - start;
+    first = i == 0 ? last : first;
+    total += last;
+  }
+  double start = now_us();
+  scan(h->map, h->map_size, text);
+  double memmem_us = now_us() - start;
+  printf("%s\t%zd\t%.1f\t%.1f\t%.1f\t%.1f\n", what, found, first, total / n, last, memmem_us);
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_entries = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  size_t n_searches = argc > 2 ? strtoul(argv[2], NULL, 10) : 50;
+  size_t n_commands = sizeof(commands) / sizeof(commands[0]);
+
+  char path[] = "/tmp/bench_historyXXXXXX";
+  int fd = mkstemp(path);
+  FILE *f = fdopen(fd, "w");
+  if (f == NULL) {
+    perror(path);
+    return 1;
+  }
+  srand(1);
+  fprintf(f, "echo the-oldest-entry\n");
+  for (size_t i = 1; i < n_entries; ++i) {
+    fprintf(f, "%s file%d.c dir%d/%x\n", commands[rand() % n_commands], rand() % 1000, rand() % 100, rand());
+  }
+  fclose(f);
+
+  struct history h;
+  double start = now_us();
+  if (history_open(&h, path) == -1) {
+    perror(path);
+    return 1;
+  }
+  double open_ms = (now_us() - start) / 1e3;
+  start = now_us();
+  size_t n = history_size(&h);
+  double index_ms = (now_us() - start) / 1e3;
+  start = now_us();
+  size_t n_adds = 1000;
+  char line[64];
+  for (size_t i = 0; i < n_adds; ++i) {
+    snprintf(line, sizeof(line), "echo appended %zu", i);
+    history_add(&h, line);
+  }
+  double add_us = (now_us() - start) / n_adds;
+
+  printf("entries\topen_ms\tindex_ms\tappend_us\n");
+  printf("%zu\t%.3f\t%.1f\t%.1f\n", n, open_ms, index_ms, add_us);
+  printf("search\tfound\tfirst_us\tmean_us\tlast_us\tmemmem_us\n");
+  bench_search(&h, "prefix", "git commit", HISTORY_PREFIX, n_searches);
+  bench_search(&h, "oldest", "the-oldest", 0, n_searches);
+  bench_search(&h, "none", "not-in-history", 0, n_searches);
+
+  history_close(&h);
+  unlink(path);
+  return 0;
+}
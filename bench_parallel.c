@@ -0,0 +1,125 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * Measures how the parallel internal command of FiSH scales with its width,
+ * running CPU-bound jobs (sha256sum of a file held in the page cache)
+ *
+ * For each width, from 1 to twice the number of online CPUs, the wall time,
+ * the number of jobs per second and the speedup over a width of 1 are printed
+ * as a tab separated line
+ *
+ * usage: bench_parallel [number of jobs] [size of the file in MiB] [path of fish]
+ */
+
+#define BUF_SIZE (1 << 20)
+
+extern char **environ;
+
+/**
+ * Returns the current time in seconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Creates a temporary file from "template", filled with "size" bytes of "c"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void make_file(char *template, size_t size, char c) {
+  int fd = mkstemp(template);
+  if (fd == -1) {
+    perror("mkstemp");
+    exit(1);
+  }
+  char *buf = malloc(BUF_SIZE);
+  memset(buf, c, BUF_SIZE);
+  for (size_t done = 0; done < size; done += BUF_SIZE) {
+    size_t n = size - done < BUF_SIZE ? size - done : BUF_SIZE;
+    if (write(fd, buf, n) != (ssize_t) n) {
+      perror("write");
+      exit(1);
+    }
+  }
+  free(buf);
+  close(fd);
+}
+
+/**
+ * Runs "fish -c cmdline", its output being discarded
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the wall time in seconds, -1 on failure
+ */
+static double run(const char *fish, const char *cmdline) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+  char *argv[] = { (char *) fish, "-c", (char *) cmdline, NULL };
+  double start = now_s();
+  pid_t pid;
+  int err = posix_spawn(&pid, fish, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    fprintf(stderr, "%s: %s\n", fish, strerror(err));
+    return -1;
+  }
+  int wstatus;
+  waitpid(pid, &wstatus, 0);
+  if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+    fprintf(stderr, "%s -c '%s' failed\n", fish, cmdline);
+    return -1;
+  }
+  return now_s() - start;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_jobs = argc > 1 ? strtoul(argv[1], NULL, 10) : 32;
+  size_t mib = argc > 2 ? strtoul(argv[2], NULL, 10) : 64;
+  const char *fish = argc > 3 ? argv[3] : "./fish";
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  /* the data hashed by every job, and the list of the jobs given to parallel */
+  char data[] = "/tmp/bench_parallelXXXXXX";
+  make_file(data, mib << 20, 'a');
+  char list[] = "/tmp/bench_parallelXXXXXX";
+  make_file(list, 0, 0);
+  FILE *f = fopen(list, "w");
+  for (size_t i = 0; i < n_jobs; ++i) {
+    fprintf(f, "%s\n", data);
+  }
+  fclose(f);
+
+  printf("cpus\twidth\tjobs\twall_s\tjobs_per_s\tspeedup\n");
+  double base = 0;
+  for (long width = 1; width <= 2 * n_cpus || width <= 4; width *= 2) {
+    char cmdline[128 + sizeof(list)];
+    sprintf(cmdline, "parallel -j %ld sha256sum < %s", width, list);
+    double wall = run(fish, cmdline);
+    if (wall < 0) {
+      break;
+    }
+    if (width == 1) {
+      base = wall;
+    }
+    printf("%ld\t%ld\t%zu\t%.3f\t%.2f\t%.2f\n", n_cpus, width, n_jobs, wall, n_jobs / wall, base / wall);
+    fflush(stdout);
+  }
+  unlink(data);
+  unlink(list);
+  return 0;
+}
@@ -0,0 +1,153 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * Measures the setup latency and the throughput of pipelines of 1 to 16 "cat" stages
+ * run by FiSH and by /bin/sh through their -c option, over a large file
+ *
+ * FiSH runs with the default capacity of the pipes, then with FISH_PIPE_SIZE set to 256K and 1M.
+ * For each run, the time to the first byte, the total wall time and the throughput
+ * are printed as a tab separated line
+ *
+ * usage: bench_pipeline [size of the data in MiB] [path of fish]
+ */
+
+#define BUF_SIZE (1 << 20)
+
+extern char **environ;
+
+/**
+ * Returns the current time in microseconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Writes "mib" MiB of text in a temporary file and returns its path
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static char *make_data(size_t mib) {
+  static char path[] = "/tmp/bench_pipelineXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    perror("mkstemp");
+    exit(1);
+  }
+  char *buf = malloc(BUF_SIZE);
+  for (size_t i = 0; i < BUF_SIZE; ++i) {
+    buf[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+  }
+  for (size_t i = 0; i < mib; ++i) {
+    if (write(fd, buf, BUF_SIZE) != BUF_SIZE) {
+      perror("write");
+      exit(1);
+    }
+  }
+  free(buf);
+  close(fd);
+  return path;
+}
+
+/**
+ * Runs "shell -c cmdline", reading its output until the end
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @param ttfb set to the time to the first byte, in microseconds
+ * @return the total wall time in microseconds, -1 on failure
+ */
+static double run(const char *shell, const char *cmdline, size_t expected, double *ttfb) {
+  int fds[2];
+  if (pipe(fds) == -1) {
+    perror("pipe");
+    return -1;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+  posix_spawn_file_actions_addclose(&actions, fds[0]);
+  posix_spawn_file_actions_addclose(&actions, fds[1]);
+  char *argv[] = { (char *) shell, "-c", (char *) cmdline, NULL };
+
+  double start = now_us();
+  pid_t pid;
+  int err = posix_spawn(&pid, shell, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (err != 0) {
+    fprintf(stderr, "%s: %s\n", shell, strerror(err));
+    close(fds[0]);
+    return -1;
+  }
+
+  static char buf[BUF_SIZE];
+  size_t total = 0;
+  ssize_t n;
+  *ttfb = -1;
+  while ((n = read(fds[0], buf, BUF_SIZE)) > 0) {
+    if (total == 0) {
+      *ttfb = now_us() - start;
+    }
+    total += n;
+  }
+  close(fds[0]);
+  waitpid(pid, NULL, 0);
+  double wall = now_us() - start;
+  if (total != expected) {
+    fprintf(stderr, "%s: %zu bytes read instead of %zu\n", shell, total, expected);
+    return -1;
+  }
+  return wall;
+}
+
+int main(int argc, char *argv[]) {
+  size_t mib = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+  const char *fish = argc > 2 ? argv[2] : "./fish";
+  /* shell and capacity of its pipes, NULL for the default one */
+  const char *shells[][2] = { { fish, NULL }, { fish, "256K" }, { fish, "1M" }, { "/bin/sh", NULL } };
+
+  char *data = make_data(mib);
+  size_t size = mib << 20;
+  /* "cat data | cat | ... | cat" with 16 stages at most */
+  char cmdline[64 + 16 * sizeof(" | cat")];
+
+  printf("shell\tpipe_size\tstages\tttfb_us\twall_ms\tmb_per_s\n");
+  for (size_t stages = 1; stages <= 16; stages *= 2) {
+    char *p = cmdline + sprintf(cmdline, "cat %s", data);
+    for (size_t i = 1; i < stages; ++i) {
+      p = stpcpy(p, " | cat");
+    }
+    for (size_t s = 0; s < sizeof(shells) / sizeof(shells[0]); ++s) {
+      const char *pipe_size = shells[s][1];
+      if (pipe_size != NULL) {
+        setenv("FISH_PIPE_SIZE", pipe_size, 1);
+      } else {
+        unsetenv("FISH_PIPE_SIZE");
+      }
+      double ttfb;
+      double wall = run(shells[s][0], cmdline, size, &ttfb);
+      if (wall < 0) {
+        unlink(data);
+        return 1;
+      }
+      printf("%s\t%s\t%zu\t%.0f\t%.1f\t%.1f\n", shells[s][0], pipe_size ? pipe_size : "default",
+             stages, ttfb, wall / 1e3, size / wall);
+      fflush(stdout);
+    }
+  }
+  unlink(data);
+  return 0;
+}
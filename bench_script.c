@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+#include "script.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Measures a loop of a script run by the virtual machine, its line being parsed once,
+ * against the same line parsed again on each iteration, the way FiSH ran the lines
+ * before the scripts were compiled
+ *
+ * The lines aren't run : each one is given to a function counting its arguments,
+ * so that only the cost of the parsing and of the loop is measured. The loop of a
+ * case with a variable is the body of a "for", the variable being replaced by its
+ * word each time : the text reparsed is the line with its variable already replaced.
+ * One tab separated line is printed per case and per mode.
+ *
+ * usage: bench_script [number of iterations, 1000000 by default]
+ */
+
+/**
+ * Line of the loop
+ */
+struct bench_case {
+  const char *name;
+  const char *str;
+  const char *var;  // line of the body of a "for w in world", NULL if the case has no variable
+};
+
+static const struct bench_case cases[] = {
+  { "builtin", "true", NULL },
+  { "command", "echo hello world from the loop", NULL },
+  { "pipeline", "cat < input.txt | grep -v foo | sort -r | uniq -c > output.txt", NULL },
+  { "quoted", "printf \"%s %s\\n\" \"a quoted argument\" \"and another one\" > log.txt", NULL },
+  { "variable", "echo hello world from the loop > world.txt", "echo hello $w from the loop > ${w}.txt" },
+};
+
+/**
+ * Number of arguments seen, so that the parsing can't be left out
+ */
+static size_t n_args = 0;
+
+/**
+ * Returns the current time in nanoseconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Counts the arguments of a line parsed, instead of running it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int count_line(struct line *li, const char *text) {
+  (void) text;
+  for (size_t i = 0; i < li->n_cmds; ++i) {
+    n_args += li->cmds[i].n_args;
+  }
+  return 0;
+}
+
+/**
+ * Parses a line in place, then counts its arguments
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int count_text(struct line *li, char *text) {
+  if (line_parse_inplace(li, text) == -1) {
+    return 2;
+  }
+  count_line(li, text);
+  line_reset(li);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+  if (iterations <= 0) {
+    fprintf(stderr, "usage: %s [number of iterations]\n", argv[0]);
+    return 1;
+  }
+  struct line li;
+  line_init(&li);
+  printf("case\tmode\titerations\tns/iteration\n");
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+    size_t len = strlen(cases[c].str);
+
+    /* the line is copied then parsed in place on each iteration */
+    char *buf = line_buffer(&li, len + 1);
+    double start = now_ns();
+    for (long i = 0; i < iterations; ++i) {
+      memcpy(buf, cases[c].str, len + 1);
+      count_text(&li, buf);
+    }
+    double reparsed = (now_ns() - start) / iterations;
+    printf("%s\treparse\t%ld\t%.1f\n", cases[c].name, iterations, reparsed);
+
+    /* the same loop, compiled */
+    char text[256];
+    int text_len = cases[c].var == NULL
+                       ? snprintf(text, sizeof(text), "repeat %ld\n%s\nend\n", iterations, cases[c].str)
+                       : snprintf(text, sizeof(text), "for w in world\nrepeat %ld\n%s\nend\nend\n", iterations,
+                                  cases[c].var);
+    struct script script;
+    if (script_compile(&script, text, text_len) == -1) {
+      return 1;
+    }
+    start = now_ns();
+    script_run(&script, &li, count_text, count_line);
+    double compiled = (now_ns() - start) / iterations;
+    script_destroy(&script);
+    printf("%s\tcompiled\t%ld\t%.1f\n", cases[c].name, iterations, compiled);
+  }
+  line_destroy(&li);
+  fprintf(stderr, "(%zu arguments)\n", n_args);
+  return 0;
+}
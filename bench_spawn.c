@@ -0,0 +1,106 @@
+#define _DEFAULT_SOURCE
+#include "spawn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * Measures the latency of launching and waiting a short program,
+ * with fork + execvp (the former FiSH path) and with spawn_cmd
+ * and the command hash table, while the heap of the process grows
+ *
+ * usage: bench_spawn [iterations] [max heap in MiB]
+ */
+
+/**
+ * Returns the current time in microseconds
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Launches "argv" with fork and execvp, then waits for it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void run_fork(char **argv) {
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("fork");
+    exit(1);
+  }
+  if (pid == 0) {
+    execvp(argv[0], argv);
+    perror(argv[0]);
+    _exit(127);
+  }
+  waitpid(pid, NULL, 0);
+}
+
+/**
+ * Command hash table used by run_spawn
+ */
+static struct path_hash *hash = NULL;
+
+/**
+ * Launches "argv" with spawn_cmd, then waits for it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void run_spawn(char **argv) {
+  pid_t pid = spawn_cmd(hash, argv, 0, 1, NULL, 0, NULL);
+  if (pid == -1) {
+    exit(1);
+  }
+  waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+  size_t max_heap = argc > 2 ? strtoul(argv[2], NULL, 10) : 512;
+  char *cmd[] = { "true", NULL };
+  struct path_hash cmd_hash;
+  path_hash_init(&cmd_hash);
+  hash = &cmd_hash;
+
+  printf("heap_mib\tfork_us\tspawn_us\tspeedup\n");
+  for (size_t heap = 0; heap <= max_heap; heap = heap ? 4 * heap : 16) {
+    /* the pages are touched so that they are really mapped */
+    char *block = NULL;
+    if (heap > 0) {
+      block = malloc(heap << 20);
+      if (block == NULL) {
+        perror("malloc");
+        return 1;
+      }
+      memset(block, 1, heap << 20);
+    }
+
+    double start = now_us();
+    for (int i = 0; i < iterations; ++i) {
+      run_fork(cmd);
+    }
+    double fork_us = (now_us() - start) / iterations;
+
+    start = now_us();
+    for (int i = 0; i < iterations; ++i) {
+      run_spawn(cmd);
+    }
+    double spawn_us = (now_us() - start) / iterations;
+
+    printf("%zu\t%.1f\t%.1f\t%.2f\n", heap, fork_us, spawn_us, fork_us / spawn_us);
+    fflush(stdout);
+    free(block);
+  }
+  path_hash_destroy(&cmd_hash);
+  return 0;
+}
@@ -0,0 +1,741 @@
+#define _GNU_SOURCE
+#include "builtins.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define COPY_CHUNK (1 << 20)
+#define RW_BUF_SIZE (1 << 16)
+
+int builtin_echo(char **args) {
+  assert(args);
+
+  bool newline = true;
+  size_t i = 1;
+  if (args[i] && strcmp(args[i], "-n") == 0) {
+    newline = false;
+    ++i;
+  }
+  for (; args[i]; ++i) {
+    fputs(args[i], stdout);
+    if (args[i + 1]) {
+      putchar(' ');
+    }
+  }
+  if (newline) {
+    putchar('\n');
+  }
+  return ferror(stdout) ? 1 : 0;
+}
+
+int builtin_true(char **args) {
+  (void) args;
+  return 0;
+}
+
+int builtin_false(char **args) {
+  (void) args;
+  return 1;
+}
+
+int builtin_pwd(char **args) {
+  (void) args;
+
+  char *cwd = getcwd(NULL, 0);
+  if (cwd == NULL) {
+    perror("pwd");
+    return 1;
+  }
+  puts(cwd);
+  free(cwd);
+  return 0;
+}
+
+/**
+ * State of the evaluation of a test expression, by recursive descent
+ */
+struct test_eval {
+  char **args;
+  size_t n;
+  size_t pos;
+  bool error;
+};
+
+static bool test_or(struct test_eval *t);
+
+/**
+ * Convert an operand of an arithmetic comparison
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static long long test_integer(struct test_eval *t, const char *str) {
+  char *end;
+  errno = 0;
+  long long value = strtoll(str, &end, 10);
+  if (end == str || *end != '\0' || errno) {
+    fprintf(stderr, "test: %s: integer expression expected\n", str);
+    t->error = true;
+  }
+  return value;
+}
+
+/**
+ * Test if a word is a binary operator of test
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_is_binary(const char *op) {
+  static const char *ops[] = { "=", "!=", "-eq", "-ne", "-gt", "-ge", "-lt", "-le", "-nt", "-ot", "-ef", NULL };
+  for (size_t i = 0; ops[i]; ++i) {
+    if (strcmp(op, ops[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Evaluate a binary expression of test
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_binary(struct test_eval *t, const char *a, const char *op, const char *b) {
+  if (strcmp(op, "=") == 0) {
+    return strcmp(a, b) == 0;
+  }
+  if (strcmp(op, "!=") == 0) {
+    return strcmp(a, b) != 0;
+  }
+  if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+    struct stat sa, sb;
+    bool oka = stat(a, &sa) == 0;
+    bool okb = stat(b, &sb) == 0;
+    if (strcmp(op, "-ef") == 0) {
+      return oka && okb && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+    if (strcmp(op, "-ot") == 0) {
+      const char *tmp = a;
+      a = b;
+      b = tmp;
+      struct stat st = sa;
+      sa = sb;
+      sb = st;
+      bool ok = oka;
+      oka = okb;
+      okb = ok;
+    }
+    if (!oka) {
+      return false;
+    }
+    if (!okb) {
+      return true;
+    }
+    return sa.st_mtim.tv_sec > sb.st_mtim.tv_sec
+      || (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec && sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec);
+  }
+
+  long long x = test_integer(t, a);
+  long long y = test_integer(t, b);
+  if (strcmp(op, "-eq") == 0) {
+    return x == y;
+  }
+  if (strcmp(op, "-ne") == 0) {
+    return x != y;
+  }
+  if (strcmp(op, "-gt") == 0) {
+    return x > y;
+  }
+  if (strcmp(op, "-ge") == 0) {
+    return x >= y;
+  }
+  if (strcmp(op, "-lt") == 0) {
+    return x < y;
+  }
+  return x <= y;
+}
+
+/**
+ * Evaluate a unary expression of test, "op" being "-" followed by one letter
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return true or false, the evaluation being flagged as an error if "op" is unknown
+ */
+static bool test_unary(struct test_eval *t, char op, const char *arg) {
+  struct stat st;
+  switch (op) {
+    case 'n':
+      return arg[0] != '\0';
+    case 'z':
+      return arg[0] == '\0';
+    case 't':
+      return isatty(atoi(arg));
+    case 'h':
+    case 'L':
+      return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    case 'r':
+      return access(arg, R_OK) == 0;
+    case 'w':
+      return access(arg, W_OK) == 0;
+    case 'x':
+      return access(arg, X_OK) == 0;
+    default:
+      break;
+  }
+
+  bool exists = stat(arg, &st) == 0;
+  switch (op) {
+    case 'e':
+      return exists;
+    case 'f':
+      return exists && S_ISREG(st.st_mode);
+    case 'd':
+      return exists && S_ISDIR(st.st_mode);
+    case 'b':
+      return exists && S_ISBLK(st.st_mode);
+    case 'c':
+      return exists && S_ISCHR(st.st_mode);
+    case 'p':
+      return exists && S_ISFIFO(st.st_mode);
+    case 'S':
+      return exists && S_ISSOCK(st.st_mode);
+    case 's':
+      return exists && st.st_size > 0;
+    case 'g':
+      return exists && (st.st_mode & S_ISGID);
+    case 'u':
+      return exists && (st.st_mode & S_ISUID);
+    default:
+      fprintf(stderr, "test: -%c: unary operator expected\n", op);
+      t->error = true;
+      return false;
+  }
+}
+
+/**
+ * Test if a word is a unary operator of test
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_is_unary(const char *op) {
+  return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("nztLhrwxefdbcpSsgu", op[1]);
+}
+
+/**
+ * primary := '(' or ')' | unary-op word | word binary-op word | word
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_primary(struct test_eval *t) {
+  if (t->pos >= t->n) {
+    fprintf(stderr, "test: argument expected\n");
+    t->error = true;
+    return false;
+  }
+  char **a = t->args + t->pos;
+  size_t left = t->n - t->pos;
+
+  if (left >= 3 && test_is_binary(a[1])) {
+    t->pos += 3;
+    return test_binary(t, a[0], a[1], a[2]);
+  }
+  if (left >= 2 && test_is_unary(a[0])) {
+    t->pos += 2;
+    return test_unary(t, a[0][1], a[1]);
+  }
+  if (left >= 2 && strcmp(a[0], "(") == 0) {
+    ++t->pos;
+    bool value = test_or(t);
+    if (t->pos >= t->n || strcmp(t->args[t->pos], ")") != 0) {
+      fprintf(stderr, "test: ')' expected\n");
+      t->error = true;
+      return false;
+    }
+    ++t->pos;
+    return value;
+  }
+  ++t->pos;
+  return a[0][0] != '\0';
+}
+
+/**
+ * not := '!' not | primary
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_not(struct test_eval *t) {
+  if (t->pos + 1 < t->n && strcmp(t->args[t->pos], "!") == 0) {
+    ++t->pos;
+    return !test_not(t);
+  }
+  return test_primary(t);
+}
+
+/**
+ * and := not ('-a' not)*
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_and(struct test_eval *t) {
+  bool value = test_not(t);
+  while (t->pos < t->n && strcmp(t->args[t->pos], "-a") == 0) {
+    ++t->pos;
+    bool right = test_not(t);
+    value = value && right;
+  }
+  return value;
+}
+
+/**
+ * or := and ('-o' and)*
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool test_or(struct test_eval *t) {
+  bool value = test_and(t);
+  while (t->pos < t->n && strcmp(t->args[t->pos], "-o") == 0) {
+    ++t->pos;
+    bool right = test_and(t);
+    value = value || right;
+  }
+  return value;
+}
+
+int builtin_test(char **args) {
+  assert(args);
+
+  size_t n = 0;
+  while (args[n + 1]) {
+    ++n;
+  }
+  if (strcmp(args[0], "[") == 0) {
+    if (n == 0 || strcmp(args[n], "]") != 0) {
+      fprintf(stderr, "[: missing ']'\n");
+      return 2;
+    }
+    --n;
+  }
+  if (n == 0) {
+    return 1;
+  }
+
+  struct test_eval t = { args + 1, n, 0, false };
+  bool value = test_or(&t);
+  if (!t.error && t.pos != t.n) {
+    fprintf(stderr, "test: too many arguments\n");
+    t.error = true;
+  }
+  if (t.error) {
+    return 2;
+  }
+  return value ? 0 : 1;
+}
+
+/**
+ * Print the escape sequence starting at "*p", just after the backslash
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * "*p" is moved after the sequence.
+ *
+ * @return false if the sequence is \c, which stops the output, true otherwise
+ */
+static bool printf_escape(const char **p) {
+  const char *s = *p;
+  char c = *s++;
+  switch (c) {
+    case 'a': putchar('\a'); break;
+    case 'b': putchar('\b'); break;
+    case 'f': putchar('\f'); break;
+    case 'n': putchar('\n'); break;
+    case 'r': putchar('\r'); break;
+    case 't': putchar('\t'); break;
+    case 'v': putchar('\v'); break;
+    case '\\': putchar('\\'); break;
+    case 'c':
+      *p = s;
+      return false;
+    case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': {
+      int value = c - '0';
+      for (int i = 0; i < 2 && *s >= '0' && *s <= '7'; ++i) {
+        value = 8 * value + (*s++ - '0');
+      }
+      putchar(value);
+      break;
+    }
+    case '\0':
+      putchar('\\');
+      --s;
+      break;
+    default:
+      putchar('\\');
+      putchar(c);
+      break;
+  }
+  *p = s;
+  return true;
+}
+
+/**
+ * Convert a numeric argument of printf, 'c' standing for a character constant
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @param ok set to false if the argument isn't a valid number
+ */
+static long long printf_integer(const char *arg, bool *ok) {
+  if (arg[0] == '\'' || arg[0] == '"') {
+    return (unsigned char) arg[1];
+  }
+  char *end;
+  errno = 0;
+  long long value = strtoll(arg, &end, 0);
+  if (errno == ERANGE) {
+    value = (long long) strtoull(arg, &end, 0);
+  }
+  if (*arg != '\0' && (*end != '\0' || errno == EINVAL)) {
+    fprintf(stderr, "printf: %s: invalid number\n", arg);
+    *ok = false;
+  }
+  return value;
+}
+
+int builtin_printf(char **args) {
+  assert(args);
+
+  if (args[1] == NULL) {
+    fprintf(stderr, "usage: printf format [arguments]\n");
+    return 2;
+  }
+  const char *format = args[1];
+  char **arg = args + 2;
+  bool ok = true;
+  bool consumed;
+
+  do {
+    consumed = false;
+    const char *f = format;
+    while (*f) {
+      if (*f == '\\') {
+        ++f;
+        if (!printf_escape(&f)) {
+          return ok ? 0 : 1;
+        }
+        continue;
+      }
+      if (*f != '%') {
+        putchar(*f++);
+        continue;
+      }
+      if (f[1] == '%') {
+        putchar('%');
+        f += 2;
+        continue;
+      }
+
+      /* copy the specification, the length modifier being added for numbers */
+      char spec[32];
+      size_t len = 0;
+      spec[len++] = *f++;
+      while (*f && strchr("-+ #0", *f) && len < 8) {
+        spec[len++] = *f++;
+      }
+      while (isdigit((unsigned char) *f) && len < 16) {
+        spec[len++] = *f++;
+      }
+      if (*f == '.') {
+        spec[len++] = *f++;
+        while (isdigit((unsigned char) *f) && len < 24) {
+          spec[len++] = *f++;
+        }
+      }
+      char conv = *f;
+      if (conv == '\0') {
+        fprintf(stderr, "printf: %s: missing conversion\n", format);
+        return 1;
+      }
+      ++f;
+
+      const char *value = "";
+      if (*arg) {
+        value = *arg++;
+        consumed = true;
+      }
+
+      switch (conv) {
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+          spec[len++] = 'l';
+          spec[len++] = 'l';
+          spec[len++] = conv;
+          spec[len] = '\0';
+          printf(spec, printf_integer(value, &ok));
+          break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+          spec[len++] = conv;
+          spec[len] = '\0';
+          printf(spec, strtod(value, NULL));
+          break;
+        case 'c':
+          spec[len++] = 'c';
+          spec[len] = '\0';
+          printf(spec, value[0]);
+          break;
+        case 's':
+          spec[len++] = 's';
+          spec[len] = '\0';
+          printf(spec, value);
+          break;
+        case 'b':
+          while (*value) {
+            if (*value == '\\') {
+              ++value;
+              if (!printf_escape(&value)) {
+                return ok ? 0 : 1;
+              }
+            } else {
+              putchar(*value++);
+            }
+          }
+          break;
+        default:
+          fprintf(stderr, "printf: %%%c: invalid conversion\n", conv);
+          return 1;
+      }
+    }
+  } while (*arg && consumed);
+
+  return ok && !ferror(stdout) ? 0 : 1;
+}
+
+/**
+ * Names of the signals known by kill
+ */
+static const struct {
+  const char *name;
+  int number;
+} signals[] = {
+  { "HUP", SIGHUP }, { "INT", SIGINT }, { "QUIT", SIGQUIT }, { "ILL", SIGILL },
+  { "TRAP", SIGTRAP }, { "ABRT", SIGABRT }, { "BUS", SIGBUS }, { "FPE", SIGFPE },
+  { "KILL", SIGKILL }, { "USR1", SIGUSR1 }, { "SEGV", SIGSEGV }, { "USR2", SIGUSR2 },
+  { "PIPE", SIGPIPE }, { "ALRM", SIGALRM }, { "TERM", SIGTERM }, { "CHLD", SIGCHLD },
+  { "CONT", SIGCONT }, { "STOP", SIGSTOP }, { "TSTP", SIGTSTP }, { "TTIN", SIGTTIN },
+  { "TTOU", SIGTTOU }, { "URG", SIGURG }, { "XCPU", SIGXCPU }, { "XFSZ", SIGXFSZ },
+  { "VTALRM", SIGVTALRM }, { "PROF", SIGPROF }, { "WINCH", SIGWINCH }, { "SYS", SIGSYS },
+};
+
+/**
+ * Convert a signal name (with or without SIG) or number
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the signal number, -1 if it is unknown
+ */
+static int signal_number(const char *name) {
+  if (isdigit((unsigned char) name[0])) {
+    char *end;
+    long value = strtol(name, &end, 10);
+    return *end == '\0' && value >= 0 && value < NSIG ? (int) value : -1;
+  }
+  if (strncasecmp(name, "SIG", 3) == 0) {
+    name += 3;
+  }
+  for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); ++i) {
+    if (strcasecmp(name, signals[i].name) == 0) {
+      return signals[i].number;
+    }
+  }
+  return -1;
+}
+
+int builtin_kill(char **args) {
+  assert(args);
+
+  size_t i = 1;
+  int sig = SIGTERM;
+  if (args[i] && strcmp(args[i], "-l") == 0) {
+    for (size_t j = 0; j < sizeof(signals) / sizeof(signals[0]); ++j) {
+      printf("%2d) SIG%s\n", signals[j].number, signals[j].name);
+    }
+    return 0;
+  }
+  if (args[i] && strcmp(args[i], "-s") == 0 && args[i + 1]) {
+    sig = signal_number(args[i + 1]);
+    i += 2;
+  } else if (args[i] && args[i][0] == '-' && args[i][1] != '\0' && strcmp(args[i], "--") != 0) {
+    sig = signal_number(args[i] + 1);
+    ++i;
+  }
+  if (sig == -1) {
+    fprintf(stderr, "kill: unknown signal\n");
+    return 2;
+  }
+  if (args[i] && strcmp(args[i], "--") == 0) {
+    ++i;
+  }
+  if (args[i] == NULL) {
+    fprintf(stderr, "usage: kill [-SIG | -s SIG] pid...\n");
+    return 2;
+  }
+
+  int status = 0;
+  for (; args[i]; ++i) {
+    char *end;
+    long pid = strtol(args[i], &end, 10);
+    if (end == args[i] || *end != '\0') {
+      fprintf(stderr, "kill: %s: invalid pid\n", args[i]);
+      status = 1;
+      continue;
+    }
+    if (kill((pid_t) pid, sig) == -1) {
+      fprintf(stderr, "kill: %s: %s\n", args[i], strerror(errno));
+      status = 1;
+    }
+  }
+  return status;
+}
+
+/**
+ * Ways of copying a file descriptor into another, from the fastest one :
+ * all but the last one move the bytes inside the kernel
+ */
+enum copy_method { COPY_SPLICE, COPY_RANGE, COPY_SENDFILE, COPY_RW };
+
+/**
+ * Chooses how to copy "in" into "out", according to the kind of files
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static enum copy_method copy_method(int in, int out) {
+  struct stat st_in, st_out;
+  if (fstat(in, &st_in) == -1 || fstat(out, &st_out) == -1) {
+    return COPY_RW;
+  }
+  if (S_ISFIFO(st_in.st_mode) || S_ISFIFO(st_out.st_mode)) {
+    return COPY_SPLICE;
+  }
+  if (S_ISREG(st_in.st_mode)) {
+    return S_ISREG(st_out.st_mode) ? COPY_RANGE : COPY_SENDFILE;
+  }
+  return COPY_RW;
+}
+
+/**
+ * Copies at most COPY_CHUNK bytes with read and write
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static ssize_t copy_rw(int in, int out) {
+  char buf[RW_BUF_SIZE];
+  ssize_t n = read(in, buf, sizeof(buf));
+  for (ssize_t done = 0; done < n;) {
+    ssize_t w = write(out, buf + done, n - done);
+    if (w == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    done += w;
+  }
+  return n;
+}
+
+/**
+ * Copies "in" into "out" until the end of "in", from the current offsets
+ *
+ * When the chosen system call isn't supported for these files, the next method is tried :
+ * as the offsets are those of the files, the copy goes on where it stopped.
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+static int copy_fd(int in, int out) {
+  enum copy_method method = copy_method(in, out);
+  for (;;) {
+    ssize_t n;
+    switch (method) {
+      case COPY_SPLICE:
+        n = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+        break;
+      case COPY_RANGE:
+        n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+        break;
+      case COPY_SENDFILE:
+        n = sendfile(out, in, NULL, COPY_CHUNK);
+        break;
+      default:
+        n = copy_rw(in, out);
+        break;
+    }
+    if (n > 0) {
+      continue;
+    }
+    if (n == 0) {
+      return 0;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (method != COPY_RW
+        && (errno == EINVAL || errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP || errno == EBADF)) {
+      /* some file systems refuse copy_file_range with EBADF : a really bad file descriptor
+         fails again with read and write. sendfile needs a regular input, which copy_file_range has */
+      method = method == COPY_RANGE ? COPY_SENDFILE : COPY_RW;
+      continue;
+    }
+    return -1;
+  }
+}
+
+int builtin_fcat(char **args) {
+  assert(args);
+
+  char *stdin_only[] = { args[0], "-", NULL };
+  if (args[1] == NULL) {
+    args = stdin_only;
+  }
+  int status = 0;
+  for (size_t i = 1; args[i]; ++i) {
+    bool from_stdin = strcmp(args[i], "-") == 0;
+    int fd = from_stdin ? 0 : open(args[i], O_RDONLY | O_CLOEXEC);
+    int err = fd == -1 || copy_fd(fd, 1) == -1;
+    bool gone = err && errno == EPIPE;
+    if (err && !gone) {
+      perror(from_stdin ? "fcat" : args[i]);
+    }
+    if (fd > 0) {
+      close(fd);
+    }
+    if (gone) {
+      /* the reader has gone, as cat killed by SIGPIPE but silently */
+      return 1;
+    }
+    /* as cat, the next files are still copied */
+    status |= err;
+  }
+  return status;
+}
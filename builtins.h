@@ -0,0 +1,61 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+/**
+ * Internal commands run by FiSH without creating a process
+ *
+ * Each of them receives its arguments terminated by a NULL pointer, args[0] being
+ * the name of the command, writes on stdout and stderr, and returns its exit status.
+ * Only fcat reads its standard input. None of them depends on the state of the shell,
+ * so they may be run either in FiSH or in a child process.
+ */
+
+/**
+ * echo [-n] [arg...] : prints the arguments separated by spaces
+ */
+int builtin_echo(char **args);
+
+/**
+ * true : does nothing, successfully
+ */
+int builtin_true(char **args);
+
+/**
+ * false : does nothing, unsuccessfully
+ */
+int builtin_false(char **args);
+
+/**
+ * pwd : prints the current working directory
+ */
+int builtin_pwd(char **args);
+
+/**
+ * test expr, [ expr ] : evaluates a conditional expression
+ *
+ * @return 0 if the expression is true, 1 if it is false, 2 if it is malformed
+ */
+int builtin_test(char **args);
+
+/**
+ * printf format [arg...] : prints the arguments according to the format,
+ * which is reused as long as arguments remain
+ */
+int builtin_printf(char **args);
+
+/**
+ * kill [-SIG | -s SIG] pid... : sends a signal (SIGTERM by default) to processes
+ * kill -l : lists the names of the signals
+ */
+int builtin_kill(char **args);
+
+/**
+ * fcat [file...] : copies the files (standard input if none or "-") to the standard output
+ *
+ * The bytes are moved inside the kernel with splice, copy_file_range or sendfile,
+ * according to the kind of files, falling back to read and write when none applies.
+ * A file which can't be read is reported and skipped, the status being 1 at the end.
+ */
+int builtin_fcat(char **args);
+
+#endif
@@ -1,37 +1,193 @@
+#define _POSIX_C_SOURCE 200809L
 #include "cmdline.h"
+#include "scan.h"
 
 #include <assert.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define ARENA_MIN_BLOCK 256
+#define MIN_CMDS 4
+#define MIN_ARGS 8
+#define MIN_OUTPUTS 2
+#define READ_CHUNK 4096
 
 void line_init(struct line *li) {
   assert(li);
   memset(li, 0, sizeof(struct line));
 }
 
+/**
+ * Chain a new block of at least "size" bytes in front of the arena
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file
+ * 
+ * @param a pointer on the arena
+ * @param size minimal number of bytes available in the new block
+ * @return the new block, NULL if a memory allocation failure occurs
+ */
+static struct arena_block *arena_grow(struct arena *a, size_t size) {
+  size_t newsize = ARENA_MIN_BLOCK;
+  if (a->head && newsize < 2 * a->head->size) {
+    newsize = 2 * a->head->size;
+  }
+  if (newsize < size) {
+    newsize = size;
+  }
+
+  struct arena_block *block = malloc(sizeof(struct arena_block) + newsize);
+  if (block == NULL) {
+    return NULL;
+  }
+  ++a->n_allocs;
+  block->next = a->head;
+  block->size = newsize;
+  block->used = 0;
+  a->head = block;
+  return block;
+}
 
 /**
- * Test the validity of command arguments or file names used in redirections
+ * Carve "size" bytes from the arena
  * 
  * This function is static : it means that it is a local function, accessible only in this source file
  * 
- * @param word pointer on the first char of string to test
- * @return true if the word is valid, false otherwise
+ * @param a pointer on the arena
+ * @param size number of bytes requested
+ * @return pointer on the bytes, NULL if a memory allocation failure occurs
  */
-static bool valid_cmdarg_filename(const char *word){ 
-   char forbidden[] = "<>&|";// forbidden characters in commands arguments and filenames
-
-   size_t lenf = strlen(forbidden);
-   for (size_t i = 0; i < lenf ; ++i){
-      char *ptr = strchr(word, forbidden[i]);
-      if (ptr) {
-         return false;
-      }
-   }
-   return true;
+static char *arena_alloc(struct arena *a, size_t size) {
+  struct arena_block *block = a->head;
+  if (block == NULL || block->size - block->used < size) {
+    block = arena_grow(a, size);
+    if (block == NULL) {
+      return NULL;
+    }
+  }
+  char *ptr = block->data + block->used;
+  block->used += size;
+  return ptr;
+}
+
+/**
+ * Carve a bitmap of "n_words" words from the arena
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file
+ * 
+ * @param a pointer on the arena
+ * @param n_words number of 64 bits words requested
+ * @return pointer on the words, NULL if a memory allocation failure occurs
+ */
+static uint64_t *arena_alloc_bits(struct arena *a, size_t n_words) {
+  if (a->head) {
+    size_t misalign = a->head->used % sizeof(uint64_t);
+    if (misalign != 0 && a->head->size - a->head->used >= sizeof(uint64_t) - misalign) {
+      a->head->used += sizeof(uint64_t) - misalign;
+    }
+  }
+  // a new block is always aligned, its data following a header made of pointers and sizes
+  char *ptr = arena_alloc(a, n_words * sizeof(uint64_t));
+  assert(((uintptr_t) ptr) % sizeof(uint64_t) == 0);
+  return (uint64_t *) ptr;
+}
+
+/**
+ * Release everything carved from the arena
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * If the last line needed more than one block, the chain is replaced by a single block
+ * of the cumulated size, so that the next line of the same size fits without allocation.
+ * 
+ * @param a pointer on the arena
+ */
+static void arena_rewind(struct arena *a) {
+  if (a->head == NULL) {
+    return;
+  }
+  if (a->head->next == NULL) {
+    a->head->used = 0;
+    return;
+  }
+
+  size_t total = 0;
+  while (a->head) {
+    struct arena_block *next = a->head->next;
+    total += a->head->size;
+    free(a->head);
+    a->head = next;
+  }
+  // on failure, the arena simply starts again from an empty chain
+  arena_grow(a, total);
+}
+
+
+/**
+ * Append the word "word" to the command number "n_cmd" of the line
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * The array of commands and the array of arguments grow as needed and keep the terminating NULL pointer.
+ * 
+ * @param li pointer on the struct line
+ * @param n_cmd index of the command
+ * @param word argument to append
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int line_push_arg(struct line *li, size_t n_cmd, char *word) {
+  if (n_cmd == li->cap_cmds) {
+    size_t cap = li->cap_cmds ? 2 * li->cap_cmds : MIN_CMDS;
+    struct cmd *cmds = realloc(li->cmds, cap * sizeof(struct cmd));
+    if (cmds == NULL) {
+      return -1;
+    }
+    ++li->n_allocs;
+    memset(cmds + li->cap_cmds, 0, (cap - li->cap_cmds) * sizeof(struct cmd));
+    li->cmds = cmds;
+    li->cap_cmds = cap;
+  }
+
+  struct cmd *cmd = &li->cmds[n_cmd];
+  if (cmd->n_args + 1 >= cmd->cap_args) {
+    size_t cap = cmd->cap_args ? 2 * cmd->cap_args : MIN_ARGS;
+    char **args = realloc(cmd->args, cap * sizeof(char *));
+    if (args == NULL) {
+      return -1;
+    }
+    ++li->n_allocs;
+    cmd->args = args;
+    cmd->cap_args = cap;
+  }
+
+  cmd->args[cmd->n_args++] = word;
+  cmd->args[cmd->n_args] = NULL;
+  return 0;
+}
+
+/**
+ * Append the filename "word" to the targets of the output redirections of the line
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * 
+ * @param li pointer on the struct line
+ * @param word filename to append
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int line_push_output(struct line *li, char *word) {
+  if (li->n_outputs == li->cap_outputs) {
+    size_t cap = li->cap_outputs ? 2 * li->cap_outputs : MIN_OUTPUTS;
+    char **outputs = realloc(li->file_outputs, cap * sizeof(char *));
+    if (outputs == NULL) {
+      return -1;
+    }
+    ++li->n_allocs;
+    li->file_outputs = outputs;
+    li->cap_outputs = cap;
+  }
+  li->file_outputs[li->n_outputs++] = word;
+  return 0;
 }
 
 /**
@@ -57,45 +213,53 @@ static void parse_error(const char *format, ...) {
  * Search a new word in the string "str" from the "index" position
  * 
  * This function is static : it means that it is a local function, accessible only in this source file.
+ * The bytes of "str" are not inspected one by one : the search is driven by the character
+ * classes computed beforehand by "scan_classify".
  * After the call, "index" contains the position of the last character used plus one.
- * If a word is found, it is copied to a dynamically allocated memory space. "pword" is a pointer
- * on a pointer which retrieves the address of this dynamically allocated memory space.
+ * If a word is found, it is copied to a memory space carved from the arena "a". If "a" is NULL,
+ * the word is not copied : a '\0' is written in "str" right after it and "pword" points inside "str".
+ * "pword" is a pointer on a pointer which retrieves the address of the word.
  * 
  * @param str pointer on the first char of the line entered by the user
+ * @param sc character classes of "str"
  * @param index pointer on the index
- * @param pword pointer on a pointer which retrieves the address of this dynamically allocated memory space
+ * @param a pointer on the arena of the line, NULL to split "str" in place
+ * @param pword pointer on a pointer which retrieves the address of the word
+ * @param pvalid pointer on a boolean set to false if the word holds one of the characters "<>&|",
+ *        forbidden in commands arguments and filenames
+ * @param pquoted pointer on a boolean set to true if the word is between quotes
  * @return   0 if a word is found or if the end of the line is reached
  *           -1 if a malformed line is detected
  *           -2 if a memory allocation failure occurs
  */
-static int line_next_word(const char *str, size_t *index, char **pword) {
+static int line_next_word(char *str, const struct scan *sc, size_t *index, struct arena *a, char **pword, bool *pvalid, bool *pquoted) {
   assert(str);
+  assert(sc);
   assert(index);
   assert(pword);
+  assert(pvalid);
+  assert(pquoted);
   
-  size_t i = *index;
+  size_t len = sc->len;
   *pword = NULL;
 
   /* eat space */
-  while (str[i] != '\0' && isspace(str[i])) {
-    ++i;
-  }
+  size_t i = scan_next_clear(sc->space, *index, len);
 
   /* check if it is the end of the line */
-  if (str[i] == '\0') {
+  if (i == len) {
     *index = i;
     return 0;
   }
 
   size_t start = i;
   size_t end = i;
-  if (str[i] == '"') {
+  *pquoted = str[i] == '"';
+  if (*pquoted) {
     ++start;
-    do {
-      ++i;
-    } while (str[i] != '\0' && str[i] != '"');
+    i = scan_next(sc->quote, start, len);
 
-    if (str[i] == '\0') {
+    if (i == len) {
       parse_error("Malformed line\n");
       return -1;
     }
@@ -104,52 +268,81 @@ static int line_next_word(const char *str, size_t *index, char **pword) {
     ++i;
   } 
   else {
-    while (str[i] != '\0' && !isspace(str[i])) {
-      ++i;
-    }
+    i = scan_next(sc->space, i, len);
     end = i;
   }
 
+  assert(end >= start); 
+  *pvalid = !scan_any(sc->special, start, end);
+
+  /* terminate this word where it lies */
+  if (a == NULL) {
+    if (str[end] != '\0') {
+      str[end] = '\0';
+      if (i == end) {
+        ++i;
+      }
+    }
+    *index = i;
+    *pword = str + start;
+    return 0;
+  }
+
   *index = i;
 
   /* copy this word */
-  assert(end >= start); 
-  *pword = calloc(end - start + 1, sizeof(char));
+  *pword = arena_alloc(a, end - start + 1);
   if (*pword == NULL){
     fprintf(stderr, "Memory allocation failure\n");
     return -2;
   }
   memcpy(*pword, str + start, end - start);
+  (*pword)[end - start] = '\0';
   return 0;
 }
 
 
 
 
-int line_parse(struct line *li, const char *str) {
+/**
+ * Parse the string "str" and construct the struct line pointed by "li"
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * 
+ * @param li pointer on the struct line to fill
+ * @param str pointer on the first char of string line entered by the user
+ * @param a arena where the words are copied, NULL to split "str" in place
+ * @return 0 on success, -1 on failure
+ */
+static int line_parse_words(struct line *li, char *str, struct arena *a) {
   assert(li);
   assert(str);
 
   size_t len = strlen(str);
-  assert(len >= 1); 
-  if (str[len -1] != '\n'){
-    fprintf(stderr, "The command line is too long\n");
-    char c = 0;
-    while (c != '\n'){
-      c = fgetc(stdin);
-    }
+
+  /* classify all the characters of the line at once */
+  struct scan sc;
+  size_t n_words = scan_words(len);
+  sc.space = arena_alloc_bits(&li->arena, 3 * n_words);
+  if (sc.space == NULL) {
+    fprintf(stderr, "Memory allocation failure\n");
     return -1;
   }
-  
+  sc.quote = sc.space + n_words;
+  sc.special = sc.quote + n_words;
+  scan_classify(&sc, str, len);
+
   size_t index = 0;
   size_t curr_cmd = 0;
-  size_t curr_arg = 0;
+  size_t curr_arg = 0; // number of arguments of the current command
   int valret = 0; 
 
   for (;;) {
     /* get the next word */
     char *word;
-    int err = line_next_word(str, &index, &word);
+    bool valid;
+    bool quoted;
+    int err = line_next_word(str, &sc, &index, a, &word, &valid, &quoted);
     if (err) {
       valret = -1; 
       break;
@@ -164,8 +357,6 @@ int line_parse(struct line *li, const char *str) {
 #endif
 
     if (strcmp(word, "|") == 0) {
-      free(word);
-
       if (li->background) {
         parse_error("No pipe allowed after a '&'\n");
         valret = -1;
@@ -184,27 +375,19 @@ int line_parse(struct line *li, const char *str) {
         break;
       }
 
-      li->cmds[curr_cmd].n_args = curr_arg;
       curr_arg = 0;
       ++curr_cmd;
 
     } 
     else if (strcmp(word, ">") == 0) {
-      free(word);
-
-      if (li->redirect_output) {
-        parse_error("Output redirection already defined\n");
-        valret = -1;
-        break;
-      }
-      
+      /* several output redirections write the same stream to all their files */
       if (li->background) {
         parse_error("No output redirection allowed after a '&'\n");
         valret = -1;
         break;
       }
 
-      err = line_next_word(str, &index, &word);
+      err = line_next_word(str, &sc, &index, a, &word, &valid, &quoted);
       if (err) {
         valret = -1; 
         break;
@@ -216,20 +399,22 @@ int line_parse(struct line *li, const char *str) {
         break;
       }
 
-      if (!valid_cmdarg_filename(word)){
+      if (!valid){
         parse_error("Filename \"%s\" is not valid\n", word);
-        free(word);
         valret = -1;
         break;        
       }
       
+      if (line_push_output(li, word)) {
+        fprintf(stderr, "Memory allocation failure\n");
+        valret = -1;
+        break;
+      }
       li->redirect_output = true;
-      li->file_output = word;
+      li->file_output = li->file_outputs[0];
 
     } 
     else if (strcmp(word, "<") == 0) {
-      free(word);
-
       if (li->redirect_input) {
         parse_error("Input redirection already defined\n");
         valret = -1;
@@ -248,7 +433,7 @@ int line_parse(struct line *li, const char *str) {
         break;
       }
 
-      err = line_next_word(str, &index, &word);
+      err = line_next_word(str, &sc, &index, a, &word, &valid, &quoted);
       if (err) {
         valret = -1; 
         break;
@@ -260,9 +445,8 @@ int line_parse(struct line *li, const char *str) {
         break;
       }
 
-      if (!valid_cmdarg_filename(word)){
+      if (!valid){
         parse_error("Filename \"%s\" is not valid\n", word);
-        free(word);
         valret = -1;
         break;      
       }
@@ -272,8 +456,6 @@ int line_parse(struct line *li, const char *str) {
 
     } 
     else if (strcmp(word, "&") == 0) {
-      free(word);
-
       if (li->background) {
         parse_error("More than one '&' detected\n");
         valret = -1;
@@ -290,33 +472,39 @@ int line_parse(struct line *li, const char *str) {
     } 
     else {
       if (li->background) {
-        free(word);
         parse_error("No more commands allowed after a '&'\n");
         valret = -1;
         break;
       }
-      if (curr_cmd == MAX_CMDS) {   
-        free(word);
-        parse_error("Too many commands. Max: %i\n", MAX_CMDS);
-        valret = -1;
-        break;
-      }
-      if (curr_arg == MAX_ARGS) {
-        free(word);
-        parse_error("Too many arguments. Max: %i\n", MAX_ARGS);
-        valret = -1;
-        break;
-      }
 
-      if (!valid_cmdarg_filename(word)){ 
+      if (!valid){ 
         parse_error("Argument \"%s\" is not valid\n", word);
-        free(word);
         valret = -1;
         break;        
       }
 
-      li->cmds[curr_cmd].args[curr_arg] = word;
-      ++curr_arg;
+      /* an unquoted pattern is replaced by the matching paths, kept as is if nothing matches */
+      ssize_t n_paths = 0;
+      if (!quoted && expand_has_magic(word, strlen(word))) {
+        n_paths = expand_glob(&li->glob, word);
+      }
+      for (ssize_t i = 0; i < n_paths; ++i) {
+        size_t size = strlen(li->glob.paths[i]) + 1;
+        char *path = arena_alloc(&li->arena, size);
+        if (path == NULL || line_push_arg(li, curr_cmd, memcpy(path, li->glob.paths[i], size))) {
+          n_paths = -1;
+          break;
+        }
+        ++curr_arg;
+      }
+      if (n_paths == -1 || (n_paths == 0 && line_push_arg(li, curr_cmd, word))) {
+        fprintf(stderr, "Memory allocation failure\n");
+        valret = -1;
+        break;
+      }
+      if (n_paths == 0) {
+        ++curr_arg;
+      }
     }
   } //end of the loop for
 
@@ -340,29 +528,137 @@ int line_parse(struct line *li, const char *str) {
   }
 
   if (curr_arg != 0) {
-    li->cmds[curr_cmd].n_args = curr_arg; 
     ++curr_cmd;
   }
   li->n_cmds = curr_cmd;
   return valret;
 }
 
+int line_parse(struct line *li, const char *str) {
+  // "str" is only read when the words are copied to the arena
+  return line_parse_words(li, (char *) str, &li->arena);
+}
+
+char *line_buffer(struct line *li, size_t size) {
+  assert(li);
+
+  if (li->input_cap < size) {
+    char *input = realloc(li->input, size);
+    if (input == NULL) {
+      fprintf(stderr, "Memory allocation failure\n");
+      return NULL;
+    }
+    ++li->n_allocs;
+    li->input = input;
+    li->input_cap = size;
+  }
+  li->input_len = 0;
+  li->input_pos = 0;
+  return li->input;
+}
+
+bool line_pending(const struct line *li) {
+  assert(li);
+  return li->input_pos < li->input_len
+      && memchr(li->input + li->input_pos, '\n', li->input_len - li->input_pos) != NULL;
+}
+
+char *line_read(struct line *li, int fd) {
+  assert(li);
+
+  size_t scanned = li->input_pos;
+  for (;;) {
+    char *nl = memchr(li->input + scanned, '\n', li->input_len - scanned);
+    if (nl) {
+      char *str = li->input + li->input_pos;
+      *nl = '\0';
+      li->input_pos = nl - li->input + 1;
+      return str;
+    }
+
+    /* move the beginning of the line to the front of the buffer before reading more */
+    if (li->input_pos > 0) {
+      li->input_len -= li->input_pos;
+      memmove(li->input, li->input + li->input_pos, li->input_len);
+      li->input_pos = 0;
+    }
+    scanned = li->input_len;
+
+    /* keep room for a chunk and the final '\0' */
+    if (li->input_cap - li->input_len < READ_CHUNK + 1) {
+      size_t cap = li->input_cap ? 2 * li->input_cap : READ_CHUNK + 1;
+      while (cap - li->input_len < READ_CHUNK + 1) {
+        cap *= 2;
+      }
+      char *input = realloc(li->input, cap);
+      if (input == NULL) {
+        fprintf(stderr, "Memory allocation failure\n");
+        return NULL;
+      }
+      ++li->n_allocs;
+      li->input = input;
+      li->input_cap = cap;
+    }
+
+    ssize_t n = read(fd, li->input + li->input_len, li->input_cap - li->input_len - 1);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      /* end of file : return the last line even without its '\n' */
+      if (n == -1) {
+        perror("read");
+      }
+      if (li->input_len == 0) {
+        return NULL;
+      }
+      li->input[li->input_len] = '\0';
+      li->input_pos = li->input_len;
+      return li->input;
+    }
+    li->input_len += n;
+  }
+}
+
+int line_parse_inplace(struct line *li, char *str) {
+  return line_parse_words(li, str, NULL);
+}
+
 void line_reset(struct line *li) {
   assert(li);
 
+  arena_rewind(&li->arena);
+
   for (size_t i = 0; i < li->n_cmds; ++i) {
-    for (size_t j = 0; j < li->cmds[i].n_args; ++j) {
-      free(li->cmds[i].args[j]);
+    li->cmds[i].n_args = 0;
+    if (li->cmds[i].args) {
+      li->cmds[i].args[0] = NULL;
     }
   }
+  li->n_cmds = 0;
+  li->redirect_input = false;
+  li->file_input = NULL;
+  li->redirect_output = false;
+  li->file_output = NULL;
+  li->n_outputs = 0;
+  li->background = false;
+}
 
-  if (li->redirect_input) {
-    free(li->file_input);
-  }
+void line_destroy(struct line *li) {
+  assert(li);
 
-  if (li->redirect_output) {
-    free(li->file_output);
+  while (li->arena.head) {
+    struct arena_block *next = li->arena.head->next;
+    free(li->arena.head);
+    li->arena.head = next;
+  }
+  free(li->input);
+  free(li->file_outputs);
+  expand_destroy(&li->glob);
+  for (size_t i = 0; i < li->cap_cmds; ++i) {
+    free(li->cmds[i].args);
   }
+  free(li->cmds);
 
   memset(li, 0, sizeof(struct line));
 }
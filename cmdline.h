@@ -4,22 +4,56 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-#define MAX_ARGS 16
-#define MAX_CMDS 16
+#include "expand.h"
 
 struct cmd {
-  char *args[MAX_ARGS + 1]; //+1 to have a NULL at the end if nargs = MAX_ARGS
+  char **args; // always terminated by a NULL pointer
   size_t n_args;
+  size_t cap_args; // capacity of "args", kept by "line_reset"
+};
+
+/**
+ * Block of memory from which the words of a line are carved
+ */
+struct arena_block {
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+/**
+ * Bump allocator owned by a struct line
+ * 
+ * Words and redirection filenames are carved from the current block.
+ * When a line does not fit, a new block is chained; "line_reset" then merges
+ * the chain into a single block big enough for the largest line seen so far,
+ * so that a steady stream of lines needs no allocation at all.
+ */
+struct arena {
+  struct arena_block *head;
+  size_t n_allocs; // number of blocks allocated since "line_init"
 };
 
 struct line {
-  struct cmd cmds[MAX_CMDS];
+  struct cmd *cmds;
   size_t n_cmds;
+  size_t cap_cmds; // capacity of "cmds", kept by "line_reset"
   bool redirect_input;
   char *file_input;
   bool redirect_output;
-  char *file_output;
+  char *file_output; // first of "file_outputs"
+  char **file_outputs; // targets of the output redirections, in order
+  size_t n_outputs;
+  size_t cap_outputs; // capacity of "file_outputs", kept by "line_reset"
   bool background;
+  struct arena arena;
+  struct expansion glob; // paths matched by the last pattern, see "expand_glob"
+  char *input; // line buffer owned by the structure, see "line_buffer" and "line_read"
+  size_t input_cap;
+  size_t input_len; // number of bytes read by "line_read"
+  size_t input_pos; // position of the next line to return by "line_read"
+  size_t n_allocs; // number of arrays (re)allocated since "line_init", the arena not included
 };
 
 /**
@@ -43,14 +77,74 @@ void line_init(struct line *li);
  */
 int line_parse(struct line *li, const char *str);
 
+/**
+ * Get the line buffer owned by a struct line
+ * 
+ * The buffer is kept by "line_reset" and only grows when "size" exceeds its capacity,
+ * in which case its previous content is preserved
+ * The bytes read in advance by "line_read" are forgotten
+ * 
+ * @param li pointer on the struct line
+ * @param size minimal number of bytes needed
+ * @return pointer on the buffer, NULL if a memory allocation failure occurs
+ */
+char *line_buffer(struct line *li, size_t size);
+
+/**
+ * Read the next line from the file descriptor "fd" into the line buffer
+ * 
+ * The line may have any length : the buffer grows as needed. Bytes read beyond the end of
+ * the line stay in the buffer for the next call. The final '\n' is replaced by a '\0', so that
+ * the line can be given as is to "line_parse_inplace"
+ * 
+ * @param li pointer on the struct line owning the buffer
+ * @param fd file descriptor to read from
+ * @return pointer on the line inside the buffer, NULL at the end of the file or on failure
+ */
+char *line_read(struct line *li, int fd);
+
+/**
+ * Tell whether "line_read" can return a line without reading, a whole line being
+ * already in the buffer
+ * 
+ * @param li pointer on the struct line owning the buffer
+ * @return true if a line ending with '\n' is in the buffer
+ */
+bool line_pending(const struct line *li);
+
+/**
+ * Parse the string "str" in place and construct the struct line pointed by "li"
+ * 
+ * Words are not copied : a '\0' is written after each of them in "str" and the arguments
+ * and filenames of "li" point inside "str", which must outlive them (typically, "str" is
+ * the buffer returned by "line_buffer")
+ * You must call "line_init" or "line_reset" before calling this function
+ * 
+ * @param li pointer on the struct line to fill
+ * @param str pointer on the first char of the mutable string line entered by the user
+ * @return 0 on success, -1 on failure
+ */
+int line_parse_inplace(struct line *li, char *str);
+
 /**
  * Reset a struct line
  * 
- * Free dynamically allocated memory
- * All bytes occupied by the structure are set to 0
+ * The words of the line are released in one go by rewinding the arena
+ * The arena, the arrays of commands and arguments and the line buffer are kept for the next line,
+ * the structure is emptied
  * 
  * @param li pointer on the struct line to reset
  */
 void line_reset(struct line *li);
 
+/**
+ * Destroy a struct line
+ * 
+ * Free the memory owned by the arena, the arrays and the line buffer, the structure can then be reused
+ * only after a call to "line_init"
+ * 
+ * @param li pointer on the struct line to destroy
+ */
+void line_destroy(struct line *li);
+
 #endif
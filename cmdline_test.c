@@ -1,18 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
 #include "cmdline.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #define OK 0
 #define KO 1
 
 
+/**
+ * Compare two strings which may be NULL
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * 
+ * @return true if both strings are NULL or equal, false otherwise
+ */
+static bool same_str(const char *s1, const char *s2) {
+  if (s1 == NULL || s2 == NULL) {
+    return s1 == s2;
+  }
+  return strcmp(s1, s2) == 0;
+}
+
+/**
+ * Compare two parsed lines
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * 
+ * @return true if both lines hold the same commands, arguments, redirections and background flag
+ */
+static bool same_line(const struct line *li1, const struct line *li2) {
+  if (li1->n_cmds != li2->n_cmds
+      || li1->redirect_input != li2->redirect_input
+      || li1->redirect_output != li2->redirect_output
+      || li1->background != li2->background
+      || !same_str(li1->file_input, li2->file_input)
+      || !same_str(li1->file_output, li2->file_output)
+      || li1->n_outputs != li2->n_outputs) {
+    return false;
+  }
+  for (size_t i = 0; i < li1->n_outputs; ++i) {
+    if (!same_str(li1->file_outputs[i], li2->file_outputs[i])) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < li1->n_cmds; ++i) {
+    if (li1->cmds[i].n_args != li2->cmds[i].n_args) {
+      return false;
+    }
+    for (size_t j = 0; j <= li1->cmds[i].n_args; ++j) {
+      if (!same_str(li1->cmds[i].args[j], li2->cmds[i].args[j])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 /**
  * Test a command line "str"
  * 
  * This function is static : it means that it is a local function, accessible only in this source file.
  * This function prints "TEST OK!" if line_parse() returns a value consistent with the one transmitted 
- * via the parameter "expected", and another significant message otherwise
+ * via the parameter "expected" and if line_parse_inplace() builds the same struct line, and another
+ * significant message otherwise
  * 
  * @param str command line to test
  * @param expected OK if the command line is expected to be valid, KO otherwise
@@ -20,18 +77,30 @@
 static void try(const char *str, int expected) {
   static int n = 0;
   static struct line li;
+  static struct line li_inplace;
   
   if (n == 0){
     line_init(&li);
+    line_init(&li_inplace);
   }
   
   printf("TEST #%i\n", ++n);
 
   int err = line_parse(&li, str);
 
+  char *buf = line_buffer(&li_inplace, strlen(str) + 1);
+  strcpy(buf, str);
+  int err_inplace = line_parse_inplace(&li_inplace, buf);
+
   if ((!!err) != (!!expected)) {
     printf("UNEXPECTED RETURN WITH: %s\n", str);
   } 
+  else if ((!!err_inplace) != (!!err)) {
+    printf("UNEXPECTED RETURN IN PLACE WITH: %s\n", str);
+  } 
+  else if (!err && !same_line(&li, &li_inplace)) {
+    printf("UNEXPECTED LINE IN PLACE WITH: %s\n", str);
+  } 
   else {
     if (err){
       printf("Command line : %s", str);
@@ -39,8 +108,204 @@ static void try(const char *str, int expected) {
     printf("TEST OK!\n");
   }
   line_reset(&li);
+  line_reset(&li_inplace);
+}
+
+/**
+ * Check that parsing the same lines again does not allocate any memory
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * The first pass lets the arena grow up to the size of the largest line, the next passes
+ * must only reuse it.
+ */
+static void try_steady_state(void) {
+  static const char *lines[] = {
+    "bar baz qux\n",
+    "bar \"a long quoted argument that does not fit in a small block\" < fic1 | baz > fic2 &\n",
+    "bar > fic1 > fic2 > fic3\n",
+    "bar\n",
+    "bar \"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\" baz\n",
+  };
+  size_t n_lines = sizeof(lines) / sizeof(lines[0]);
+  struct line li;
+  line_init(&li);
+
+  for (size_t i = 0; i < n_lines; ++i) {
+    line_parse(&li, lines[i]);
+    line_reset(&li);
+  }
+  size_t warm = li.arena.n_allocs + li.n_allocs;
+
+  for (int pass = 0; pass < 100; ++pass) {
+    for (size_t i = 0; i < n_lines; ++i) {
+      line_parse(&li, lines[i]);
+      line_reset(&li);
+    }
+  }
+
+  printf("TEST steady state\n");
+  if (li.arena.n_allocs + li.n_allocs != warm) {
+    printf("UNEXPECTED ALLOCATIONS: %zu after warm-up\n", li.arena.n_allocs + li.n_allocs - warm);
+  }
+  else {
+    printf("TEST OK!\n");
+  }
+  line_destroy(&li);
 }
 
+/**
+ * Check that all the targets of several output redirections are kept, in order
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ */
+static void try_outputs(void) {
+  struct line li;
+  line_init(&li);
+
+  printf("TEST several outputs\n");
+  if (line_parse(&li, "bar | baz > qux > quux > \"q u x\"\n") != 0
+      || li.n_outputs != 3
+      || !same_str(li.file_output, "qux")
+      || !same_str(li.file_outputs[0], "qux")
+      || !same_str(li.file_outputs[1], "quux")
+      || !same_str(li.file_outputs[2], "q u x")) {
+    printf("UNEXPECTED OUTPUTS\n");
+  }
+  else {
+    printf("TEST OK!\n");
+  }
+  line_destroy(&li);
+}
+
+/**
+ * Parse "str" and check the arguments of its single command, separated by spaces in "expected",
+ * the patterns being expanded through "cache" unless it is NULL
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ */
+static void try_args(struct dircache *cache, const char *str, const char *expected) {
+  struct line li;
+  line_init(&li);
+  li.glob.cache = cache;
+
+  printf("TEST ARGS %s", str);
+  char args[256] = "";
+  if (line_parse(&li, str) == 0 && li.n_cmds == 1) {
+    for (size_t i = 0; i < li.cmds[0].n_args; ++i) {
+      strcat(args, i ? " " : "");
+      strcat(args, li.cmds[0].args[i]);
+    }
+  }
+  if (!same_str(args, expected)) {
+    printf("UNEXPECTED ARGS \"%s\" INSTEAD OF \"%s\"\n", args, expected);
+  }
+  else {
+    printf("TEST OK!\n");
+  }
+  line_destroy(&li);
+}
+
+/**
+ * Check the expansion of the patterns in a temporary directory
+ * 
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ */
+static void try_glob(void) {
+  static const char *files[] = { "a.c", "b.c", "b.h", ".hidden.c", "sub/c.c", "sub/deep/d.c" };
+  static const char *dirs[] = { "sub", "sub/deep" };
+  char tmp[] = "/tmp/cmdline_testXXXXXX";
+  int cwd = open(".", O_RDONLY);
+  if (mkdtemp(tmp) == NULL || cwd == -1 || chdir(tmp) == -1) {
+    printf("UNEXPECTED FAILURE OF THE TEMPORARY DIRECTORY\n");
+    return;
+  }
+  for (size_t i = 0; i < 2; ++i) {
+    mkdir(dirs[i], 0700);
+  }
+  for (size_t i = 0; i < 6; ++i) {
+    close(open(files[i], O_WRONLY | O_CREAT, 0600));
+  }
+
+  char absolute[64], expected[64];
+  snprintf(absolute, sizeof(absolute), "ls %s/s?b/*.c\n", tmp);
+  snprintf(expected, sizeof(expected), "ls %s/sub/c.c", tmp);
+
+  /* without cache, then with a cache empty then warm */
+  struct dircache dc;
+  dircache_init(&dc, DIRCACHE_BUDGET);
+  struct dircache *caches[] = { NULL, &dc, &dc };
+  for (size_t i = 0; i < 3; ++i) {
+    try_args(caches[i], "ls *.c\n", "ls a.c b.c");
+    try_args(caches[i], "ls \"*.c\"\n", "ls *.c");
+    try_args(caches[i], "ls *.x\n", "ls *.x");
+    try_args(caches[i], "ls .*.c\n", "ls .hidden.c");
+    try_args(caches[i], "ls [ab].[!c] ?.h\n", "ls b.h b.h");
+    try_args(caches[i], "ls */\n", "ls sub/");
+    try_args(caches[i], "ls sub/*/*.c\n", "ls sub/deep/d.c");
+    try_args(caches[i], "ls **/*.c\n", "ls a.c b.c sub/c.c sub/deep/d.c");
+    try_args(caches[i], "ls sub/**\n", "ls sub/ sub/c.c sub/deep sub/deep/d.c");
+    try_args(caches[i], "ls sub/**/\n", "ls sub/ sub/deep/");
+    try_args(caches[i], "ls nosuch/**\n", "ls nosuch/**");
+    try_args(caches[i], "ls [ab].c [ab a[]\n", "ls a.c b.c [ab a[]");
+    try_args(caches[i], absolute, expected);
+  }
+
+  printf("TEST directory cache\n");
+  unsigned long long misses = dc.misses;
+  try_args(&dc, "ls *.c\n", "ls a.c b.c");
+  close(open("e.c", O_WRONLY | O_CREAT, 0600));
+  try_args(&dc, "ls *.c\n", "ls a.c b.c e.c");
+  unlink("e.c");
+  try_args(&dc, "ls *.c\n", "ls a.c b.c");
+  /* without budget, each listing is evicted once released : "**" reads each directory twice */
+  dircache_set_budget(&dc, 0);
+  try_args(&dc, "ls **/*.c\n", "ls a.c b.c sub/c.c sub/deep/d.c");
+  if (dc.hits == 0 || dc.misses != misses + 2 + 6 || dc.invalidations != 2 || dc.evictions == 0 || dc.n_dirs != 0) {
+    printf("UNEXPECTED COUNTERS OF THE CACHE\n");
+    dircache_print(&dc, stdout);
+  }
+  else {
+    printf("TEST OK!\n");
+  }
+
+  /* the '[' of the test command isn't a pattern : no directory is looked up */
+  unsigned long long lookups = dc.hits + dc.misses;
+  try_args(&dc, "[ -n x ]\n", "[ -n x ]");
+  if (dc.hits + dc.misses != lookups) {
+    printf("UNEXPECTED LOOKUP OF A DIRECTORY\n");
+  }
+
+  /* a child forked with the cache, e.g. a parallel job, mustn't read the events of the parent */
+  dircache_set_budget(&dc, 1 << 20);
+  try_args(&dc, "ls *.c\n", "ls a.c b.c");
+  close(open("e.c", O_WRONLY | O_CREAT, 0600));
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    dircache_forked(&dc);
+    try_args(&dc, "ls *.c\n", "ls a.c b.c e.c");
+    fflush(stdout);
+    _exit(0);
+  }
+  waitpid(pid, NULL, 0);
+  try_args(&dc, "ls *.c\n", "ls a.c b.c e.c");
+  unlink("e.c");
+  dircache_destroy(&dc);
+
+  for (size_t i = 6; i-- > 0;) {
+    unlink(files[i]);
+  }
+  for (size_t i = 2; i-- > 0;) {
+    rmdir(dirs[i]);
+  }
+  if (fchdir(cwd) == 0) {
+    rmdir(tmp);
+  }
+  close(cwd);
+}
 
 int main() {
 
@@ -70,6 +335,9 @@ int main() {
   try("bar \"baz qux\"\n", OK);
   try("     \n", OK);
   try("\n", OK);
+  try("bar", OK);
+  try("bar a1 a2 a3 a4 a5 a6 a7 a8 a9 a10 a11 a12 a13 a14 a15 a16 a17 a18 a19 a20\n", OK);
+  try("bar | b1 | b2 | b3 | b4 | b5 | b6 | b7 | b8 | b9 | b10 | b11 | b12 | b13 | b14 | b15 | b16\n", OK);
 
   // things not working
   try("bar \"bar\n", KO);	
@@ -80,7 +348,8 @@ int main() {
   try("bar | | barz\n", KO);
   try("|\n", KO);
   
-  try("bar > qux > baz\n", KO);
+  try("bar > qux > baz\n", OK);
+  try("bar | baz > qux > quux > \"q u x\" &\n", OK);
   try("bar & > qux\n", KO);
   try("bar >\n", KO);
   try("bar > qu&x\n", KO);
@@ -111,6 +380,10 @@ int main() {
   try("< fic1 > fic2\n", KO);
   try("> qux \n", KO);
   
+  try_steady_state();
+  try_outputs();
+  try_glob();
+
 
   return 0;
 }
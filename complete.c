@@ -0,0 +1,383 @@
+#define _GNU_SOURCE
+#include "complete.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MIN_NAMES 64
+#define SEPARATORS " \t|<>&"
+
+int complete_init(struct completion *c, const char *const *builtins, size_t n_builtins, struct dircache *cache) {
+  assert(c);
+  assert(cache);
+  memset(c, 0, sizeof(struct completion));
+  c->builtins = builtins;
+  c->n_builtins = n_builtins;
+  c->cache = cache;
+  if (trie_init(&c->commands) == -1) {
+    return -1;
+  }
+  if (trie_init(&c->files) == -1) {
+    trie_destroy(&c->commands);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Frees the names of the directories of PATH
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void complete_free_dirs(struct completion *c) {
+  for (size_t i = 0; i < c->n_dirs; ++i) {
+    free(c->dirs[i].dir);
+    free(c->dirs[i].names);
+    free(c->dirs[i].sorted);
+  }
+  free(c->dirs);
+  c->dirs = NULL;
+  c->n_dirs = 0;
+}
+
+void complete_destroy(struct completion *c) {
+  assert(c);
+  complete_free_dirs(c);
+  free(c->path);
+  trie_destroy(&c->files);
+  trie_destroy(&c->commands);
+}
+
+/**
+ * Compares two names for qsort
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int name_cmp(const void *a, const void *b) {
+  return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+ * Tells whether an entry of a directory is an executable file
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool is_executable(int dirfd, const struct dirent *d) {
+  if (d->d_type == DT_DIR || (d->d_type != DT_REG && d->d_type != DT_LNK && d->d_type != DT_UNKNOWN)) {
+    return false;
+  }
+  if (d->d_type != DT_REG) {
+    struct stat st;
+    if (fstatat(dirfd, d->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode)) {
+      return false;
+    }
+  }
+  return faccessat(dirfd, d->d_name, X_OK, AT_EACCESS) == 0;
+}
+
+/**
+ * Reads the sorted names of the executables of a directory
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success (no name if the directory can't be read), -1 if a memory allocation failure occurs
+ */
+static int read_executables(const char *dir, char **pnames, char ***psorted, size_t *pn) {
+  *pnames = NULL;
+  *psorted = NULL;
+  *pn = 0;
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    return 0;
+  }
+  size_t len = 0, cap = 0;
+  char *names = NULL;
+  size_t n = 0;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    if (entry->d_name[0] == '.' || !is_executable(dirfd(d), entry)) {
+      continue;
+    }
+    size_t size = strlen(entry->d_name) + 1;
+    if (len + size > cap) {
+      cap = cap ? 2 * cap : MIN_NAMES * 16;
+      cap = cap < len + size ? len + size : cap;
+      char *bigger = realloc(names, cap);
+      if (bigger == NULL) {
+        free(names);
+        closedir(d);
+        return -1;
+      }
+      names = bigger;
+    }
+    memcpy(names + len, entry->d_name, size);
+    len += size;
+    ++n;
+  }
+  closedir(d);
+
+  char **sorted = malloc((n ? n : 1) * sizeof(char *));
+  if (sorted == NULL) {
+    free(names);
+    return -1;
+  }
+  for (size_t i = 0, off = 0; i < n; ++i) {
+    sorted[i] = names + off;
+    off += strlen(names + off) + 1;
+  }
+  qsort(sorted, n, sizeof(char *), name_cmp);
+  *pnames = names;
+  *psorted = sorted;
+  *pn = n;
+  return 0;
+}
+
+/**
+ * Reads again the executables of a directory of PATH, inserting in the trie the names
+ * which appeared and removing the ones which disappeared
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int complete_rescan(struct completion *c, struct path_dir *pd) {
+  char *names;
+  char **sorted;
+  size_t n;
+  if (read_executables(pd->dir, &names, &sorted, &n) == -1) {
+    return -1;
+  }
+  ++c->rescans;
+  /* both lists being sorted, they are merged */
+  size_t i = 0, j = 0;
+  int err = 0;
+  while (i < pd->n_names || j < n) {
+    int cmp = i == pd->n_names ? 1 : j == n ? -1 : strcmp(pd->sorted[i], sorted[j]);
+    if (cmp < 0) {
+      trie_remove(&c->commands, pd->sorted[i++]);
+    } else if (cmp > 0) {
+      err |= trie_insert(&c->commands, sorted[j++]);
+    } else {
+      ++i;
+      ++j;
+    }
+  }
+  free(pd->names);
+  free(pd->sorted);
+  pd->names = names;
+  pd->sorted = sorted;
+  pd->n_names = n;
+  return err;
+}
+
+/**
+ * Splits PATH into its directories, the trie holding the internal commands only
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int complete_set_path(struct completion *c, const char *path) {
+  complete_free_dirs(c);
+  free(c->path);
+  trie_clear(&c->commands);
+  c->path = strdup(path);
+  if (c->path == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < c->n_builtins; ++i) {
+    if (trie_insert(&c->commands, c->builtins[i]) == -1) {
+      return -1;
+    }
+  }
+  size_t n = 1;
+  for (const char *s = path; *s; ++s) {
+    n += *s == ':';
+  }
+  c->dirs = calloc(n, sizeof(struct path_dir));
+  if (c->dirs == NULL) {
+    return -1;
+  }
+  for (const char *s = path;; ++s) {
+    const char *end = strchrnul(s, ':');
+    /* an empty directory is the current one */
+    char *dir = end == s ? strdup(".") : strndup(s, end - s);
+    if (dir == NULL) {
+      return -1;
+    }
+    c->dirs[c->n_dirs++].dir = dir;
+    if (*end == '\0') {
+      break;
+    }
+    s = end;
+  }
+  return 0;
+}
+
+int complete_refresh(struct completion *c) {
+  assert(c);
+
+  const char *path = getenv("PATH");
+  if (path == NULL) {
+    path = "";
+  }
+  if ((c->path == NULL || strcmp(c->path, path) != 0) && complete_set_path(c, path) == -1) {
+    free(c->path);
+    c->path = NULL;
+    return -1;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  for (size_t i = 0; i < c->n_dirs; ++i) {
+    struct path_dir *pd = &c->dirs[i];
+    struct stat st;
+    if (stat(pd->dir, &st) == -1) {
+      memset(&st, 0, sizeof(st));
+    }
+    if (pd->read && st.st_mtim.tv_sec == pd->mtime.tv_sec && st.st_mtim.tv_nsec == pd->mtime.tv_nsec) {
+      continue;
+    }
+    if (complete_rescan(c, pd) == -1) {
+      return -1;
+    }
+    pd->mtime = st.st_mtim;
+    /* a directory modified during the last second may change again without a new mtime */
+    pd->read = now.tv_sec - st.st_mtim.tv_sec >= 2;
+  }
+  return 0;
+}
+
+/**
+ * Completes a filename with the names of its directory, put in the trie of the files
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the number of names matching
+ */
+static size_t complete_file(struct completion *c, const char *word, size_t len, char *insert, size_t size) {
+  /* the directory of the word, as an absolute path, and its last component */
+  const char *slash = memrchr(word, '/', len);
+  size_t dir_len = slash ? (size_t) (slash - word) + 1 : 0;
+  char dir[PATH_MAX];
+  if (word[0] == '/') {
+    if (dir_len >= sizeof(dir)) {
+      return 0;
+    }
+    memcpy(dir, word, dir_len);
+    dir[dir_len] = '\0';
+  } else {
+    if (getcwd(dir, sizeof(dir)) == NULL) {
+      return 0;
+    }
+    size_t cwd_len = strlen(dir);
+    if (cwd_len + 1 + dir_len >= sizeof(dir)) {
+      return 0;
+    }
+    dir[cwd_len] = '/';
+    memcpy(dir + cwd_len + 1, word, dir_len);
+    dir[cwd_len + 1 + dir_len] = '\0';
+  }
+  size_t base_len = len - dir_len;
+  if (base_len >= sizeof(c->last_prefix)) {
+    return 0;
+  }
+  memcpy(c->last_prefix, word + dir_len, base_len);
+  c->last_prefix[base_len] = '\0';
+  const char *base = c->last_prefix;
+
+  trie_clear(&c->files);
+  c->last = &c->files;
+  const struct dircache_dir *listing = dircache_get(c->cache, dir);
+  if (listing == NULL) {
+    return 0;
+  }
+  const struct dircache_entry *found = NULL;
+  for (size_t i = 0; i < listing->n_entries; ++i) {
+    const char *name = listing->names + listing->entries[i].name;
+    if ((name[0] == '.' && base[0] != '.') || strncmp(name, base, base_len) != 0) {
+      continue;
+    }
+    if (trie_insert(&c->files, name) == -1) {
+      break;
+    }
+    found = &listing->entries[i];
+  }
+  char common[NAME_MAX + 1];
+  size_t n = trie_complete(&c->files, base, common, sizeof(common));
+  size_t n_insert = n > 0 ? strlen(common) - base_len : 0;
+  if (n > 0 && n_insert + 2 <= size) {
+    memcpy(insert, common + base_len, n_insert);
+    if (n == 1) {
+      bool is_dir = found->type == DT_DIR;
+      if (found->type == DT_LNK) {
+        struct stat st;
+        size_t end = strlen(dir);
+        if (end + strlen(common) < sizeof(dir)) {
+          strcpy(dir + end, common);
+          is_dir = stat(dir, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+      }
+      insert[n_insert++] = is_dir ? '/' : ' ';
+    }
+    insert[n_insert] = '\0';
+  }
+  dircache_release(c->cache, listing);
+  return n;
+}
+
+size_t complete_word(struct completion *c, const char *line, size_t pos, char *insert, size_t size) {
+  assert(c);
+  assert(line);
+  assert(insert && size > 0);
+
+  insert[0] = '\0';
+  c->last = NULL;
+  size_t start = pos;
+  while (start > 0 && strchr(SEPARATORS, line[start - 1]) == NULL) {
+    --start;
+  }
+  /* the position of a command : the beginning of the line or after a '|' */
+  size_t before = start;
+  while (before > 0 && (line[before - 1] == ' ' || line[before - 1] == '\t')) {
+    --before;
+  }
+  bool command = before == 0 || line[before - 1] == '|';
+  const char *word = line + start;
+  size_t len = pos - start;
+  if (!command || memchr(word, '/', len) != NULL) {
+    return complete_file(c, word, len, insert, size);
+  }
+
+  if (len >= sizeof(c->last_prefix) || complete_refresh(c) == -1) {
+    return 0;
+  }
+  memcpy(c->last_prefix, word, len);
+  c->last_prefix[len] = '\0';
+  c->last = &c->commands;
+  char common[NAME_MAX + 1];
+  size_t n = trie_complete(&c->commands, c->last_prefix, common, sizeof(common));
+  size_t n_insert = n > 0 ? strlen(common) - len : 0;
+  if (n > 0 && n_insert + 2 <= size) {
+    memcpy(insert, common + len, n_insert);
+    if (n == 1) {
+      insert[n_insert++] = ' ';
+    }
+    insert[n_insert] = '\0';
+  }
+  return n;
+}
+
+size_t complete_list(const struct completion *c, size_t max, void (*fn)(const char *name, void *data), void *data) {
+  assert(c);
+  if (c->last == NULL) {
+    return 0;
+  }
+  return trie_list(c->last, c->last_prefix, max, fn, data);
+}
@@ -0,0 +1,100 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "dircache.h"
+#include "trie.h"
+
+/**
+ * Directory of PATH and the names of its executables
+ */
+struct path_dir {
+  char *dir;
+  struct timespec mtime;  // modification time when the names were read
+  bool read;              // false until the names are read, or if they must be read again
+  char *names;            // the names, each one followed by a '\0'
+  char **sorted;          // pointers on the names, sorted
+  size_t n_names;
+};
+
+/**
+ * Completion of the words of a command line
+ *
+ * The names of the commands come from a trie of the executables of PATH and of
+ * the internal commands, built at the first completion. Then, before each completion,
+ * the directories of PATH whose modification time changed are read again, and only the
+ * names which appeared or disappeared are inserted in or removed from the trie. The
+ * filenames are put in a second trie, from the listings of the directory cache.
+ */
+struct completion {
+  struct trie commands;
+  struct trie files;               // names of the directory of the last filename completed
+  struct trie *last;               // trie of the last completion, NULL if none
+  char last_prefix[256];           // word completed last, or its last component for a filename
+  const char *const *builtins;     // names of the internal commands
+  size_t n_builtins;
+  struct dircache *cache;
+  char *path;                      // value of PATH the trie was built from, NULL before
+  struct path_dir *dirs;
+  size_t n_dirs;
+  unsigned long long rescans;      // number of directories of PATH read
+};
+
+/**
+ * Init a struct completion
+ *
+ * @param c pointer on the struct completion to initialize
+ * @param builtins names of the internal commands, kept by the structure
+ * @param n_builtins number of internal commands
+ * @param cache the directory cache giving the filenames
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+int complete_init(struct completion *c, const char *const *builtins, size_t n_builtins, struct dircache *cache);
+
+/**
+ * Free everything allocated by a struct completion
+ *
+ * @param c pointer on the struct completion
+ */
+void complete_destroy(struct completion *c);
+
+/**
+ * Bring the trie of the commands up to date with PATH and with its directories
+ *
+ * @param c pointer on the struct completion
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+int complete_refresh(struct completion *c);
+
+/**
+ * Complete the word of a command line which ends at the cursor
+ *
+ * A word in the position of a command (first of the line or after a '|') without
+ * '/' is completed with the names of the commands, any other word with the names
+ * of the files. When a single name matches, it is followed by a space, or by a '/'
+ * for a directory.
+ *
+ * @param c pointer on the struct completion
+ * @param line the command line
+ * @param pos the position of the cursor in "line"
+ * @param insert buffer receiving the characters to insert at the cursor, possibly none
+ * @param size size of "insert"
+ * @return the number of names matching the word
+ */
+size_t complete_word(struct completion *c, const char *line, size_t pos, char *insert, size_t size);
+
+/**
+ * Call a function on the names which matched the last completion, in lexicographic order
+ *
+ * @param c pointer on the struct completion
+ * @param max maximal number of names
+ * @param fn function called with each name and "data"
+ * @param data passed to "fn"
+ * @return the number of calls of "fn"
+ */
+size_t complete_list(const struct completion *c, size_t max, void (*fn)(const char *name, void *data), void *data);
+
+#endif
@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+#include "dircache.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DENTS_SIZE (1 << 18)
+#define MIN_SCRATCH 256
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+                    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+/**
+ * Entry read by getdents64, as laid out by the kernel
+ */
+struct dent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+int dircache_init(struct dircache *dc, size_t budget) {
+  assert(dc);
+  memset(dc, 0, sizeof(struct dircache));
+  dc->budget = budget;
+  dc->dents = malloc(DENTS_SIZE);
+  if (dc->dents == NULL) {
+    return -1;
+  }
+  dc->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  return 0;
+}
+
+/**
+ * Hashes a path with FNV-1a
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static unsigned long dircache_hash(const char *path, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ (unsigned char) path[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+/**
+ * Stops a watch unless a cached directory still uses it : the watch of an inode
+ * is shared by all the paths leading to it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dircache_unwatch(struct dircache *dc, int wd) {
+  if (wd == -1 || dc->inotify == -1) {
+    return;
+  }
+  for (struct dircache_dir *d = dc->by_wd[wd % DIRCACHE_BUCKETS]; d != NULL; d = d->next_wd) {
+    if (d->wd == wd) {
+      return;
+    }
+  }
+  inotify_rm_watch(dc->inotify, wd);
+}
+
+/**
+ * Removes a directory from the LRU list and from the buckets, stopping its watch,
+ * then frees it unless it is pinned
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dircache_detach(struct dircache *dc, struct dircache_dir *dir) {
+  struct dircache_dir **p = &dc->by_path[dir->hash % DIRCACHE_BUCKETS];
+  while (*p != dir) {
+    p = &(*p)->next_path;
+  }
+  *p = dir->next_path;
+  if (dir->wd != -1) {
+    p = &dc->by_wd[dir->wd % DIRCACHE_BUCKETS];
+    while (*p != dir) {
+      p = &(*p)->next_wd;
+    }
+    *p = dir->next_wd;
+    dircache_unwatch(dc, dir->wd);
+  }
+  if (dir->newer) {
+    dir->newer->older = dir->older;
+  } else {
+    dc->newest = dir->older;
+  }
+  if (dir->older) {
+    dir->older->newer = dir->newer;
+  } else {
+    dc->oldest = dir->newer;
+  }
+  dc->used -= dir->size;
+  --dc->n_dirs;
+  dir->stale = true;
+  if (dir->pins == 0) {
+    free(dir);
+  }
+}
+
+/**
+ * Evicts the least recently used directories which aren't pinned, until the budget is met
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dircache_trim(struct dircache *dc) {
+  struct dircache_dir *dir = dc->oldest;
+  while (dc->used > dc->budget && dir != NULL) {
+    struct dircache_dir *newer = dir->newer;
+    if (dir->pins == 0) {
+      dircache_detach(dc, dir);
+      ++dc->evictions;
+    }
+    dir = newer;
+  }
+}
+
+/**
+ * Invalidates the directories whose watch received an event, all of them if the queue overflowed
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dircache_drain(struct dircache *dc) {
+  if (dc->inotify == -1 || dc->n_dirs == 0) {
+    return;
+  }
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t n;
+  while ((n = read(dc->inotify, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len) {
+      const struct inotify_event *ev = (const struct inotify_event *) p;
+      if (ev->mask & IN_Q_OVERFLOW) {
+        while (dc->newest) {
+          dircache_detach(dc, dc->newest);
+          ++dc->invalidations;
+        }
+        continue;
+      }
+      if (ev->wd < 0) {
+        continue;
+      }
+      struct dircache_dir *dir = dc->by_wd[ev->wd % DIRCACHE_BUCKETS];
+      while (dir != NULL) {
+        struct dircache_dir *next = dir->next_wd;
+        if (dir->wd == ev->wd) {
+          dircache_detach(dc, dir);
+          ++dc->invalidations;
+        }
+        dir = next;
+      }
+    }
+  }
+}
+
+/**
+ * Appends an entry to the listing being read
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int dircache_push(struct dircache *dc, size_t n, size_t *names_len, const char *name, unsigned char type) {
+  size_t len = strlen(name) + 1;
+  if (n == dc->cap_scratch) {
+    size_t cap = dc->cap_scratch ? 2 * dc->cap_scratch : MIN_SCRATCH;
+    struct dircache_entry *bigger = realloc(dc->scratch, cap * sizeof(struct dircache_entry));
+    if (bigger == NULL) {
+      return -1;
+    }
+    dc->scratch = bigger;
+    dc->cap_scratch = cap;
+  }
+  if (*names_len + len > dc->cap_scratch_names) {
+    size_t cap = dc->cap_scratch_names ? dc->cap_scratch_names : MIN_SCRATCH * 16;
+    while (cap < *names_len + len) {
+      cap *= 2;
+    }
+    char *bigger = realloc(dc->scratch_names, cap);
+    if (bigger == NULL) {
+      return -1;
+    }
+    dc->scratch_names = bigger;
+    dc->cap_scratch_names = cap;
+  }
+  dc->scratch[n].name = *names_len;
+  dc->scratch[n].type = type;
+  memcpy(dc->scratch_names + *names_len, name, len);
+  *names_len += len;
+  return 0;
+}
+
+/**
+ * Reads a directory into a new listing, put in front of the LRU list
+ *
+ * The watch is added before the directory is read : an entry created during
+ * the reading invalidates the listing at the next lookup.
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the listing, NULL if the directory can't be read
+ */
+static struct dircache_dir *dircache_read(struct dircache *dc, const char *path, size_t path_len, unsigned long hash) {
+  int wd = dc->inotify == -1 ? -1 : inotify_add_watch(dc->inotify, path, WATCH_MASK);
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    if (fd != -1) {
+      close(fd);
+    }
+    dircache_unwatch(dc, wd);
+    return NULL;
+  }
+  size_t n = 0;
+  size_t names_len = 0;
+  bool failed = false;
+  long len;
+  while (!failed && (len = syscall(SYS_getdents64, fd, dc->dents, DENTS_SIZE)) > 0) {
+    for (long pos = 0; pos < len && !failed;) {
+      struct dent64 *d = (struct dent64 *) (dc->dents + pos);
+      pos += d->d_reclen;
+      const char *name = d->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+      unsigned char type = d->d_type;
+      struct stat est;
+      if (type == DT_UNKNOWN && fstatat(fd, name, &est, AT_SYMLINK_NOFOLLOW) == 0) {
+        type = IFTODT(est.st_mode);
+      }
+      failed = dircache_push(dc, n, &names_len, name, type) == -1;
+      ++n;
+    }
+  }
+  close(fd);
+
+  /* a single block : the structure, the path, the entries, then the names */
+  size_t align = __alignof__(struct dircache_entry);
+  size_t entries_off = (sizeof(struct dircache_dir) + path_len + 1 + align - 1) / align * align;
+  size_t size = entries_off + n * sizeof(struct dircache_entry) + names_len;
+  struct dircache_dir *dir = failed ? NULL : malloc(size);
+  if (dir == NULL) {
+    dircache_unwatch(dc, wd);
+    return NULL;
+  }
+  memcpy(dir->path, path, path_len);
+  dir->path[path_len] = '\0';
+  struct dircache_entry *entries = (struct dircache_entry *) ((char *) dir + entries_off);
+  char *names = (char *) (entries + n);
+  memcpy(entries, dc->scratch, n * sizeof(struct dircache_entry));
+  memcpy(names, dc->scratch_names, names_len);
+  dir->entries = entries;
+  dir->names = names;
+  dir->n_entries = n;
+  dir->size = size;
+  dir->hash = hash;
+  dir->wd = wd;
+  dir->pins = 0;
+  dir->stale = false;
+  dir->dev = st.st_dev;
+  dir->ino = st.st_ino;
+  dir->mtime = st.st_mtim;
+  /* the directory may change again during the same tick of its clock */
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  dir->unstable = now.tv_sec - st.st_mtim.tv_sec < 2;
+
+  dir->next_path = dc->by_path[hash % DIRCACHE_BUCKETS];
+  dc->by_path[hash % DIRCACHE_BUCKETS] = dir;
+  if (wd != -1) {
+    dir->next_wd = dc->by_wd[wd % DIRCACHE_BUCKETS];
+    dc->by_wd[wd % DIRCACHE_BUCKETS] = dir;
+  }
+  dir->newer = NULL;
+  dir->older = dc->newest;
+  if (dc->newest) {
+    dc->newest->newer = dir;
+  } else {
+    dc->oldest = dir;
+  }
+  dc->newest = dir;
+  dc->used += size;
+  ++dc->n_dirs;
+  return dir;
+}
+
+const struct dircache_dir *dircache_get(struct dircache *dc, const char *path) {
+  assert(dc);
+  assert(path);
+
+  /* "/a/b/" and "/a/b" are the same directory */
+  size_t len = strlen(path);
+  while (len > 1 && path[len - 1] == '/') {
+    --len;
+  }
+  unsigned long hash = dircache_hash(path, len);
+  dircache_drain(dc);
+
+  struct dircache_dir *dir = dc->by_path[hash % DIRCACHE_BUCKETS];
+  while (dir != NULL && (dir->hash != hash || strncmp(dir->path, path, len) != 0 || dir->path[len] != '\0')) {
+    dir = dir->next_path;
+  }
+  if (dir != NULL) {
+    /* the path may now lead to another directory, which no watch covers */
+    struct stat st;
+    bool valid = stat(dir->path, &st) == 0 && st.st_ino == dir->ino && st.st_dev == dir->dev;
+    if (valid && dir->wd == -1) {
+      valid = !dir->unstable && st.st_mtim.tv_sec == dir->mtime.tv_sec && st.st_mtim.tv_nsec == dir->mtime.tv_nsec;
+    }
+    if (!valid) {
+      dircache_detach(dc, dir);
+      ++dc->invalidations;
+      dir = NULL;
+    }
+  }
+  if (dir != NULL) {
+    ++dc->hits;
+    if (dc->newest != dir) {
+      /* moving the directory in front of the LRU list */
+      dir->newer->older = dir->older;
+      if (dir->older) {
+        dir->older->newer = dir->newer;
+      } else {
+        dc->oldest = dir->newer;
+      }
+      dir->newer = NULL;
+      dir->older = dc->newest;
+      dc->newest->newer = dir;
+      dc->newest = dir;
+    }
+  } else {
+    ++dc->misses;
+    char copy[len + 1];
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    dir = dircache_read(dc, copy, len, hash);
+    if (dir == NULL) {
+      return NULL;
+    }
+  }
+  ++dir->pins;
+  dircache_trim(dc);
+  return dir;
+}
+
+void dircache_release(struct dircache *dc, const struct dircache_dir *dir) {
+  assert(dc);
+  assert(dir);
+  struct dircache_dir *d = (struct dircache_dir *) dir;
+  assert(d->pins > 0);
+  if (--d->pins == 0) {
+    if (d->stale) {
+      free(d);
+    } else {
+      dircache_trim(dc);
+    }
+  }
+}
+
+void dircache_set_budget(struct dircache *dc, size_t budget) {
+  assert(dc);
+  dc->budget = budget;
+  dircache_trim(dc);
+}
+
+void dircache_clear(struct dircache *dc) {
+  assert(dc);
+  while (dc->newest) {
+    dircache_detach(dc, dc->newest);
+  }
+  dc->hits = dc->misses = dc->invalidations = dc->evictions = 0;
+}
+
+void dircache_forked(struct dircache *dc) {
+  assert(dc);
+  if (dc->inotify == -1) {
+    return;
+  }
+  /* the watches belong to the instance shared with the parent : they are left to it */
+  close(dc->inotify);
+  dc->inotify = -1;
+  while (dc->newest) {
+    dircache_detach(dc, dc->newest);
+  }
+}
+
+void dircache_print(const struct dircache *dc, FILE *out) {
+  assert(dc);
+  fprintf(out, "hits %llu\n", dc->hits);
+  fprintf(out, "misses %llu\n", dc->misses);
+  fprintf(out, "invalidations %llu\n", dc->invalidations);
+  fprintf(out, "evictions %llu\n", dc->evictions);
+  fprintf(out, "directories %zu\n", dc->n_dirs);
+  fprintf(out, "bytes %zu\n", dc->used);
+  fprintf(out, "budget %zu\n", dc->budget);
+  fprintf(out, "inotify %s\n", dc->inotify == -1 ? "no" : "yes");
+}
+
+void dircache_destroy(struct dircache *dc) {
+  assert(dc);
+  while (dc->newest) {
+    dircache_detach(dc, dc->newest);
+  }
+  if (dc->inotify != -1) {
+    close(dc->inotify);
+  }
+  free(dc->scratch_names);
+  free(dc->scratch);
+  free(dc->dents);
+}
@@ -0,0 +1,144 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define DIRCACHE_BUCKETS 4096
+#define DIRCACHE_BUDGET (16 << 20)
+
+/**
+ * Entry of a cached directory
+ */
+struct dircache_entry {
+  unsigned name;       // offset of the name in "names"
+  unsigned char type;  // d_type, resolved by fstatat when getdents64 gives DT_UNKNOWN : it stays so only if fstatat fails
+};
+
+/**
+ * Listing of a directory kept by the cache, in a single block of memory
+ */
+struct dircache_dir {
+  struct dircache_dir *next_path;  // next directory of the same bucket of paths
+  struct dircache_dir *next_wd;    // next directory of the same bucket of watches
+  struct dircache_dir *newer;      // LRU list, the most recently used first
+  struct dircache_dir *older;
+  unsigned long hash;
+  int wd;                          // inotify watch, -1 if the directory isn't watched
+  unsigned pins;                   // number of "dircache_get" not released yet
+  bool stale;                      // out of the cache, freed once it isn't pinned anymore
+  bool unstable;                   // modified during the second it was read
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  size_t size;                     // bytes counted against the budget
+  size_t n_entries;
+  const struct dircache_entry *entries;
+  const char *names;
+  char path[];
+};
+
+/**
+ * Cache of directory listings, keyed by path and validated by the inode and
+ * the modification time of the directory
+ *
+ * Each cached directory is watched with inotify : as long as no event arrives
+ * for it, a lookup costs a hash lookup and a stat. The directories which can't
+ * be watched are read again when their modification time changes. The least
+ * recently used listings are evicted to stay within the memory budget.
+ */
+struct dircache {
+  struct dircache_dir *by_path[DIRCACHE_BUCKETS];
+  struct dircache_dir *by_wd[DIRCACHE_BUCKETS];
+  struct dircache_dir *newest;
+  struct dircache_dir *oldest;
+  int inotify;            // -1 if inotify isn't available
+  size_t budget;
+  size_t used;            // bytes of the cached listings
+  size_t n_dirs;
+  unsigned long long hits;
+  unsigned long long misses;
+  unsigned long long invalidations;
+  unsigned long long evictions;
+  char *dents;            // getdents64 buffer
+  struct dircache_entry *scratch;  // listing being read
+  size_t cap_scratch;
+  char *scratch_names;
+  size_t cap_scratch_names;
+};
+
+/**
+ * Init a struct dircache
+ *
+ * @param dc pointer on the struct dircache to initialize
+ * @param budget number of bytes the listings may occupy
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+int dircache_init(struct dircache *dc, size_t budget);
+
+/**
+ * Free everything allocated by a struct dircache
+ *
+ * @param dc pointer on the struct dircache
+ */
+void dircache_destroy(struct dircache *dc);
+
+/**
+ * Returns the listing of a directory, from the cache if it is still valid, read otherwise
+ *
+ * The listing stays valid until "dircache_release" is called, even if the directory
+ * is invalidated or evicted meanwhile.
+ *
+ * @param dc pointer on the struct dircache
+ * @param path the absolute path of the directory
+ * @return the listing, "." and ".." excepted, NULL if the directory can't be read
+ */
+const struct dircache_dir *dircache_get(struct dircache *dc, const char *path);
+
+/**
+ * Releases a listing returned by "dircache_get"
+ *
+ * @param dc pointer on the struct dircache
+ * @param dir the listing
+ */
+void dircache_release(struct dircache *dc, const struct dircache_dir *dir);
+
+/**
+ * Changes the memory budget, evicting the least recently used listings if needed
+ *
+ * @param dc pointer on the struct dircache
+ * @param budget number of bytes the listings may occupy
+ */
+void dircache_set_budget(struct dircache *dc, size_t budget);
+
+/**
+ * Empties the cache and resets its counters
+ *
+ * @param dc pointer on the struct dircache
+ */
+void dircache_clear(struct dircache *dc);
+
+/**
+ * Makes the copy of a cache inherited by a child process usable by the child
+ *
+ * The inotify instance is shared with the parent : the child reading its events
+ * would steal them from the parent, whose listings would never be invalidated.
+ * The child closes its descriptor and forgets the listings validated by the
+ * events, the cache then validating the listings by their modification time.
+ *
+ * @param dc pointer on the struct dircache, in the child
+ */
+void dircache_forked(struct dircache *dc);
+
+/**
+ * Prints the counters of the cache, one "name value" pair per line
+ *
+ * @param dc pointer on the struct dircache
+ * @param out the stream
+ */
+void dircache_print(const struct dircache *dc, FILE *out);
+
+#endif
@@ -0,0 +1,555 @@
+#define _GNU_SOURCE
+#include "editor.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_LINE 256
+#define MAX_LISTED 200
+#define ESCAPE_DELAY_MS 50
+
+int ed_init(struct editor *ed, int fd, void (*prompt)(void), struct completion *completion, struct event_loop *loop,
+            struct history *history) {
+  assert(ed);
+  assert(prompt);
+  memset(ed, 0, sizeof(struct editor));
+  ed->fd = fd;
+  ed->prompt = prompt;
+  ed->completion = completion;
+  ed->loop = loop;
+  ed->history = history;
+  ed->hist_pos = -1;
+  if (!isatty(fd) || !isatty(1) || tcgetattr(fd, &ed->saved) == -1) {
+    return -1;
+  }
+  ed->buf = malloc(MIN_LINE);
+  if (ed->buf == NULL) {
+    return -1;
+  }
+  ed->cap = MIN_LINE;
+  ed->buf[0] = '\0';
+  return 0;
+}
+
+/**
+ * Switches the terminal to raw mode, or back to the settings it had before
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_raw(struct editor *ed, bool raw) {
+  if (raw == ed->raw) {
+    return;
+  }
+  if (raw) {
+    /* no echo, no line buffering, no signal : every key is handled by the editor */
+    struct termios t = ed->saved;
+    t.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    t.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    t.c_cflag |= CS8;
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    tcsetattr(ed->fd, TCSADRAIN, &t);
+  } else {
+    tcsetattr(ed->fd, TCSADRAIN, &ed->saved);
+  }
+  ed->raw = raw;
+}
+
+void ed_destroy(struct editor *ed) {
+  assert(ed);
+  ed_raw(ed, false);
+  free(ed->buf);
+  free(ed->typed);
+  ed->buf = NULL;
+  ed->typed = NULL;
+}
+
+/**
+ * Writes bytes on the standard output
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_write(const char *s, size_t n) {
+  while (n > 0) {
+    ssize_t done = write(1, s, n);
+    if (done == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    s += done;
+    n -= done;
+  }
+}
+
+/**
+ * Tells whether a byte continues a UTF-8 character
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static inline bool ed_continuation(char c) {
+  return ((unsigned char) c & 0xc0) == 0x80;
+}
+
+void ed_redraw(struct editor *ed) {
+  assert(ed);
+  ed_write("\r\x1b[K", 4);
+  if (ed->searching) {
+    const char *what = ed->search_failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`";
+    ed_write(what, strlen(what));
+    ed_write(ed->query, ed->query_len);
+    ed_write("': ", 3);
+  } else {
+    ed->prompt();
+  }
+  ed_write(ed->buf, ed->len);
+  size_t back = 0;
+  for (size_t i = ed->pos; i < ed->len; ++i) {
+    back += !ed_continuation(ed->buf[i]);
+  }
+  if (back > 0) {
+    char seq[32];
+    int n = snprintf(seq, sizeof(seq), "\x1b[%zuD", back);
+    ed_write(seq, n);
+  }
+}
+
+/**
+ * Returns the next key, waiting for it while reporting the background jobs
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @param timeout_ms maximal time to wait in milliseconds, -1 to wait as long as needed
+ * @return the byte read, -1 at the end of the input or when the time is over
+ */
+static int ed_key(struct editor *ed, int timeout_ms) {
+  while (ed->pending_pos == ed->n_pending) {
+    if (timeout_ms >= 0) {
+      struct pollfd pfd = { .fd = ed->fd, .events = POLLIN };
+      if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return -1;
+      }
+    } else if (ed->loop != NULL && ev_wait_input(ed->loop, ed->fd) == -1) {
+      return -1;
+    }
+    ssize_t n = read(ed->fd, ed->pending, ED_PENDING);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    ed->n_pending = n;
+    ed->pending_pos = 0;
+  }
+  return (unsigned char) ed->pending[ed->pending_pos++];
+}
+
+/**
+ * Inserts bytes at the cursor
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_insert(struct editor *ed, const char *s, size_t n) {
+  if (ed->len + n + 1 > ed->cap) {
+    size_t cap = 2 * ed->cap;
+    while (cap < ed->len + n + 1) {
+      cap *= 2;
+    }
+    char *bigger = realloc(ed->buf, cap);
+    if (bigger == NULL) {
+      return;
+    }
+    ed->buf = bigger;
+    ed->cap = cap;
+  }
+  memmove(ed->buf + ed->pos + n, ed->buf + ed->pos, ed->len - ed->pos + 1);
+  memcpy(ed->buf + ed->pos, s, n);
+  ed->pos += n;
+  ed->len += n;
+}
+
+/**
+ * Erases the bytes from "from" to "to", the cursor going to "from"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_erase(struct editor *ed, size_t from, size_t to) {
+  memmove(ed->buf + from, ed->buf + to, ed->len - to + 1);
+  ed->len -= to - from;
+  ed->pos = from;
+}
+
+/**
+ * Returns the position of the character before or after the cursor
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static size_t ed_move(const struct editor *ed, bool forward) {
+  size_t pos = ed->pos;
+  if (forward) {
+    while (pos < ed->len && ed_continuation(ed->buf[++pos])) {
+    }
+  } else {
+    while (pos > 0 && ed_continuation(ed->buf[--pos])) {
+    }
+  }
+  return pos;
+}
+
+/**
+ * Prints a name listed by the completion
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_print_name(const char *name, void *data) {
+  (void) data;
+  ed_write(name, strlen(name));
+  ed_write("  ", 2);
+}
+
+/**
+ * Completes the word before the cursor, or lists the names it may become
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_complete(struct editor *ed) {
+  if (ed->completion == NULL) {
+    return;
+  }
+  char insert[256];
+  size_t n = complete_word(ed->completion, ed->buf, ed->pos, insert, sizeof(insert));
+  if (insert[0] != '\0') {
+    ed_insert(ed, insert, strlen(insert));
+    ed->tabs = 0;
+    return;
+  }
+  if (n < 2 || ++ed->tabs < 2) {
+    ed_write("\a", 1);
+    return;
+  }
+  ed_write("\n", 1);
+  complete_list(ed->completion, MAX_LISTED, ed_print_name, NULL);
+  if (n > MAX_LISTED) {
+    char more[64];
+    int len = snprintf(more, sizeof(more), "... (%zu names)", n);
+    ed_write(more, len);
+  }
+  ed_write("\n", 1);
+  ed->tabs = 0;
+}
+
+/**
+ * Replaces the line by the given text, the cursor going to its end
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_set(struct editor *ed, const char *s, size_t n) {
+  ed_erase(ed, 0, ed->len);
+  ed_insert(ed, s, n);
+}
+
+/**
+ * Keeps a copy of the line typed, before it is replaced by the entries of the history
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int ed_save(struct editor *ed) {
+  char *typed = realloc(ed->typed, ed->len + 1);
+  if (typed == NULL) {
+    return -1;
+  }
+  memcpy(typed, ed->buf, ed->len + 1);
+  ed->typed = typed;
+  ed->typed_len = ed->len;
+  return 0;
+}
+
+/**
+ * Shows the previous or next entry of the history starting with the line typed,
+ * the entries being the same as the line shown being skipped
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_history(struct editor *ed, bool older) {
+  ed->hist_key = true;
+  if (ed->history == NULL || (ed->hist_pos == -1 && !older)) {
+    ed_write("\a", 1);
+    return;
+  }
+  if (ed->hist_pos == -1) {
+    if (ed_save(ed) == -1) {
+      return;
+    }
+    ed->hist_pos = history_size(ed->history);
+  }
+  ssize_t i = ed->hist_pos;
+  size_t len = 0;
+  const char *entry = NULL;
+  do {
+    i = history_search(ed->history, ed->typed, ed->typed_len, older ? i - 1 : i + 1,
+                       HISTORY_PREFIX | (older ? 0 : HISTORY_FORWARD));
+    if (i != -1) {
+      entry = history_get(ed->history, i, &len);
+    }
+  } while (i != -1 && len == ed->len && memcmp(entry, ed->buf, len) == 0);
+  if (i == -1 && older) {
+    ed_write("\a", 1);
+  } else if (i == -1) {
+    /* after the newest entry, the line typed */
+    ed_set(ed, ed->typed, ed->typed_len);
+    ed->hist_pos = -1;
+  } else {
+    ed_set(ed, entry, len);
+    ed->hist_pos = i;
+  }
+}
+
+/**
+ * Shows the entry of the history containing the text searched, from the entry "start"
+ * to the oldest one, the cursor going to the text
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @param skip true to skip the entries being the same as the line shown
+ * @return the entry found, -1 if none
+ */
+static ssize_t ed_find(struct editor *ed, ssize_t start, bool skip) {
+  ssize_t i = start + 1;
+  size_t len = 0;
+  const char *entry = NULL;
+  do {
+    i = history_search(ed->history, ed->query, ed->query_len, i - 1, 0);
+    if (i != -1) {
+      entry = history_get(ed->history, i, &len);
+    }
+  } while (i != -1 && skip && len == ed->len && memcmp(entry, ed->buf, len) == 0);
+  ed->search_failed = i == -1;
+  if (i != -1) {
+    ed_set(ed, entry, len);
+    ed->pos = (const char *) memmem(ed->buf, ed->len, ed->query, ed->query_len) - ed->buf;
+  }
+  return i;
+}
+
+/**
+ * Searches the history incrementally (Ctrl-R) until a key which isn't part of
+ * the search is typed : it is then handled as usual, with the entry found
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_search(struct editor *ed) {
+  if (ed->history == NULL || ed_save(ed) == -1) {
+    ed_write("\a", 1);
+    return;
+  }
+  ed->searching = true;
+  ed->search_failed = false;
+  ed->query_len = 0;
+  ssize_t found = -1;
+  for (;;) {
+    ed_redraw(ed);
+    int c = ed_key(ed, -1);
+    ssize_t newest = history_size(ed->history) - 1;
+    if (c == CTRL('R')) {
+      ssize_t i = ed->query_len > 0 ? ed_find(ed, found == -1 ? newest : found - 1, true) : -1;
+      if (i == -1) {
+        ed_write("\a", 1);
+      } else {
+        found = i;
+      }
+    } else if ((c == 127 || c == CTRL('H')) && ed->query_len > 0) {
+      while (ed->query_len > 0 && ed_continuation(ed->query[--ed->query_len])) {
+      }
+      found = -1;
+      if (ed->query_len == 0) {
+        ed_set(ed, ed->typed, ed->typed_len);
+        ed->search_failed = false;
+      } else {
+        found = ed_find(ed, newest, false);
+      }
+    } else if (c >= 32 && c != 127) {
+      if (ed->query_len + 1 < sizeof(ed->query)) {
+        ed->query[ed->query_len++] = c;
+        ssize_t i = ed_find(ed, found == -1 ? newest : found, false);
+        found = i == -1 ? found : i;
+      }
+    } else {
+      if (c == CTRL('G') || c == CTRL('C')) {
+        ed_set(ed, ed->typed, ed->typed_len);
+      } else if (c != -1) {
+        --ed->pending_pos;
+      }
+      break;
+    }
+  }
+  ed->searching = false;
+}
+
+/**
+ * Handles the escape sequence of a key : arrows, Home, End and Delete
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void ed_escape(struct editor *ed) {
+  int c = ed_key(ed, ESCAPE_DELAY_MS);
+  if (c != '[' && c != 'O') {
+    return;
+  }
+  c = ed_key(ed, ESCAPE_DELAY_MS);
+  int arg = 0;
+  while (c >= '0' && c <= '9') {
+    arg = 10 * arg + c - '0';
+    c = ed_key(ed, ESCAPE_DELAY_MS);
+  }
+  switch (c) {
+    case 'A':
+      ed_history(ed, true);
+      break;
+    case 'B':
+      ed_history(ed, false);
+      break;
+    case 'C':
+      ed->pos = ed_move(ed, true);
+      break;
+    case 'D':
+      ed->pos = ed_move(ed, false);
+      break;
+    case 'H':
+      ed->pos = 0;
+      break;
+    case 'F':
+      ed->pos = ed->len;
+      break;
+    case '~':
+      if (arg == 1 || arg == 7) {
+        ed->pos = 0;
+      } else if (arg == 4 || arg == 8) {
+        ed->pos = ed->len;
+      } else if (arg == 3 && ed->pos < ed->len) {
+        ed_erase(ed, ed->pos, ed_move(ed, true));
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+char *ed_read_line(struct editor *ed) {
+  assert(ed);
+
+  ed->len = ed->pos = 0;
+  ed->buf[0] = '\0';
+  ed->tabs = 0;
+  ed->hist_pos = -1;
+  ed_raw(ed, true);
+  ed_redraw(ed);
+  for (;;) {
+    int c = ed_key(ed, -1);
+    if (c != '\t') {
+      ed->tabs = 0;
+    }
+    ed->hist_key = false;
+    switch (c) {
+      case -1:
+        ed_write("\n", 1);
+        ed_raw(ed, false);
+        return ed->len > 0 ? ed->buf : NULL;
+      case '\r':
+      case '\n':
+        ed->pos = ed->len;
+        ed_redraw(ed);
+        ed_write("\n", 1);
+        ed_raw(ed, false);
+        return ed->buf;
+      case CTRL('D'):
+        if (ed->len == 0) {
+          ed_write("\n", 1);
+          ed_raw(ed, false);
+          return NULL;
+        }
+        if (ed->pos < ed->len) {
+          ed_erase(ed, ed->pos, ed_move(ed, true));
+        }
+        break;
+      case CTRL('C'):
+        ed_write("^C\n", 3);
+        ed->len = ed->pos = 0;
+        ed->buf[0] = '\0';
+        break;
+      case 127:
+      case CTRL('H'):
+        if (ed->pos > 0) {
+          size_t to = ed->pos;
+          ed_erase(ed, ed_move(ed, false), to);
+        }
+        break;
+      case CTRL('A'):
+        ed->pos = 0;
+        break;
+      case CTRL('E'):
+        ed->pos = ed->len;
+        break;
+      case CTRL('B'):
+        ed->pos = ed_move(ed, false);
+        break;
+      case CTRL('F'):
+        ed->pos = ed_move(ed, true);
+        break;
+      case CTRL('U'):
+        ed_erase(ed, 0, ed->pos);
+        break;
+      case CTRL('K'):
+        ed->buf[ed->len = ed->pos] = '\0';
+        break;
+      case CTRL('W'): {
+        size_t from = ed->pos;
+        while (from > 0 && ed->buf[from - 1] == ' ') {
+          --from;
+        }
+        while (from > 0 && ed->buf[from - 1] != ' ') {
+          --from;
+        }
+        ed_erase(ed, from, ed->pos);
+        break;
+      }
+      case CTRL('L'):
+        ed_write("\x1b[H\x1b[2J", 7);
+        break;
+      case '\t':
+        ed_complete(ed);
+        break;
+      case CTRL('P'):
+        ed_history(ed, true);
+        break;
+      case CTRL('N'):
+        ed_history(ed, false);
+        break;
+      case CTRL('R'):
+        ed_search(ed);
+        break;
+      case 27:
+        ed_escape(ed);
+        break;
+      default:
+        if (c >= 32) {
+          char ch = c;
+          ed_insert(ed, &ch, 1);
+        }
+        break;
+    }
+    if (!ed->hist_key) {
+      /* the line was edited : the next Up starts again from the newest entry */
+      ed->hist_pos = -1;
+    }
+    ed_redraw(ed);
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <termios.h>
+
+#include "complete.h"
+#include "events.h"
+#include "history.h"
+
+#define ED_PENDING 256
+
+/**
+ * Line editor of the interactive FiSH, reading a terminal in raw mode
+ *
+ * The keys : the printable characters are inserted at the cursor, Left/Right
+ * (or Ctrl-B/Ctrl-F), Home/End (or Ctrl-A/Ctrl-E) move it, Backspace and Delete
+ * erase a character, Ctrl-U/Ctrl-K erase before/after the cursor, Ctrl-W erases
+ * the previous word, Ctrl-L clears the screen, Ctrl-C gives up the line, Ctrl-D
+ * on an empty line ends the input, Enter runs the line and Tab completes the word
+ * before the cursor (twice to list the names when it can't go further).
+ * Up/Down (or Ctrl-P/Ctrl-N) go through the entries of the history starting with
+ * the text typed, Ctrl-R searches the entries containing the text typed next,
+ * Ctrl-R again going to an older one, Ctrl-G giving up the search and any other
+ * key keeping the entry found.
+ */
+struct editor {
+  int fd;                       // the terminal
+  struct termios saved;         // its settings outside of "ed_read_line"
+  bool raw;                     // true while the terminal is in raw mode
+  char *buf;                    // the line being edited, '\0' terminated
+  size_t len;
+  size_t cap;
+  size_t pos;                   // position of the cursor in "buf"
+  char pending[ED_PENDING];     // keys read but not handled yet
+  size_t n_pending;
+  size_t pending_pos;
+  unsigned tabs;                // number of successive Tab keys
+  void (*prompt)(void);         // prints the prompt
+  struct completion *completion;
+  struct event_loop *loop;
+  struct history *history;
+  ssize_t hist_pos;             // entry of the history shown, -1 if the line was typed
+  bool hist_key;                // true if the last key went through the history
+  char *typed;                  // the line typed before going through the history
+  size_t typed_len;
+  bool searching;               // true during a Ctrl-R search
+  bool search_failed;           // true if no entry contains the text searched
+  char query[256];              // the text searched
+  size_t query_len;
+};
+
+/**
+ * Init a struct editor
+ *
+ * @param ed pointer on the struct editor to initialize
+ * @param fd the terminal
+ * @param prompt function printing the prompt
+ * @param completion completion of the words, NULL if none
+ * @param loop the event loop reporting the background jobs while the keys are waited
+ * @param history the history of the command lines, NULL if none
+ * @return 0 on success, -1 if "fd" isn't a terminal or on a memory allocation failure
+ */
+int ed_init(struct editor *ed, int fd, void (*prompt)(void), struct completion *completion, struct event_loop *loop,
+            struct history *history);
+
+/**
+ * Free everything allocated by a struct editor, restoring the terminal
+ *
+ * @param ed pointer on the struct editor
+ */
+void ed_destroy(struct editor *ed);
+
+/**
+ * Print the prompt and edit a line, the terminal being in raw mode until it is entered
+ *
+ * @param ed pointer on the struct editor
+ * @return the line, without its '\n', valid until the next call, NULL at the end of the input
+ */
+char *ed_read_line(struct editor *ed);
+
+/**
+ * Print the prompt and the line being edited again, e.g. after messages were printed
+ *
+ * @param ed pointer on the struct editor
+ */
+void ed_redraw(struct editor *ed);
+
+#endif
@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+#include "events.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define MAX_EVENTS 64
+
+/* epoll data of the file descriptors, the other events carry the pid of a job */
+#define EV_FD (UINT64_C(1) << 63)
+
+int ev_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void) pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/**
+ * Reap a job whose pidfd is readable, then report it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static size_t ev_reap_job(struct event_loop *loop, pid_t pid) {
+  int wstatus;
+  struct rusage usage;
+  pid_t child = wait4(pid, &wstatus, WNOHANG, &usage);
+  if (child == 0 || (child == -1 && errno != ECHILD)) {
+    return 0;
+  }
+  struct job *job = job_table_find(loop->jobs, pid);
+  if (job != NULL) {
+    /* closing the pidfd also removes it from the epoll instance */
+    if (job->pidfd != -1) {
+      close(job->pidfd);
+    } else if (loop->sigfd == -1) {
+      --loop->unwatched;
+    }
+    job_table_remove(loop->jobs, pid);
+  }
+  if (child == -1) {
+    /* reaped elsewhere, nothing to report */
+    return 0;
+  }
+  if (loop->report != NULL) {
+    loop->report(pid, wstatus, &usage);
+  }
+  return 1;
+}
+
+/**
+ * Reap the jobs which have no pidfd, when pidfd_open failed for them
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static size_t ev_reap_unwatched(struct event_loop *loop) {
+  size_t reaped = 0;
+  struct job_table *jobs = loop->jobs;
+  for (size_t i = 0; i < jobs->capacity; ++i) {
+    pid_t pid = jobs->slots[i].pid;
+    if (pid != JOB_FREE && pid != JOB_DELETED && jobs->slots[i].pidfd == -1) {
+      reaped += ev_reap_job(loop, pid);
+    }
+  }
+  return reaped;
+}
+
+/**
+ * Handle the events returned by epoll_wait
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the number of jobs reaped, "*ready" being set if the input can be read
+ */
+static size_t ev_dispatch(struct event_loop *loop, const struct epoll_event *events, int n, bool *ready) {
+  size_t reaped = 0;
+  for (int i = 0; i < n; ++i) {
+    uint64_t data = events[i].data.u64;
+    if (!(data & EV_FD)) {
+      reaped += ev_reap_job(loop, (pid_t) data);
+    } else if ((int) (data & ~EV_FD) == loop->sigfd) {
+      /* draining the signalfd : SIGCHLD signals coalesce, the reaping loop handles them all */
+      struct signalfd_siginfo info[8];
+      while (read(loop->sigfd, info, sizeof(info)) > 0) {
+      }
+      reaped += job_table_reap(loop->jobs, loop->report);
+    } else if ((int) (data & ~EV_FD) == loop->input) {
+      *ready = true;
+    }
+  }
+  return reaped;
+}
+
+int ev_init(struct event_loop *loop, struct job_table *jobs,
+            void (*report)(pid_t pid, int wstatus, const struct rusage *usage)) {
+  assert(loop);
+  assert(jobs);
+  loop->sigfd = -1;
+  loop->input = -1;
+  loop->unwatched = 0;
+  loop->jobs = jobs;
+  loop->report = report;
+  loop->redraw = NULL;
+  loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epfd == -1) {
+    perror("epoll_create1");
+    return -1;
+  }
+
+  /* probing pidfd support on ourselves */
+  int probe = ev_pidfd(getpid());
+  if (probe != -1) {
+    close(probe);
+    return 0;
+  }
+
+  /* no pidfds : SIGCHLD stays blocked and is read from a signalfd */
+  sigset_t chld;
+  sigemptyset(&chld);
+  sigaddset(&chld, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &chld, NULL);
+  loop->sigfd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+  struct epoll_event ev = { .events = EPOLLIN, .data.u64 = EV_FD | (uint64_t) loop->sigfd };
+  if (loop->sigfd == -1 || epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->sigfd, &ev) == -1) {
+    perror("signalfd");
+    ev_destroy(loop);
+    return -1;
+  }
+  return 0;
+}
+
+void ev_destroy(struct event_loop *loop) {
+  assert(loop);
+  struct job_table *jobs = loop->jobs;
+  for (size_t i = 0; i < jobs->capacity; ++i) {
+    pid_t pid = jobs->slots[i].pid;
+    if (pid != JOB_FREE && pid != JOB_DELETED && jobs->slots[i].pidfd != -1) {
+      close(jobs->slots[i].pidfd);
+      jobs->slots[i].pidfd = -1;
+    }
+  }
+  if (loop->sigfd != -1) {
+    close(loop->sigfd);
+    loop->sigfd = -1;
+  }
+  if (loop->epfd != -1) {
+    close(loop->epfd);
+    loop->epfd = -1;
+  }
+}
+
+int ev_watch(struct event_loop *loop, pid_t pid) {
+  assert(loop);
+  if (loop->sigfd != -1) {
+    /* the signalfd reports every child */
+    return 0;
+  }
+  struct job *job = job_table_find(loop->jobs, pid);
+  if (job == NULL) {
+    return -1;
+  }
+  /* the job isn't reaped before being watched, so its pid can't be reused meanwhile,
+     and pidfds are always close-on-exec */
+  int pidfd = ev_pidfd(pid);
+  struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t) pid };
+  if (pidfd == -1 || epoll_ctl(loop->epfd, EPOLL_CTL_ADD, pidfd, &ev) == -1) {
+    if (pidfd != -1) {
+      close(pidfd);
+    }
+    ++loop->unwatched;
+    return -1;
+  }
+  job->pidfd = pidfd;
+  return 0;
+}
+
+size_t ev_poll(struct event_loop *loop) {
+  assert(loop);
+  size_t reaped = 0;
+  struct epoll_event events[MAX_EVENTS];
+  int n;
+  bool ready = false;
+  do {
+    n = epoll_wait(loop->epfd, events, MAX_EVENTS, 0);
+    if (n > 0) {
+      reaped += ev_dispatch(loop, events, n, &ready);
+    }
+  } while (n == MAX_EVENTS);
+  if (loop->unwatched > 0) {
+    reaped += ev_reap_unwatched(loop);
+  }
+  return reaped;
+}
+
+int ev_wait_input(struct event_loop *loop, int fd) {
+  assert(loop);
+  if (loop->input != fd) {
+    if (loop->input != -1) {
+      epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->input, NULL);
+      loop->input = -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = EV_FD | (uint64_t) fd };
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      /* regular files can't be watched, and can always be read */
+      return errno == EPERM ? 0 : -1;
+    }
+    loop->input = fd;
+  }
+
+  struct epoll_event events[MAX_EVENTS];
+  for (;;) {
+    /* the jobs without pidfd wake nobody up : they are reaped at the latest on the next input */
+    if (loop->unwatched > 0 && ev_reap_unwatched(loop) > 0 && loop->redraw != NULL) {
+      loop->redraw();
+    }
+    int n = epoll_wait(loop->epfd, events, MAX_EVENTS, -1);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait");
+      return -1;
+    }
+    bool ready = false;
+    if (ev_dispatch(loop, events, n, &ready) > 0 && !ready && loop->redraw != NULL) {
+      loop->redraw();
+    }
+    if (ready) {
+      return 0;
+    }
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "util.h"
+
+/**
+ * Event loop of FiSH
+ *
+ * An epoll instance watches the input of the shell together with one pidfd per
+ * background job, so that jobs are reaped and reported synchronously, between two
+ * commands, instead of in a SIGCHLD handler. When pidfds aren't supported by the kernel,
+ * SIGCHLD is blocked and received through a signalfd instead.
+ */
+struct event_loop {
+  int epfd;
+  int sigfd;    // signalfd for SIGCHLD, -1 when pidfds are used
+  int input;    // file descriptor watched by "ev_wait_input", -1 if none yet
+  size_t unwatched; // number of jobs without pidfd, polled with waitpid instead
+  struct job_table *jobs;
+  void (*report)(pid_t pid, int wstatus, const struct rusage *usage); // called for each reaped job
+  void (*redraw)(void); // called after jobs have been reported while waiting for input, may be NULL
+};
+
+/**
+ * Init the event loop
+ *
+ * @param loop pointer on the struct event_loop to initialize
+ * @param jobs the job table of the shell
+ * @param report function called for each reaped job, with the resources it used
+ * @return 0 on success, -1 on failure (the reason is printed)
+ */
+int ev_init(struct event_loop *loop, struct job_table *jobs,
+            void (*report)(pid_t pid, int wstatus, const struct rusage *usage));
+
+/**
+ * Close the file descriptors used by the event loop
+ *
+ * @param loop pointer on the struct event_loop
+ */
+void ev_destroy(struct event_loop *loop);
+
+/**
+ * Open a pidfd on a child process, readable once the child has terminated
+ *
+ * @param pid pid of the child
+ * @return the pidfd (close-on-exec), -1 if pidfds aren't supported
+ */
+int ev_pidfd(pid_t pid);
+
+/**
+ * Watch a background job, once it has been added to the job table
+ *
+ * @param loop pointer on the struct event_loop
+ * @param pid pid of the job
+ * @return 0 on success, -1 on failure (the job will still be reaped by "ev_poll" then)
+ */
+int ev_watch(struct event_loop *loop, pid_t pid);
+
+/**
+ * Reap and report the terminated jobs, without blocking
+ *
+ * @param loop pointer on the struct event_loop
+ * @return the number of jobs reaped
+ */
+size_t ev_poll(struct event_loop *loop);
+
+/**
+ * Wait until a file descriptor can be read, reaping and reporting the jobs meanwhile
+ *
+ * @param loop pointer on the struct event_loop
+ * @param fd file descriptor to wait for
+ * @return 0 when "fd" can be read (or is at its end), -1 on failure
+ */
+int ev_wait_input(struct event_loop *loop, int fd);
+
+#endif
@@ -0,0 +1,695 @@
+#define _GNU_SOURCE
+#include "expand.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DENTS_SIZE (1 << 18)
+#define MIN_PATHS 16
+#define MIN_POOL 1024
+#define MIN_NODES 16
+#define MIN_COMPS 8
+
+/**
+ * Operations of a compiled pattern component
+ */
+enum pat_op {
+  PAT_CHAR,   // the character "c"
+  PAT_ANY,    // any character
+  PAT_STAR,   // any string
+  PAT_CLASS,  // any character of "set"
+};
+
+/**
+ * Node of a compiled pattern component
+ */
+struct pat_node {
+  enum pat_op op;
+  unsigned char c;
+  uint64_t set[4];  // bitmap of the 256 bytes
+};
+
+/**
+ * Component of a pattern, between two '/'
+ */
+struct pat_comp {
+  const char *text;  // the component, '\0' terminated
+  size_t first;      // first node of the component in "nodes"
+  size_t n_nodes;
+  bool magic;        // false if "text" is matched literally
+  bool globstar;     // true for "**"
+  size_t tail;       // nodes after the last star, matched first at the end of the names
+  size_t min_len;    // number of nodes which aren't stars
+  bool star;         // true if the component holds a star
+  bool dot;          // true if it may match a name starting with '.'
+};
+
+/**
+ * Entry read by getdents64, as laid out by the kernel
+ */
+struct dent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+/**
+ * Directory read in batches of entries
+ */
+struct dir_scan {
+  const struct dircache_dir *cached;  // listing of the cache, NULL when read with getdents64
+  size_t next;                        // next entry of "cached"
+  int fd;
+  char *buf;
+  long len;
+  long pos;
+};
+
+/**
+ * State of a walk along the pattern
+ */
+struct walk {
+  struct expansion *e;
+  const struct pat_comp *comps;
+  size_t n_comps;
+  bool dir_only;            // the pattern ends with a '/'
+  bool failed;              // memory allocation failure
+  bool below;               // the walk goes down into a subdirectory matched by "**"
+  size_t skip;              // length of the working directory added in front of "path" for the cache
+  char path[PATH_MAX + 1];  // path of the current directory, ending with a '/' unless empty
+};
+
+/**
+ * Listing of the directories which can't be read
+ */
+static const struct dircache_dir no_entries;
+
+void expand_init(struct expansion *e) {
+  assert(e);
+  memset(e, 0, sizeof(struct expansion));
+}
+
+void expand_destroy(struct expansion *e) {
+  assert(e);
+  for (size_t i = 0; i < e->n_dents; ++i) {
+    free(e->dents[i]);
+  }
+  free(e->dents);
+  free(e->comps);
+  free(e->nodes);
+  free(e->pool);
+  free(e->paths);
+  expand_init(e);
+}
+
+bool expand_has_magic(const char *word, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (word[i] == '*' || word[i] == '?') {
+      return true;
+    }
+    if (word[i] == '[') {
+      /* the class ends at a ']' which isn't first, as in "pat_compile", and never spans a '/' */
+      size_t j = i + 1;
+      j += j < len && (word[j] == '!' || word[j] == '^');
+      size_t start = j;
+      while (j < len && word[j] != '/' && (word[j] != ']' || j == start)) {
+        ++j;
+      }
+      if (j < len && word[j] == ']') {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Grows an array so that it holds at least "n" elements
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int expand_reserve(struct expansion *e, void **array, size_t *cap, size_t n, size_t size, size_t min) {
+  if (n <= *cap) {
+    return 0;
+  }
+  size_t new_cap = *cap ? *cap : min;
+  while (new_cap < n) {
+    new_cap *= 2;
+  }
+  void *bigger = realloc(*array, new_cap * size);
+  if (bigger == NULL) {
+    return -1;
+  }
+  *array = bigger;
+  *cap = new_cap;
+  ++e->n_allocs;
+  return 0;
+}
+
+/**
+ * Compiles a component of a pattern into nodes appended to "e->nodes"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int pat_compile(struct expansion *e, struct pat_comp *comp, size_t first) {
+  const unsigned char *s = (const unsigned char *) comp->text;
+  size_t len = strlen(comp->text);
+  /* no component has more nodes than characters */
+  if (expand_reserve(e, &e->nodes, &e->cap_nodes, first + len, sizeof(struct pat_node), MIN_NODES) == -1) {
+    return -1;
+  }
+  struct pat_node *nodes = e->nodes;
+  size_t n = first;
+  for (size_t i = 0; i < len; ++i) {
+    struct pat_node *node = &nodes[n];
+    if (s[i] == '*') {
+      if (n == first || nodes[n - 1].op != PAT_STAR) {
+        node->op = PAT_STAR;
+        ++n;
+      }
+      continue;
+    }
+    if (s[i] == '?') {
+      node->op = PAT_ANY;
+      ++n;
+      continue;
+    }
+    if (s[i] == '[') {
+      /* a class : [abc], [a-z], [!a-z] or [^a-z], a ']' being literal in first position */
+      size_t j = i + 1;
+      bool negate = j < len && (s[j] == '!' || s[j] == '^');
+      j += negate;
+      size_t start = j;
+      while (j < len && (s[j] != ']' || j == start)) {
+        ++j;
+      }
+      if (j < len) {
+        memset(node->set, 0, sizeof(node->set));
+        for (size_t k = start; k < j; ++k) {
+          unsigned lo = s[k], hi = s[k];
+          if (k + 2 < j && s[k + 1] == '-') {
+            hi = s[k + 2];
+            k += 2;
+          }
+          for (unsigned c = lo; c <= hi; ++c) {
+            node->set[c >> 6] |= UINT64_C(1) << (c & 63);
+          }
+        }
+        if (negate) {
+          for (size_t k = 0; k < 4; ++k) {
+            node->set[k] = ~node->set[k];
+          }
+        }
+        node->op = PAT_CLASS;
+        ++n;
+        i = j;
+        continue;
+      }
+      /* without its ']', a '[' is an ordinary character */
+    }
+    if (s[i] == '\\' && i + 1 < len) {
+      ++i;
+    }
+    node->op = PAT_CHAR;
+    node->c = s[i];
+    ++n;
+  }
+  comp->first = first;
+  comp->n_nodes = n - first;
+  comp->dot = comp->n_nodes > 0 && nodes[first].op == PAT_CHAR && nodes[first].c == '.';
+  comp->star = false;
+  comp->tail = comp->min_len = 0;
+  for (size_t i = first; i < n; ++i) {
+    if (nodes[i].op == PAT_STAR) {
+      comp->star = true;
+      comp->tail = 0;
+    } else {
+      ++comp->min_len;
+      ++comp->tail;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Tells whether a character is matched by a node which isn't a star
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static inline bool pat_node_match(const struct pat_node *node, unsigned char c) {
+  switch (node->op) {
+    case PAT_CHAR:
+      return node->c == c;
+    case PAT_CLASS:
+      return (node->set[c >> 6] >> (c & 63)) & 1;
+    default:
+      return node->op == PAT_ANY;
+  }
+}
+
+/**
+ * Matches a name against a compiled component
+ *
+ * The nodes after the last star only fit the end of the name : they are checked
+ * first, which rejects most names at once with patterns like "*.c". Then, on a
+ * mismatch, only the last star is backtracked : it is enough since a star matches
+ * anything the previous ones would have matched, so the cost stays linear in the
+ * length of the name times the number of nodes.
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool pat_match(const struct pat_comp *comp, const struct pat_node *nodes, const char *name) {
+  const unsigned char *s = (const unsigned char *) name;
+  size_t len = strlen(name);
+  size_t n_nodes = comp->n_nodes;
+  if (len < comp->min_len || (!comp->star && len != n_nodes)) {
+    return false;
+  }
+  const unsigned char *end = s + len;
+  if (comp->star) {
+    end -= comp->tail;
+    n_nodes -= comp->tail;
+    for (size_t i = 0; i < comp->tail; ++i) {
+      if (!pat_node_match(&nodes[n_nodes + i], end[i])) {
+        return false;
+      }
+    }
+  }
+
+  const unsigned char *star_s = NULL;
+  size_t star_i = 0;
+  size_t i = 0;
+  while (s < end) {
+    if (i < n_nodes && nodes[i].op == PAT_STAR) {
+      star_i = ++i;
+      star_s = s;
+      continue;
+    }
+    if (i < n_nodes && pat_node_match(&nodes[i], *s)) {
+      ++i;
+      ++s;
+      continue;
+    }
+    if (star_s == NULL) {
+      return false;
+    }
+    i = star_i;
+    s = ++star_s;
+  }
+  while (i < n_nodes && nodes[i].op == PAT_STAR) {
+    ++i;
+  }
+  return i == n_nodes;
+}
+
+/**
+ * Returns the next entry of a directory, "." and ".." excepted, reading a new
+ * batch of entries with getdents64 once the buffer is consumed
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @param type set to the d_type of the entry
+ * @return the name of the entry, NULL at the end of the directory or on error
+ */
+static const char *dir_next(struct dir_scan *ds, unsigned char *type) {
+  if (ds->cached) {
+    if (ds->next == ds->cached->n_entries) {
+      return NULL;
+    }
+    const struct dircache_entry *entry = &ds->cached->entries[ds->next++];
+    *type = entry->type;
+    return ds->cached->names + entry->name;
+  }
+  for (;;) {
+    while (ds->pos < ds->len) {
+      struct dent64 *d = (struct dent64 *) (ds->buf + ds->pos);
+      ds->pos += d->d_reclen;
+      const char *name = d->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+      *type = d->d_type;
+      return name;
+    }
+    ds->len = syscall(SYS_getdents64, ds->fd, ds->buf, DENTS_SIZE);
+    ds->pos = 0;
+    if (ds->len <= 0) {
+      return NULL;
+    }
+  }
+}
+
+/**
+ * Starts reading a directory : from the cache if the walk has one, otherwise with the
+ * getdents64 buffer of its depth, the subdirectories being read with the buffers of
+ * the next depths
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int dir_open(struct walk *w, struct dir_scan *ds, int fd, size_t depth) {
+  struct expansion *e = w->e;
+  ds->cached = NULL;
+  ds->next = 0;
+  ds->len = ds->pos = 0;
+  if (e->cache) {
+    /* a directory which can't be read is empty */
+    ds->cached = dircache_get(e->cache, w->path);
+    if (ds->cached == NULL) {
+      ds->cached = &no_entries;
+    }
+    return 0;
+  }
+  while (depth >= e->n_dents) {
+    size_t cap = e->n_dents;
+    if (expand_reserve(e, (void **) &e->dents, &cap, e->n_dents + 1, sizeof(char *), 1) == -1) {
+      return -1;
+    }
+    char *buf = malloc(DENTS_SIZE);
+    if (buf == NULL) {
+      return -1;
+    }
+    ++e->n_allocs;
+    e->dents[e->n_dents++] = buf;
+  }
+  ds->fd = fd;
+  ds->buf = e->dents[depth];
+  return 0;
+}
+
+/**
+ * Stops reading a directory
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dir_close(struct walk *w, struct dir_scan *ds) {
+  if (ds->cached && ds->cached != &no_entries) {
+    dircache_release(w->e->cache, ds->cached);
+  }
+}
+
+/**
+ * Appends "name" to the path of the walk
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the new length of the path, 0 if it is too long
+ */
+static size_t walk_append(struct walk *w, size_t len, const char *name, bool slash) {
+  size_t n = strlen(name);
+  if (len + n + slash > PATH_MAX) {
+    return 0;
+  }
+  memcpy(w->path + len, name, n);
+  len += n;
+  if (slash) {
+    w->path[len++] = '/';
+  }
+  w->path[len] = '\0';
+  return len;
+}
+
+/**
+ * Stats "name" in the current directory of the walk, given by "dirfd" or,
+ * when the walk goes through the cache, by the absolute path of the walk
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int walk_stat(struct walk *w, int dirfd, size_t len, const char *name, struct stat *st, int flags) {
+  if (dirfd != -1) {
+    return fstatat(dirfd, name, st, flags);
+  }
+  if (walk_append(w, len, name, false) == 0) {
+    return -1;
+  }
+  int err = fstatat(AT_FDCWD, w->path, st, flags);
+  w->path[len] = '\0';
+  return err;
+}
+
+/**
+ * Tells whether an entry is a directory, following the symbolic links if "follow" is true
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool walk_is_dir(struct walk *w, int dirfd, size_t len, const char *name, unsigned char type, bool follow) {
+  if (type == DT_DIR) {
+    return true;
+  }
+  if (type != DT_UNKNOWN && (type != DT_LNK || !follow)) {
+    return false;
+  }
+  struct stat st;
+  return walk_stat(w, dirfd, len, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+ * Adds the path of the walk, followed by "name", to the matches
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void walk_emit(struct walk *w, size_t len, const char *name) {
+  struct expansion *e = w->e;
+  size_t n = strlen(name);
+  len -= w->skip;
+  size_t size = len + n + w->dir_only + 1;
+  if (expand_reserve(e, (void **) &e->pool, &e->pool_cap, e->pool_len + size, 1, MIN_POOL) == -1
+      || expand_reserve(e, (void **) &e->paths, &e->cap_paths, e->n_paths + 1, sizeof(char *), MIN_PATHS) == -1) {
+    w->failed = true;
+    return;
+  }
+  char *dst = e->pool + e->pool_len;
+  memcpy(dst, w->path + w->skip, len);
+  memcpy(dst + len, name, n);
+  if (w->dir_only) {
+    dst[len + n] = '/';
+  }
+  dst[size - 1] = '\0';
+  /* the pool may move until the end of the walk : offsets are stored for now */
+  e->paths[e->n_paths++] = (char *) (uintptr_t) e->pool_len;
+  e->pool_len += size;
+}
+
+static void walk(struct walk *w, int dirfd, size_t len, size_t c, size_t depth);
+
+/**
+ * Continues the walk in the subdirectory "name" of the current directory
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void walk_into(struct walk *w, int dirfd, size_t len, const char *name, size_t c, size_t depth) {
+  size_t sub_len = walk_append(w, len, name, true);
+  if (sub_len == 0) {
+    return;
+  }
+  if (dirfd == -1) {
+    walk(w, -1, sub_len, c, depth + 1);
+  } else {
+    int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+      walk(w, fd, sub_len, c, depth + 1);
+      close(fd);
+    }
+  }
+  w->path[len] = '\0';
+}
+
+/**
+ * Matches the components from "c" in the current directory, whose path is the "len"
+ * first characters of "w->path" : "dirfd" is an open descriptor of it, or -1 when
+ * the walk goes through the cache
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void walk(struct walk *w, int dirfd, size_t len, size_t c, size_t depth) {
+  if (w->failed) {
+    return;
+  }
+  const struct pat_comp *comp = &w->comps[c];
+  bool last = c + 1 == w->n_comps;
+
+  if (!comp->magic) {
+    if (!last) {
+      walk_into(w, dirfd, len, comp->text, c + 1, depth);
+      return;
+    }
+    struct stat st;
+    if (walk_stat(w, dirfd, len, comp->text, &st, w->dir_only ? 0 : AT_SYMLINK_NOFOLLOW) == 0
+        && (!w->dir_only || S_ISDIR(st.st_mode))) {
+      walk_emit(w, len, comp->text);
+    }
+    return;
+  }
+
+  /* "**" : no directory at all, then every directory below */
+  bool below = w->below;
+  w->below = false;
+  if (comp->globstar && !last) {
+    walk(w, dirfd, len, c + 1, depth);
+    if (dirfd != -1) {
+      lseek(dirfd, 0, SEEK_SET);
+    }
+  }
+  /* like the globstar of bash, a final "**" matches the directory it starts from,
+     with a trailing '/', then the ones below without it */
+  if (comp->globstar && last && !below && len > w->skip) {
+    struct stat st;
+    if (dirfd != -1 || (stat(w->path, &st) == 0 && S_ISDIR(st.st_mode))) {
+      walk_emit(w, w->dir_only ? len - 1 : len, "");
+    }
+  }
+  struct dir_scan ds;
+  if (dir_open(w, &ds, dirfd, depth) == -1) {
+    w->failed = true;
+    return;
+  }
+  const struct pat_node *nodes = (const struct pat_node *) w->e->nodes + comp->first;
+  const char *name;
+  unsigned char type;
+  while (!w->failed && (name = dir_next(&ds, &type)) != NULL) {
+    if (name[0] == '.' && !comp->dot) {
+      continue;
+    }
+    if (comp->globstar) {
+      bool is_dir = walk_is_dir(w, dirfd, len, name, type, false);
+      if (last && (!w->dir_only || is_dir)) {
+        walk_emit(w, len, name);
+      }
+      if (is_dir) {
+        w->below = true;
+        walk_into(w, dirfd, len, name, c, depth);
+        w->below = false;
+      }
+      continue;
+    }
+    if (!pat_match(comp, nodes, name)) {
+      continue;
+    }
+    if (last) {
+      if (!w->dir_only || walk_is_dir(w, dirfd, len, name, type, true)) {
+        walk_emit(w, len, name);
+      }
+    } else if (walk_is_dir(w, dirfd, len, name, type, true)) {
+      walk_into(w, dirfd, len, name, c + 1, depth);
+    }
+  }
+  dir_close(w, &ds);
+}
+
+/**
+ * Compares two paths for qsort
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int path_cmp(const void *a, const void *b) {
+  return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+ssize_t expand_glob(struct expansion *e, const char *pattern) {
+  assert(e);
+  assert(pattern);
+
+  e->n_paths = 0;
+  e->pool_len = 0;
+  size_t len = strlen(pattern);
+  if (len > PATH_MAX) {
+    return 0;
+  }
+  char text[len + 1];
+  memcpy(text, pattern, len + 1);
+
+  /* splitting the pattern into its components, empty ones being dropped */
+  bool absolute = text[0] == '/';
+  size_t n_slashes = 0;
+  for (size_t i = 0; i < len; ++i) {
+    n_slashes += text[i] == '/';
+  }
+  if (expand_reserve(e, &e->comps, &e->cap_comps, n_slashes + 1, sizeof(struct pat_comp), MIN_COMPS) == -1) {
+    return -1;
+  }
+  struct pat_comp *comps = e->comps;
+  size_t n_comps = 0;
+  size_t n_nodes = 0;
+  bool magic = false;
+  for (char *s = text, *end; *s; s = end) {
+    end = strchr(s, '/');
+    if (end == NULL) {
+      end = s + strlen(s);
+    } else {
+      *end++ = '\0';
+    }
+    if (*s == '\0') {
+      continue;
+    }
+    struct pat_comp *comp = &comps[n_comps++];
+    comp->text = s;
+    comp->magic = expand_has_magic(s, strlen(s));
+    comp->globstar = strcmp(s, "**") == 0;
+    if (comp->magic) {
+      if (pat_compile(e, comp, n_nodes) == -1) {
+        return -1;
+      }
+      n_nodes += comp->n_nodes;
+      magic = true;
+    }
+  }
+  if (!magic) {
+    return 0;
+  }
+
+  struct walk w;
+  w.e = e;
+  w.comps = comps;
+  w.n_comps = n_comps;
+  w.dir_only = len > 0 && pattern[len - 1] == '/';
+  w.failed = false;
+  w.below = false;
+  w.skip = 0;
+  w.path[0] = '\0';
+  size_t start = absolute ? walk_append(&w, 0, "", true) : 0;
+  if (e->cache) {
+    /* the cache is keyed by absolute paths */
+    if (!absolute) {
+      if (getcwd(w.path, PATH_MAX) == NULL) {
+        return 0;
+      }
+      start = w.skip = walk_append(&w, strlen(w.path), w.path[1] ? "/" : "", false);
+    }
+    walk(&w, -1, start, 0, 0);
+  } else {
+    int fd = open(absolute ? "/" : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+      return 0;
+    }
+    walk(&w, fd, start, 0, 0);
+    close(fd);
+  }
+  if (w.failed) {
+    e->n_paths = 0;
+    return -1;
+  }
+
+  if (e->n_paths == 0) {
+    return 0;
+  }
+  for (size_t i = 0; i < e->n_paths; ++i) {
+    e->paths[i] = e->pool + (uintptr_t) e->paths[i];
+  }
+  qsort(e->paths, e->n_paths, sizeof(char *), path_cmp);
+  return e->n_paths;
+}
@@ -0,0 +1,77 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "dircache.h"
+
+/**
+ * Paths matched by a glob pattern
+ *
+ * All the arrays are kept from one expansion to the next, so that expanding
+ * patterns of similar sizes again needs no allocation at all.
+ */
+struct expansion {
+  struct dircache *cache;  // cache of the directories read, NULL to read them each time
+  char **paths;     // the matched paths, sorted, after "expand_glob"
+  size_t n_paths;
+  size_t cap_paths;
+  char *pool;       // text of the paths, each one followed by a '\0'
+  size_t pool_len;
+  size_t pool_cap;
+  void *nodes;      // compiled pattern
+  size_t cap_nodes;
+  void *comps;      // components of the pattern, between the '/'
+  size_t cap_comps;
+  char **dents;     // one getdents64 buffer per depth of directory
+  size_t n_dents;
+  size_t n_allocs;  // number of arrays (re)allocated since "expand_init"
+};
+
+/**
+ * Init a struct expansion
+ *
+ * All bytes occupied by the structure are set to 0
+ *
+ * @param e pointer on the struct expansion to initialize
+ */
+void expand_init(struct expansion *e);
+
+/**
+ * Free everything allocated by a struct expansion
+ *
+ * @param e pointer on the struct expansion
+ */
+void expand_destroy(struct expansion *e);
+
+/**
+ * Tell whether a word is a pattern : it holds a '*', a '?', or a '[' opening a class
+ * closed by a ']' (the '[' of the test command alone isn't a pattern)
+ *
+ * @param word the word
+ * @param len the length of the word
+ * @return true if the word is a pattern
+ */
+bool expand_has_magic(const char *word, size_t len);
+
+/**
+ * Expand a glob pattern into the sorted list of the paths matching it
+ *
+ * The pattern is split at each '/'. In a component, '*' matches any string, '?' any
+ * character, "[...]" any character of the set (ranges allowed, '!' or '^' first for
+ * the complement) and '\' quotes the next character. A component made of "**" alone
+ * matches any number of directories, including none. A name starting with '.' is only
+ * matched by a component starting with '.'.
+ * Directories are read with large getdents64 batches, the type of the entries being
+ * taken from d_type : a stat is only needed when it is unknown, or for symbolic links.
+ * With a cache, the listings of the directories come from it instead.
+ *
+ * @param e pointer on the struct expansion receiving the paths
+ * @param pattern the pattern to expand
+ * @return the number of paths in "e->paths", 0 if nothing matches, -1 if a memory allocation failure occurs
+ */
+ssize_t expand_glob(struct expansion *e, const char *pattern);
+
+#endif
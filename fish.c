@@ -1,4 +1,4 @@
-#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -9,19 +9,113 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <poll.h>
 
 #include "util.h"
 #include "cmdline.h"
-
-#define BUFLEN 1024
+#include "spawn.h"
+#include "pathhash.h"
+#include "builtins.h"
+#include "events.h"
+#include "parallel.h"
+#include "xargs.h"
+#include "complete.h"
+#include "editor.h"
+#include "history.h"
+#include "timing.h"
+#include "trace.h"
+#include "stats.h"
+#include "script.h"
 
 #define YES_NO(i) ((i) ? "Y" : "N")
 
 /**
 	* Global variable that represents the
-	* list of all the pids of the processes running background from FiSH
+	* table of all the pids of the processes running background from FiSH
+	*/
+struct job_table bg_jobs;
+
+/**
+	* Global variable that represents the
+	* event loop reaping the background jobs while FiSH waits for input
+	*/
+struct event_loop events;
+
+/**
+	* Global variable that represents the
+	* table of the locations of the commands in PATH
+	*/
+struct path_hash cmd_hash;
+
+/**
+	* Global variable that represents the
+	* cache of the directories read by the expansion of the patterns
+	*/
+struct dircache dir_cache;
+
+/**
+	* Global variable that represents the
+	* completion of the commands and of the filenames typed at the prompt
+	*/
+static struct completion completion;
+
+/**
+	* Global variable that represents the
+	* line editor of the prompt, when the input is a terminal
+	*/
+static struct editor editor;
+
+/**
+	* Global variable that represents the
+	* history of the command lines, shared with the other FiSH,
+	* opened at its first use (fd is -1 until then)
 	*/
-struct pid_list bg_pids;
+static struct history history = { .fd = -1 };
+
+/**
+	* Global variable that represents the
+	* signal mask of FiSH before SIGINT got blocked,
+	* restored in the children
+	*/
+static sigset_t oldset;
+
+/**
+	* Global variable that represents the
+	* signal mask of FiSH between two lines (SIGINT blocked),
+	* given to the background children
+	*/
+static sigset_t bgset;
+
+/**
+	* Global variable that represents the
+	* exit status of the last command line
+	*/
+static int last_status = 0;
+
+/**
+	* Global variable that represents whether
+	* the exit command has been run
+	*/
+static bool exit_requested = false;
+
+/**
+	* Global variable that represents the
+	* number of command lines run so far
+	*/
+static size_t lines_run = 0;
+
+/**
+	* Global variable that represents the
+	* timings of the background lines prefixed by "time",
+	* printed once all their processes have been reaped
+	*/
+static struct timing **bg_timings = NULL;
+static size_t n_bg_timings = 0;
 
 
 /**
@@ -40,31 +134,33 @@ void waitmessage(pid_t child, int wstatus){
 }
 
 /**
- * Signal handler for SIGCHILD
- * this function determines which child process terminated and removes its 
- * pid from the global variable bg_pids 
- * so that the killed process is no more referenced
- * it also prints the terination status of the process 
- * on the standard error stream
- * 
- * @param signal the signal to be handled
- */
-void zombie_killer(int signal){
-	if(signal == SIGCHLD){
-		int wstatus;
- 		pid_t child = 0;
- 		size_t i =0;
- 		while(child==0 && i<bg_pids.size){
- 			child = waitpid(bg_pids.data[i],&wstatus,WNOHANG);
- 			++i;
- 		}
- 		if(child!=-1 && child!=0){
- 			pid_list_remove(&bg_pids,child);
- 			waitmessage(child, wstatus);
- 		}
- 		if(child==-1){
- 			perror("waitpid");
- 		}
+	* Reports a background job that terminated, then the resources used by its line
+	* once all its processes are over, if it was prefixed by "time"
+	*
+	* @param child the pid of the terminated child
+	* @param wstatus the termination status of the process
+	* @param usage the resources used by the process
+	*/
+static void report_job(pid_t child, int wstatus, const struct rusage *usage){
+	stats_add(STATS_JOBS_REAPED,1);
+	stats_jobs(bg_jobs.size);
+	waitmessage(child,wstatus);
+	for(size_t i = 0; i<n_bg_timings;++i){
+		struct timing *t = bg_timings[i];
+		if(timing_reaped(t,child,usage)){
+			if(t->pending==0){
+				//the job is named after its first process, a stage may not have started
+				size_t first = 0;
+				while(t->stages[first].pid==0){
+					++first;
+				}
+				fprintf(stderr,"[%i] time\n",t->stages[first].pid);
+				timing_print(t,stderr);
+				free(t);
+				bg_timings[i] = bg_timings[--n_bg_timings];
+			}
+			return;
+		}
 	}
 }
 
@@ -93,8 +189,8 @@ static void line_stats(struct line li){
     }
 
     fprintf(stderr, "\tRedirection of output: %s\n", YES_NO(li.redirect_output));
-    if (li.redirect_output) {
-      fprintf(stderr, "\t\tFilename: '%s'\n", li.file_output);
+    for (size_t i = 0; i < li.n_outputs; ++i) {
+      fprintf(stderr, "\t\tFilename: '%s'\n", li.file_outputs[i]);
     }
 
     fprintf(stderr, "\tBackground: %s\n", YES_NO(li.background));
@@ -107,12 +203,16 @@ static void line_stats(struct line li){
 	* starting with the ~ (home) symbol
 	*
 	* @param path the adress to which change working directory
+	* @return 0 on success, 1 otherwise
 	*/
-void cd(char * path){
-	char target_dir[100];
+int cd(char * path){
+	char* home_dir = getenv("HOME");
+	if(home_dir==NULL){
+		home_dir = "";
+	}
+	char target_dir[strlen(home_dir)+(path==NULL ? 0 : strlen(path))+1];
   if(path==NULL||*(path)=='~'){
   	//handling the case where the path starts with ~
-  	char* home_dir = getenv("HOME");
   	strcpy(target_dir,home_dir);
   	int home_len = strlen(target_dir);
   	if(path!=NULL){
@@ -124,306 +224,1238 @@ void cd(char * path){
  	int err = chdir(target_dir);
   if(err==-1){
   	perror("cd");
+  	return 1;
   }
+  return 0;
 }
 
+/**
+	*	function that implements the hash internal command
+	*	without argument, it prints the command hash table
+	*	with -r, it empties the table
+	*	otherwise it looks up the names given in argument
+	*
+	* @param args the arguments of the command, args[0] being "hash"
+	* @return 0 on success, 1 if a command isn't found
+	*/
+int hash(char **args){
+	if(args[1]==NULL){
+		path_hash_print(&cmd_hash,stdout);
+		fflush(stdout);
+		return 0;
+	}
+	if(strcmp(args[1],"-r")==0){
+		path_hash_reset(&cmd_hash);
+		return 0;
+	}
+	int status = 0;
+	for(size_t i = 1; args[i]!=NULL;++i){
+		if(path_hash_lookup(&cmd_hash,args[i])==NULL){
+			fprintf(stderr,"hash: %s: not found\n",args[i]);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+static int parse_size(const char *str, size_t *size);
 
 /**
-	* Main function of the FiSH program
+	*	function that implements the dircache internal command
+	*	without argument, it prints the counters of the directory cache
+	*	with -c, it empties the cache and resets the counters
+	*	with -b size, it changes the memory budget of the cache
 	*
+	* @param args the arguments of the command, args[0] being "dircache"
+	* @return 0 on success, 1 on a usage error
 	*/
-int main() {
-	//sets umask to zero so that the 
-	//newly created files have default permissions
-	//doesn't seem to be working
-	umask(S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
-	
-	//initializing the variables
-  struct line li;
-  line_init(&li);
-  
-  pid_list_create(&bg_pids);
-  
-  char buf[BUFLEN];
-  int err;
-	int input;
-	int output;
-	char cwd[BUFLEN];
-  
-  //initializing actions in case of BG process termination
-  struct sigaction sa;
-  sa.sa_flags = SA_RESTART;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_handler = zombie_killer;
-	err=sigaction(SIGCHLD,&sa,NULL);
-  
-  //blocking SIGINT for FiSH
-  sigset_t toblock, oldset;
-  sigaddset(&toblock,SIGINT);
-  //sigaddset(&toblock,SIGQUIT);
-	err = sigprocmask(SIG_BLOCK,&toblock,&oldset);
-	if(err==-1){
-		perror("sigprocmask blockset");
+static int dircache_builtin(char **args){
+	if(args[1]==NULL){
+		dircache_print(&dir_cache,stdout);
+		fflush(stdout);
+		return 0;
+	}
+	if(strcmp(args[1],"-c")==0 && args[2]==NULL){
+		dircache_clear(&dir_cache);
+		return 0;
+	}
+	size_t budget;
+	if(strcmp(args[1],"-b")==0 && args[2]!=NULL && args[3]==NULL && parse_size(args[2],&budget)==0){
+		dircache_set_budget(&dir_cache,budget);
+		return 0;
+	}
+	fprintf(stderr,"usage: dircache [-c | -b size]\n");
+	return 1;
+}
+
+/**
+	* Opens the history file, $FISH_HISTORY or else ~/.fish_history
+	*
+	* @return the history, NULL if it can't be opened
+	*/
+static struct history *open_history(void){
+	if(history.fd!=-1){
+		return &history;
+	}
+	const char *path = getenv("FISH_HISTORY");
+	char buf[PATH_MAX];
+	if(path==NULL){
+		const char *home = getenv("HOME");
+		if(home==NULL || snprintf(buf,sizeof(buf),"%s/.fish_history",home)>=(int)sizeof(buf)){
+			return NULL;
+		}
+		path = buf;
+	}
+	if(history_open(&history,path)==-1){
+		history.fd = -1;
+		return NULL;
+	}
+	return &history;
+}
+
+/**
+	*	function that implements the history internal command
+	*	without argument, it prints the numbered entries of the history
+	*	with a number N, only the N last ones
+	*	with -s text, only the entries containing the text
+	*
+	* @param args the arguments of the command, args[0] being "history"
+	* @return 0 on success, 1 on a usage error or if there is no history
+	*/
+static int history_builtin(char **args){
+	const char *text = NULL;
+	size_t last = SIZE_MAX;
+	if(args[1]!=NULL && strcmp(args[1],"-s")==0 && args[2]!=NULL && args[3]==NULL){
+		text = args[2];
+	}else if(args[1]!=NULL && (args[2]!=NULL || parse_size(args[1],&last)==-1)){
+		fprintf(stderr,"usage: history [N | -s text]\n");
 		return 1;
 	}
-	
-	//starting to prompt
-  for (;;) {
-  	input = 0;
-  	output = 1;
-  	
-  	//printing the current directory
-  	getcwd(cwd,BUFLEN);
-    printf("fish:%s> ",cwd);
-    
-    //getting the command(s)
-    fgets(buf, BUFLEN, stdin);
-    err = line_parse(&li, buf);
-    if (err==-1) { 
-      //the command line entered by the user isn't valid
-      line_reset(&li);
-      continue;
-    }
-		/*debugging tool*/
-		if(false){
-			line_stats(li);
-		}
-		
-		//EMPTY COMMAND
-		if(li.n_cmds==0){
-			line_reset(&li);
+	struct history *h = open_history();
+	if(h==NULL){
+		perror("history");
+		return 1;
+	}
+	size_t n = history_size(h);
+	ssize_t i = last<n ? (ssize_t)(n-last) : 0;
+	size_t len = text==NULL ? 0 : strlen(text);
+	while((i = history_search(h,text,len,i,HISTORY_FORWARD))!=-1){
+		size_t entry_len;
+		const char *entry = history_get(h,i,&entry_len);
+		printf("%5zd  %.*s\n",i+1,(int)entry_len,entry);
+		++i;
+	}
+	return 0;
+}
+
+/**
+	*	function that implements the stats internal command
+	*	without argument, it prints the counters and the histograms of FiSH
+	*	in the text format of Prometheus
+	*	with -r, it sets them to 0
+	*
+	* @param args the arguments of the command, args[0] being "stats"
+	* @return 0 on success, 1 on a usage error
+	*/
+static int stats_builtin(char **args){
+	if(args[1]!=NULL && (strcmp(args[1],"-r")!=0 || args[2]!=NULL)){
+		fprintf(stderr,"usage: stats [-r]\n");
+		return 1;
+	}
+	if(args[1]!=NULL){
+		stats_reset();
+	}else{
+		stats_print(stdout);
+	}
+	return 0;
+}
+
+/**
+	*	function that implements the cd internal command
+	*
+	* @param args the arguments of the command, args[0] being "cd"
+	* @return 0 on success, 1 otherwise
+	*/
+static int cd_builtin(char **args){
+	return cd(args[1]);
+}
+
+/**
+	*	function that implements the exit internal command
+	*	FiSH stops once the current line has been run,
+	*	with the status given in argument if any
+	*
+	* @param args the arguments of the command, args[0] being "exit"
+	* @return the exit status of FiSH
+	*/
+static int exit_builtin(char **args){
+	exit_requested = true;
+	if(args[1]!=NULL){
+		last_status = atoi(args[1]);
+	}
+	return last_status;
+}
+
+static int run_text(struct line *li, char *str);
+
+/**
+	* Runs a line of the parallel internal command,
+	* in the child of FiSH created for it
+	*
+	* @param line the command line
+	* @return the exit status of the line
+	*/
+static int parallel_job(char *line){
+	struct line li;
+	line_init(&li);
+	dircache_forked(&dir_cache);
+	li.glob.cache = &dir_cache;
+	int status = run_text(&li,line);
+	return status==-1 ? last_status : status;
+}
+
+/**
+	* Reads a whole file descriptor into a buffer terminated by a '\0'
+	*
+	* @param fd the file descriptor
+	* @param len set to the number of bytes read
+	* @return the buffer to free, NULL on failure (the reason is printed)
+	*/
+static char *read_all(int fd, size_t *len){
+	size_t cap = 4096;
+	char *buf = malloc(cap);
+	*len = 0;
+	for(;;){
+		if(buf==NULL){
+			fprintf(stderr,"Memory allocation failure\n");
+			return NULL;
+		}
+		ssize_t n = read(fd,buf+*len,cap-*len-1);
+		if(n==-1 && errno==EINTR){
 			continue;
 		}
-		
-		//EXIT COMMAND
-  	if(li.n_cmds!=0 && strcmp(li.cmds[0].args[0],"exit")==0){
-  		line_reset(&li);
-  		break;
-  	}
-  	
-  	//Handling redirections
-  	if(li.redirect_input){
-  		input = open(li.file_input,O_RDONLY);
-  		if(input==-1){
-  			perror("redirection of input");
-  			line_reset(&li);
-  			continue;
-  		}
-  	}
-  	if(li.redirect_output){
-  		output=open(li.file_output,O_WRONLY|O_CREAT|O_TRUNC);
-  		if(output==-1){
-  			perror("redirection of output");
-  			line_reset(&li);
-  			if(input!=0){
-  				close(input);
-  			}
-  			continue;
-  		}
-  	}else{
-  		if(li.background){
-  			output=open("/dev/null",O_WRONLY);
-  			if(output==-1){
-  				perror("redirection of output");
-  				line_reset(&li);
-  				if(input!=0){
-  					close(input);
-  				}
-  			}
-  		}
-  	}
-  	
-  	if(li.n_cmds==1){
-  	
-  		//CD COMMAND
-  		if(strcmp(li.cmds[0].args[0],"cd")==0){
-  			cd(li.cmds[0].args[1]);
-  			//reseting and going to the next line
-  			line_reset(&li);
-  			continue;
-  		}
-  		
-  		//executing the command if this isn't an internal command 
-  		// if the command is FG and doesn't have pipes
-  		if(li.cmds[0].n_args>=1 && !li.background){
-  			pid_t pid = fork();
-  			if(pid==-1){
-  				perror("fork");
-  			}else{
-  				if(pid==0){
-  					//removing the SIGNAL mask so that the program can be stopped
-  					err = sigprocmask(SIG_SETMASK,&oldset,NULL);
-						if(err==-1){
-							perror("sigprocmask reset in child");
-							line_reset(&li);
-							exit(1);
-						}
-						//redirecting to the required streams
-  					dup2(input,0);
-  					dup2(output,1);
-  					execvp(li.cmds[0].args[0],li.cmds[0].args);
-  					perror(li.cmds[0].args[0]);
-  					exit(1);
- 					}
- 					//closing the files if there has been a redirection
-					if(input!=0){
-						close(input);
-					}
-					if(output!=1){
-						close(output);
-					}
-					//waiting for the end of the process
- 					int wstatus;
- 					pid_t child = waitpid(pid,&wstatus,0);
- 					if(false){
- 						waitmessage(child,wstatus);
- 					}
-  			}
-  	 	}//end of the 1 foreground process treatement
-  	 	// if the command is BG and doesn't have pipes
-  		if(li.cmds[0].n_args>=1 && li.background){
-  			pid_t pid = fork();
-  			if(pid==-1){
-  				perror("fork");
-  			}else{
-  				if(pid==0){
-  					dup2(input,0);
-  					dup2(output,1);
-  					execvp(li.cmds[0].args[0],li.cmds[0].args);
-  					perror(li.cmds[0].args[0]);
-  					line_reset(&li);
-  					exit(1);
- 					}
- 					pid_list_add(&bg_pids,pid);
- 					if(input!=0){
-						close(input);
-					}
-					if(output!=1){
-						close(output);
-					}
-  			}
-  	 	}//end of the 1 background process treatement
-		}//end of the 1 command treatement
-		else{
-  		//executing the command if this isn't an internal command 
-  		// if the command is FG and requires pipes
-			if(!li.background){
-				//initializing the pipes
-				int tubes[li.n_cmds-1][2];
-				
-				//preparing to list of all the future processes to kill
-				struct pid_list pipe_processes;
-				pid_list_create(&pipe_processes);
-				
-				for(size_t i=0;i<li.n_cmds;++i){
-					pipe(tubes[i]);
-					pid_t newpid = fork();
-					if(newpid == -1){
-						perror("fork");
-						break;
-					}
-					if(newpid==0){
-						//removing the SIGNAL mask so that the program can be stopped
-						err = sigprocmask(SIG_SETMASK,&oldset,NULL);
-						if(err==-1){
-							perror("sigprocmask reset in child");
-							line_reset(&li);
-							exit(1);
-						}
-						
-						if(i==0){
-							//first process needs to read the input stream
-							dup2(input, 0);
-						}else{
-							//other processes need to read in the pipe of the previous process
-							dup2(tubes[i-1][0],0);
-						}
-						if(i==li.n_cmds-1){
-							//last process needs to write in the output stream
-							dup2(output, 1);
-						}else{
-							//other processes need to write in their pipe
-							dup2(tubes[i][1],1);
-						}
-						//closing useless file descriptors
-						close(tubes[i][0]);
-						close(tubes[i][1]);
-						execvp(li.cmds[i].args[0],li.cmds[i].args);
-						perror(li.cmds[i].args[0]);
-						exit(1);
-					}
-					//adding the new child to the list of processes to kill
-					pid_list_add(&pipe_processes, newpid);
-					//closing useless file descriptors 
-					if(i!=0){
-						close(tubes[i-1][0]);
-					}
-					close(tubes[i][1]);
-				}
-				close(tubes[li.n_cmds-2][0]);
+		if(n==-1){
+			perror("read");
+			free(buf);
+			return NULL;
+		}
+		if(n==0){
+			buf[*len] = '\0';
+			return buf;
+		}
+		*len += n;
+		if(cap-*len-1==0){
+			cap *= 2;
+			char *bigger = realloc(buf,cap);
+			if(bigger==NULL){
+				free(buf);
+			}
+			buf = bigger;
+		}
+	}
+}
+
+/**
+	*	function that implements the parallel internal command :
+	*	parallel [-j N] [-k] [command...]
+	*	runs the lines read on the standard input as command lines, or runs
+	*	the command with each line as its last argument, at most N at once
+	*	(the number of online CPUs by default), in a child of FiSH each
+	*	the output of each job is printed once it is over, in completion order,
+	*	or in input order with -k
+	*	NB : the words of the command and the lines are quoted, so they can't contain '"'
+	*
+	* @param args the arguments of the command, args[0] being "parallel"
+	* @return the number of jobs which failed (at most 101), 2 on a usage error
+	*/
+static int parallel_builtin(char **args){
+	long width = sysconf(_SC_NPROCESSORS_ONLN);
+	bool keep_order = false;
+	size_t i = 1;
+	for(;args[i]!=NULL && args[i][0]=='-';++i){
+		if(strcmp(args[i],"-k")==0){
+			keep_order = true;
+		}else if(strcmp(args[i],"-j")==0 && args[i+1]!=NULL && atol(args[i+1])>0){
+			width = atol(args[++i]);
+		}else{
+			fprintf(stderr,"usage: parallel [-j jobs] [-k] [command...]\n");
+			return 2;
+		}
+	}
+	char **prefix = args+i;
+	if(width<1){
+		width = 1;
+	}
+
+	size_t len;
+	char *input = read_all(0,&len);
+	if(input==NULL){
+		return 1;
+	}
+	//one job per non-empty line
+	size_t n_lines = 1;
+	for(char *p = memchr(input,'\n',len); p!=NULL; p = memchr(p+1,'\n',input+len-p-1)){
+		++n_lines;
+	}
+	char **lines = malloc(n_lines*sizeof(char *));
+	size_t prefix_len = 0;
+	for(char **word = prefix; *word!=NULL;++word){
+		prefix_len += strlen(*word)+3;
+	}
+	n_lines = 0;
+	int status = 0;
+	for(char *line = strtok(input,"\n"); line!=NULL && lines!=NULL; line = strtok(NULL,"\n")){
+		if(*prefix==NULL){
+			lines[n_lines++] = line;
+			continue;
+		}
+		char *job = malloc(prefix_len+strlen(line)+3);
+		if(job==NULL){
+			fprintf(stderr,"Memory allocation failure\n");
+			status = 1;
+			break;
+		}
+		char *p = job;
+		for(char **word = prefix; *word!=NULL;++word){
+			p += sprintf(p,"\"%s\" ",*word);
+		}
+		sprintf(p,"\"%s\"",line);
+		lines[n_lines++] = job;
+	}
+	if(lines==NULL){
+		fprintf(stderr,"Memory allocation failure\n");
+		status = 1;
+	}
+	if(status==0){
+		status = parallel_run(lines,n_lines,width,keep_order,parallel_job,&oldset,&events);
+	}
+	if(*prefix!=NULL){
+		for(size_t j = 0; j<n_lines;++j){
+			free(lines[j]);
+		}
+	}
+	free(lines);
+	free(input);
+	return status;
+}
+
+/**
+	*	function that implements the xargs internal command,
+	*	the commands being found with the command hash table of FiSH
+	*
+	* @param args the arguments of the command, args[0] being "xargs"
+	* @return the exit status of xargs
+	*/
+static int xargs_builtin(char **args){
+	return xargs_main(args,&cmd_hash,&oldset);
+}
+
+/**
+	* Internal command of FiSH
+	*/
+struct builtin {
+	const char *name;
+	int (*run)(char **args);
+	bool special; //changes the state of FiSH, only run in FiSH when alone in the foreground
+};
+
+/**
+	* Global variable that represents the
+	* dispatch table of the internal commands
+	*/
+static const struct builtin builtins[] = {
+	{ "cd", cd_builtin, true },
+	{ "exit", exit_builtin, true },
+	{ "hash", hash, true },
+	{ "dircache", dircache_builtin, true },
+	{ "history", history_builtin, false },
+	{ "stats", stats_builtin, true },
+	{ "echo", builtin_echo, false },
+	{ "true", builtin_true, false },
+	{ "false", builtin_false, false },
+	{ "pwd", builtin_pwd, false },
+	{ "test", builtin_test, false },
+	{ "[", builtin_test, false },
+	{ "printf", builtin_printf, false },
+	{ "kill", builtin_kill, false },
+	{ "fcat", builtin_fcat, false },
+	{ "parallel", parallel_builtin, false },
+	{ "xargs", xargs_builtin, false },
+};
+
+/**
+	* Searches the dispatch table for an internal command
+	*
+	* @param name the name of the command
+	* @return the internal command, NULL if it is an external one
+	*/
+static const struct builtin *find_builtin(const char *name){
+	for(size_t i = 0; i<sizeof(builtins)/sizeof(builtins[0]);++i){
+		if(strcmp(builtins[i].name,name)==0){
+			return &builtins[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+	* Runs an internal command in FiSH, its standard streams
+	* being temporarily replaced by the given file descriptors
+	*
+	* @param b the internal command
+	* @param args the arguments of the command
+	* @param input the file descriptor to use as standard input
+	* @param output the file descriptor to use as standard output
+	* @return the exit status of the command
+	*/
+static int run_builtin(const struct builtin *b, char **args, int input, int output){
+	int saved_input = -1;
+	int saved_output = -1;
+	fflush(stdout);
+	if(input!=0){
+		saved_input = fcntl(0,F_DUPFD_CLOEXEC,3);
+		dup2(input,0);
+	}
+	if(output!=1){
+		saved_output = fcntl(1,F_DUPFD_CLOEXEC,3);
+		dup2(output,1);
+	}
+	int status = b->run(args);
+	fflush(stdout);
+	clearerr(stdout);
+	if(input!=0){
+		if(saved_input!=-1){
+			dup2(saved_input,0);
+			close(saved_input);
+		}else{
+			close(0);
+		}
+	}
+	if(output!=1){
+		if(saved_output!=-1){
+			dup2(saved_output,1);
+			close(saved_output);
+		}else{
+			close(1);
+		}
+	}
+	return status;
+}
+
+/**
+	* Runs an internal command in a child process,
+	* when it can't be run in FiSH
+	*
+	* @param b the internal command
+	* @param args the arguments of the command
+	* @param input the file descriptor to use as standard input
+	* @param output the file descriptor to use as standard output
+	* @param to_close file descriptors the child closes : without exec,
+	* the close-on-exec flag of the pipes of the other stages doesn't apply
+	* @param n_close number of file descriptors in "to_close"
+	* @param mask the signal mask of the child, NULL to keep the one of FiSH
+	* @return the pid of the child, -1 if it couldn't be created
+	*/
+static pid_t fork_builtin(const struct builtin *b, char **args, int input, int output, const int *to_close, size_t n_close, const sigset_t *mask){
+	fflush(stdout);
+	pid_t pid = fork();
+	if(pid==-1){
+		perror("fork");
+		return -1;
+	}
+	stats_add(STATS_FORKS,1);
+	if(pid==0){
+		if(mask!=NULL){
+			sigprocmask(SIG_SETMASK,mask,NULL);
+		}
+		signal(SIGPIPE,SIG_DFL);
+		if(input!=0){
+			dup2(input,0);
+			close(input);
+		}
+		if(output!=1){
+			dup2(output,1);
+			close(output);
+		}
+		for(size_t i = 0; i<n_close;++i){
+			if(to_close[i]>2 && to_close[i]!=input && to_close[i]!=output){
+				close(to_close[i]);
+			}
+		}
+		int status = b->run(args);
+		fflush(stdout);
+		_exit(status);
+	}
+	return pid;
+}
+
+/**
+	* Converts the termination status of a child process
+	* into an exit status, the way sh does it
+	*
+	* @param wstatus the termination status of the process
+	* @return the exit status, 128 plus the signal number if it was killed
+	*/
+static int exit_status(int wstatus){
+	if(WIFSIGNALED(wstatus)){
+		return 128+WTERMSIG(wstatus);
+	}
+	return WEXITSTATUS(wstatus);
+}
+
+/**
+	* Opens all the targets of the output redirections of a line, then forks
+	* a child copying the output of the line to all of them with spawn_tee,
+	* without any exec
+	*
+	* @param li the line whose output is redirected to several files
+	* @param input the file descriptor of the input redirection, closed in the child
+	* @param output set to the write end of the pipe read by the child
+	* @param mask signal mask of the child
+	* @return the pid of the child, -1 on failure (the reason is printed)
+	*/
+static pid_t fork_tee(struct line *li, int input, int *output, const sigset_t *mask){
+	size_t n = li->n_outputs;
+	int files[n];
+	size_t opened = 0;
+	for(;opened<n;++opened){
+		uint64_t start = trace_begin();
+		files[opened] = open(li->file_outputs[opened],O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+		trace_end("open",start,li->file_outputs[opened]);
+		if(files[opened]==-1){
+			perror("redirection of output");
+			break;
+		}
+	}
+	int fan[2] = {-1,-1};
+	pid_t pid = -1;
+	if(opened==n){
+		if(pipe2(fan,O_CLOEXEC)==-1){
+			perror("pipe");
+		}else{
+			fflush(stdout);
+			pid = fork();
+			if(pid==-1){
+				perror("fork");
+			}else{
+				stats_add(STATS_FORKS,1);
+			}
+			if(pid==0){
+				//the child is forked before the pipes of the pipeline,
+				//so that it doesn't keep any of them open
+				sigprocmask(SIG_SETMASK,mask,NULL);
+				signal(SIGPIPE,SIG_DFL);
+				close(fan[1]);
 				if(input!=0){
 					close(input);
 				}
-				if(output!=1){
-					close(output);
-				}
-				//killing the piped processes of the list one by one before continuing the loop
-				for(size_t i = 0; i<li.n_cmds;++i){
-					int wstatus;
-					pid_t child = waitpid(pipe_processes.data[i],&wstatus,0);
- 					if(false){
- 						waitmessage(child,wstatus);
- 					}
-				}
-				pid_list_destroy(&pipe_processes);
-				
-			}//end of the foreground piped processes treatement
-			else{
-				//if the command is BG and requires pipes
-				int tubes[li.n_cmds-1][2];
-				for(size_t i=0;i<li.n_cmds;++i){
-					pipe(tubes[i]);
-					pid_t newpid = fork();
-					if(newpid == -1){
-						perror("fork");
-						break;
-					}
-					if(newpid==0){
-						if(i==0){
-							dup2(input, 0);
-						}else{
-							dup2(tubes[i-1][0],0);
-						}
-						if(i==li.n_cmds-1){
-							dup2(output, 1);
-						}else{
-							dup2(tubes[i][1],1);
-						}
-						close(tubes[i][0]);
-						close(tubes[i][1]);
-						execvp(li.cmds[i].args[0],li.cmds[i].args);
-						perror(li.cmds[i].args[0]);
-						exit(1);
-					}
-					pid_list_add(&bg_pids, newpid);
-					if(i!=0){
-						close(tubes[i-1][0]);
-					}
-					close(tubes[i][1]);
-				}
-				close(tubes[li.n_cmds-2][0]);
+				_exit(spawn_tee(fan[0],files,n)==-1 ? 1 : 0);
+			}
+		}
+	}
+	//the files and the read end of the pipe are only used by the child
+	for(size_t i = 0; i<opened;++i){
+		close(files[i]);
+	}
+	if(fan[0]!=-1){
+		close(fan[0]);
+	}
+	if(pid==-1){
+		if(fan[1]!=-1){
+			close(fan[1]);
+		}
+		return -1;
+	}
+	*output = fan[1];
+	return pid;
+}
+
+/**
+	* Waits for the end of the processes of a line, in the order they terminate
+	* when the line is timed, so that the end of each one is known
+	*
+	* @param pids the processes, -1 for the stages without process
+	* @param wstatus set to the termination status of each process
+	* @param n the number of processes
+	* @param timing the timing of the line, NULL if it isn't timed
+	*/
+static void wait_line(const pid_t *pids, int *wstatus, size_t n, struct timing *timing){
+	struct pollfd fds[n];
+	bool reaped[n];
+	size_t watched = 0;
+	for(size_t i = 0; i<n;++i){
+		//a pidfd is readable once its process has terminated
+		fds[i].fd = timing!=NULL && pids[i]!=-1 ? ev_pidfd(pids[i]) : -1;
+		fds[i].events = POLLIN;
+		reaped[i] = pids[i]==-1;
+		watched += fds[i].fd!=-1;
+	}
+	struct rusage usage;
+	while(watched>0){
+		if(poll(fds,n,-1)==-1){
+			if(errno==EINTR){
+				continue;
+			}
+			break;
+		}
+		for(size_t i = 0; i<n;++i){
+			if(fds[i].fd==-1 || fds[i].revents==0){
+				continue;
+			}
+			if(wait4(pids[i],&wstatus[i],0,&usage)!=-1){
+				timing_reaped(timing,pids[i],&usage);
+			}
+			reaped[i] = true;
+			close(fds[i].fd);
+			fds[i].fd = -1;
+			--watched;
+		}
+	}
+	//the processes without pidfd are waited one by one
+	for(size_t i = 0; i<n;++i){
+		if(fds[i].fd!=-1){
+			close(fds[i].fd);
+		}
+		if(reaped[i]){
+			continue;
+		}
+		pid_t child;
+		while((child = wait4(pids[i],&wstatus[i],0,&usage))==-1 && errno==EINTR){
+		}
+		if(child==-1){
+			wstatus[i] = 0;
+		}else if(timing!=NULL){
+			timing_reaped(timing,pids[i],&usage);
+		}
+	}
+}
+
+/**
+	* Runs a command line that has been successfully parsed
+	*
+	* @param li the line to run
+	* @param timed true to print the resources used by the line (the "time" prefix)
+	* @return the exit status of the line,
+	* or -1 if the exit command asks FiSH to stop
+	*/
+static int run_line(struct line *li, bool timed){
+	int input = 0;
+	int output = 1;
+	int status = 0;
+	
+	//EMPTY COMMAND
+	if(li->n_cmds==0){
+		return last_status;
+	}
+	
+	//Handling redirections, the files being closed in the children
+	//once they've become their standard streams
+	if(li->redirect_input){
+		uint64_t start = trace_begin();
+		input = open(li->file_input,O_RDONLY|O_CLOEXEC);
+		trace_end("open",start,li->file_input);
+		if(input==-1){
+			perror("redirection of input");
+			return 1;
+		}
+	}
+	//restoring the SIGNAL mask in foreground children so that they can be stopped,
+	//background processes keep SIGINT blocked
+	const sigset_t *mask = li->background ? &bgset : &oldset;
+	//several output redirections : the output of the line goes through a pipe
+	//to a child duplicating it into all the files
+	pid_t tee_pid = -1;
+	if(li->n_outputs>1){
+		uint64_t start = trace_begin();
+		tee_pid = fork_tee(li,input,&output,mask);
+		trace_end("spawn",start,"(tee)");
+		if(tee_pid==-1){
+			if(input!=0){
+				close(input);
+			}
+			return 1;
+		}
+	}else if(li->redirect_output){
+		uint64_t start = trace_begin();
+		output=open(li->file_output,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+		trace_end("open",start,li->file_output);
+		if(output==-1){
+			perror("redirection of output");
+			if(input!=0){
+				close(input);
+			}
+			return 1;
+		}
+	}else{
+		if(li->background){
+			output=open("/dev/null",O_WRONLY|O_CLOEXEC);
+			if(output==-1){
+				perror("redirection of output");
 				if(input!=0){
 					close(input);
 				}
-				if(output!=1){
-					close(output);
-				}
-			}//end of the background piped processes treatement
-		}//end of the piped commands treatement
-  	//pid_list_print(&bg_pids);
-    line_reset(&li);
-  }//end of the prompt loop
-  pid_list_destroy(&bg_pids);
-  return 0;
+				return 1;
+			}
+		}
+	}
+	
+	//choosing the internal command to run in FiSH, if any :
+	//a foreground one alone, or the last one of a foreground pipeline
+	//that doesn't change the state of FiSH
+	//the other internal commands are run in a child process
+	size_t n = li->n_cmds;
+	const struct builtin *found[n];
+	ssize_t inproc = -1;
+	for(size_t i = 0; i<n;++i){
+		found[i] = find_builtin(li->cmds[i].args[0]);
+		if(found[i]!=NULL && !li->background && (n==1 || !found[i]->special)){
+			inproc = i;
+		}
+	}
+	
+	//executing the command(s), with or without pipes
+	struct timing *timing = NULL;
+	if(timed && (timing = timing_start(n+1))==NULL){
+		fprintf(stderr,"Memory allocation failure\n");
+	}
+	struct stage stages[n];
+	uint64_t start = trace_begin();
+	int piped = spawn_pipes(stages,n,input,output);
+	trace_end("pipes",start,NULL);
+	if(piped==-1){
+		if(input!=0){
+			close(input);
+		}
+		if(output!=1){
+			close(output);
+		}
+		if(tee_pid!=-1){
+			waitpid(tee_pid,NULL,0);
+		}
+		free(timing);
+		return 1;
+	}
+	//the child duplicating the output, if any, comes after the commands
+	pid_t pids[n+1];
+	pids[n] = tee_pid;
+	//a foreground job lasts from its first process started, 0 if none is
+	uint64_t job_start = 0;
+	for(size_t i = 0; i<n;++i){
+		pids[i] = -1;
+		if((ssize_t) i==inproc){
+			continue;
+		}
+		uint64_t spawn_start = stats_now();
+		job_start = job_start==0 ? spawn_start : job_start;
+		start = trace_begin();
+		if(found[i]!=NULL){
+			//the pipes of the stages not started yet and of the internal command run in FiSH are still open
+			int to_close[2*n+2];
+			size_t n_close = 0;
+			for(size_t j = i+1; j<n;++j){
+				to_close[n_close++] = stages[j].input;
+				to_close[n_close++] = stages[j].output;
+			}
+			if(inproc!=-1 && (size_t) inproc<i){
+				to_close[n_close++] = stages[inproc].input;
+				to_close[n_close++] = stages[inproc].output;
+			}
+			to_close[n_close++] = input;
+			to_close[n_close++] = output;
+			pids[i] = fork_builtin(found[i],li->cmds[i].args,stages[i].input,stages[i].output,to_close,n_close,mask);
+		}else{
+			int to_close[2] = {input,output};
+			pids[i] = spawn_cmd(&cmd_hash,li->cmds[i].args,stages[i].input,stages[i].output,to_close,2,mask);
+		}
+		trace_end("spawn",start,li->cmds[i].args[0]);
+		stats_observe(STATS_SPAWN_NS,stats_now()-spawn_start);
+		if(timing!=NULL && pids[i]!=-1){
+			timing_spawned(timing,i,li->cmds[i].args[0],pids[i]);
+		}
+		spawn_stage_close(&stages[i],input,output);
+	}
+	if(timing!=NULL && tee_pid!=-1){
+		timing_spawned(timing,n,"(tee)",tee_pid);
+	}
+	//the internal command runs once all the other commands are launched,
+	//so that the pipes it uses are drained
+	int inproc_status = 0;
+	if(inproc!=-1){
+		struct rusage before, after;
+		getrusage(RUSAGE_SELF,&before);
+		start = trace_begin();
+		inproc_status = run_builtin(found[inproc],li->cmds[inproc].args,stages[inproc].input,stages[inproc].output);
+		trace_end("builtin",start,li->cmds[inproc].args[0]);
+		spawn_stage_close(&stages[inproc],input,output);
+		if(timing!=NULL){
+			getrusage(RUSAGE_SELF,&after);
+			timing_ran(timing,inproc,li->cmds[inproc].args[0],&before,&after);
+		}
+	}
+	//closing the files if there has been a redirection
+	if(input!=0){
+		close(input);
+	}
+	if(output!=1){
+		close(output);
+	}
+	
+	if(!li->background){
+		//waiting for the end of the processes one by one,
+		//the status of the line being the one of the last command
+		status = (ssize_t) n-1==inproc ? inproc_status : 127;
+		int wstatus[n+1];
+		start = trace_begin();
+		wait_line(pids,wstatus,n+1,timing);
+		trace_end("wait",start,NULL);
+		if(job_start!=0){
+			stats_observe(STATS_FOREGROUND_NS,stats_now()-job_start);
+		}
+		for(size_t i = 0; i<=n;++i){
+			if(pids[i]==-1){
+				continue;
+			}
+			if(i==n-1){
+				status = exit_status(wstatus[i]);
+			}
+			//a failure to write one of the files fails the line
+			if(i==n && status==0 && exit_status(wstatus[i])!=0){
+				status = 1;
+			}
+		}
+		if(timing!=NULL){
+			timing_print(timing,stderr);
+			free(timing);
+		}
+	}else{
+		for(size_t i = 0; i<=n;++i){
+			if(pids[i]==-1){
+				continue;
+			}
+			//the jobs are only reaped by the event loop, between two lines,
+			//so they can't terminate before being in the table
+			if(job_table_add(&bg_jobs,pids[i])==-1){
+				fprintf(stderr,"Memory allocation failure\n");
+			}else{
+				ev_watch(&events,pids[i]);
+				stats_add(STATS_JOBS_STARTED,1);
+			}
+		}
+		stats_jobs(bg_jobs.size);
+		//the resources of a timed job are printed once its last process is reaped
+		if(timing!=NULL){
+			struct timing **timings = timing->pending>0 ? realloc(bg_timings,(n_bg_timings+1)*sizeof(struct timing *)) : NULL;
+			if(timings==NULL){
+				free(timing);
+			}else{
+				bg_timings = timings;
+				bg_timings[n_bg_timings++] = timing;
+			}
+		}
+	}
+	return exit_requested ? -1 : status;
+}
+
+/**
+	* Runs a parsed command line, the "time" prefix timing the whole line
+	*
+	* @param li the line, given back unchanged
+	* @return the exit status of the line,
+	* or -1 if the exit command asks FiSH to stop
+	*/
+static int run_parsed(struct line *li){
+	bool timed = li->n_cmds>0 && strcmp(li->cmds[0].args[0],"time")==0;
+	if(!timed){
+		return run_line(li,false);
+	}
+	struct cmd *first = &li->cmds[0];
+	if(first->n_args==1){
+		fprintf(stderr,"usage: time command line\n");
+		return 2;
+	}
+	//the prefix is skipped while the line runs : a line of a loop runs again
+	++first->args;
+	--first->n_args;
+	int status = run_line(li,true);
+	--first->args;
+	++first->n_args;
+	return status;
+}
+
+/**
+	* Parses and runs one command line, in place
+	*
+	* @param li the line structure to use
+	* @param str the text of the line, which is modified
+	* @return the exit status of the line,
+	* or -1 if the exit command asks FiSH to stop
+	*/
+static int run_text(struct line *li, char *str){
+	++lines_run;
+	//the text is parsed in place : its beginning is kept for the trace
+	char text[TRACE_DETAIL] = "";
+	if(trace_enabled){
+		strncpy(text,str,TRACE_DETAIL-1);
+	}
+	uint64_t line_start = trace_begin();
+	uint64_t parse_start = stats_now();
+	int status = line_parse_inplace(li, str);
+	stats_observe(STATS_PARSE_NS,stats_now()-parse_start);
+	stats_add(STATS_LINES,1);
+	trace_end("parse",line_start,NULL);
+	if(status==-1){
+		//the command line entered by the user isn't valid
+		stats_add(STATS_PARSE_ERRORS,1);
+		line_reset(li);
+		trace_end("line",line_start,text);
+		return 2;
+	}
+	/*debugging tool*/
+	if(false){
+		line_stats(*li);
+	}
+	status = run_parsed(li);
+	line_reset(li);
+	trace_end("line",line_start,text);
+	return status;
 }
 
+/**
+	* Runs a line of a script,
+	* then reports the background jobs terminated meanwhile
+	*
+	* @param li the line structure to use
+	* @param str the text of the line, which is modified
+	* @return the exit status of the line,
+	* or -1 if the exit command asks FiSH to stop
+	*/
+static int script_text(struct line *li, char *str){
+	int status = run_text(li,str);
+	if(status!=-1){
+		last_status = status;
+		if(bg_jobs.size>0){
+			ev_poll(&events);
+		}
+	}
+	return status;
+}
+
+/**
+	* Runs a line of a loop of a script, parsed once by the compiler,
+	* then reports the background jobs terminated meanwhile
+	*
+	* @param li the line, which is not modified
+	* @param text the text of the line, for the trace
+	* @return the exit status of the line,
+	* or -1 if the exit command asks FiSH to stop
+	*/
+static int script_line(struct line *li, const char *text){
+	++lines_run;
+	uint64_t start = trace_begin();
+	int status = run_parsed(li);
+	trace_end("line",start,text);
+	if(status!=-1){
+		last_status = status;
+		if(bg_jobs.size>0){
+			ev_poll(&events);
+		}
+	}
+	return status;
+}
+
+/**
+	* Runs all the lines of a mutable buffer, compiled first
+	* so that the lines of its loops are only parsed once
+	*
+	* @param li the line structure to use
+	* @param data the first byte of the buffer, which is split into lines in place
+	* @param len the size of the buffer
+	* @return false if the exit command has been run, true otherwise
+	*/
+static bool run_buffer(struct line *li, char *data, size_t len){
+	struct script script;
+	if(script_compile(&script,data,len)==-1){
+		last_status = 2;
+		return true;
+	}
+	int status = script_run(&script,li,script_text,script_line);
+	script_destroy(&script);
+	if(status==-1){
+		return false;
+	}
+	//a condition which failed makes the status of its "if" or "while" 0
+	last_status = status;
+	return true;
+}
+
+/**
+	* Runs a script file without prompting,
+	* the file being mapped in memory rather than read
+	*
+	* @param li the line structure to use
+	* @param path the path of the script
+	* @return 0 on success, -1 if the script can't be read
+	*/
+static int run_script(struct line *li, const char *path){
+	int fd = open(path,O_RDONLY);
+	if(fd==-1){
+		perror(path);
+		return -1;
+	}
+	struct stat st;
+	if(fstat(fd,&st)==-1){
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	if(st.st_size==0){
+		close(fd);
+		return 0;
+	}
+	//private mapping : the lines are split in place without modifying the file
+	char *data = mmap(NULL,st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(data==MAP_FAILED){
+		perror(path);
+		return -1;
+	}
+	madvise(data,st.st_size,MADV_SEQUENTIAL);
+	run_buffer(li,data,st.st_size);
+	munmap(data,st.st_size);
+	return 0;
+}
+
+/**
+	* Prints the prompt, with the current directory
+	*/
+static void prompt(void){
+	char *cwd = getcwd(NULL,0);
+	printf("fish:%s> ",cwd ? cwd : "?");
+	fflush(stdout);
+	free(cwd);
+}
+
+/**
+	* Prints the prompt and the line being edited again
+	*/
+static void redraw(void){
+	ed_redraw(&editor);
+}
+
+/**
+	* Runs the commands typed by the user,
+	* prompting before each line
+	*
+	* @param li the line structure to use
+	*/
+static void run_interactive(struct line *li){
+	//a terminal is edited in raw mode, with the completion of the words
+	const char *names[sizeof(builtins)/sizeof(builtins[0])];
+	for(size_t i = 0; i<sizeof(builtins)/sizeof(builtins[0]);++i){
+		names[i] = builtins[i].name;
+	}
+	bool edit = complete_init(&completion,names,sizeof(builtins)/sizeof(builtins[0]),&dir_cache)==0
+		&& ed_init(&editor,0,prompt,&completion,&events,open_history())==0;
+	
+	//the prompt is printed again after the messages of the background jobs
+	events.redraw = edit ? redraw : prompt;
+	for (;;) {
+		//reporting the background jobs terminated during the last line
+		if(bg_jobs.size>0){
+			ev_poll(&events);
+		}
+		char *buf;
+		if(edit){
+			buf = ed_read_line(&editor);
+		}else{
+			prompt();
+			//the background jobs terminating until the line is typed are reported at once
+			if(!line_pending(li) && ev_wait_input(&events,0)==-1){
+				break;
+			}
+			//getting the command(s) straight into the buffer of the line, whatever its length
+			buf = line_read(li, 0);
+		}
+		if (buf == NULL) {
+			//end of the input
+			break;
+		}
+		if(edit && history.fd!=-1){
+			history_add(&history,buf);
+		}
+		int status = run_text(li, buf);
+		if(status==-1){
+			break;
+		}
+		last_status = status;
+	}//end of the prompt loop
+	if(edit){
+		ed_destroy(&editor);
+	}
+	complete_destroy(&completion);
+	if(history.fd!=-1){
+		history_close(&history);
+	}
+}
+
+/**
+	* Parses a size in bytes, optionally followed by K or M
+	*
+	* @param str the text of the size
+	* @param size set to the size in bytes
+	* @return 0 on success, -1 if the size isn't valid
+	*/
+static int parse_size(const char *str, size_t *size){
+	char *end;
+	unsigned long long n = strtoull(str,&end,10);
+	if(end==str){
+		return -1;
+	}
+	if(*end=='k' || *end=='K'){
+		n <<= 10;
+		++end;
+	}else if(*end=='m' || *end=='M'){
+		n <<= 20;
+		++end;
+	}
+	if(*end!='\0'){
+		return -1;
+	}
+	*size = n;
+	return 0;
+}
+
+/**
+	* Prints how to use FiSH
+	*
+	* @param name the name of the program
+	*/
+static void usage(const char *name){
+	fprintf(stderr,"usage: %s [-t] [-p size] [-c cmdline | script]\n",name);
+	fprintf(stderr,"\t-c cmdline\trun the given command line(s) and exit\n");
+	fprintf(stderr,"\tscript\t\trun the lines of the script file and exit\n");
+	fprintf(stderr,"\t-t\t\tprint the number of lines run per second on exit\n");
+	fprintf(stderr,"\t-p size\t\tcapacity of the pipes, e.g. 1M (default: $FISH_PIPE_SIZE)\n");
+	fprintf(stderr,"\t$FISH_TRACE\tfile receiving a Chrome trace of the lines, at exit or on SIGUSR1\n");
+}
+
+/**
+	* Main function of the FiSH program
+	*
+	*/
+int main(int argc, char *argv[]) {
+	//parsing the options
+	char *cmdline = NULL;
+	bool timing = false;
+	const char *pipe_size = getenv("FISH_PIPE_SIZE");
+	int opt;
+	while((opt = getopt(argc,argv,"c:tp:"))!=-1){
+		switch(opt){
+			case 'c':
+				cmdline = optarg;
+				break;
+			case 't':
+				timing = true;
+				break;
+			case 'p':
+				pipe_size = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return 2;
+		}
+	}
+	if(optind<argc-1 || (cmdline!=NULL && optind<argc)){
+		usage(argv[0]);
+		return 2;
+	}
+	char *script = optind<argc ? argv[optind] : NULL;
+	
+	//larger pipes for the high-volume pipelines
+	if(pipe_size!=NULL && *pipe_size!='\0'){
+		size_t size;
+		if(parse_size(pipe_size,&size)==-1){
+			fprintf(stderr,"%s: invalid pipe size\n",pipe_size);
+			usage(argv[0]);
+			return 2;
+		}
+		spawn_set_pipe_size(size);
+	}
+	
+	//the spans of the lines are traced, and written at exit or on SIGUSR1
+	const char *trace_file = getenv("FISH_TRACE");
+	if(trace_file!=NULL && *trace_file!='\0' && trace_init(trace_file)==-1){
+		fprintf(stderr,"Memory allocation failure\n");
+		return 1;
+	}
+
+	//initializing the variables
+	struct line li;
+	line_init(&li);
+	
+	job_table_create(&bg_jobs);
+	path_hash_init(&cmd_hash);
+	if(dircache_init(&dir_cache,DIRCACHE_BUDGET)==-1){
+		fprintf(stderr,"Memory allocation failure\n");
+		return 1;
+	}
+	li.glob.cache = &dir_cache;
+	
+	int err;
+	
+	//blocking SIGINT for FiSH
+	sigset_t toblock;
+	sigemptyset(&toblock);
+	sigaddset(&toblock,SIGINT);
+	//sigaddset(&toblock,SIGQUIT);
+	err = sigprocmask(SIG_BLOCK,&toblock,&oldset);
+	if(err==-1){
+		perror("sigprocmask blockset");
+		return 1;
+	}
+	sigprocmask(SIG_BLOCK,NULL,&bgset);
+	
+	//the terminated background jobs are reaped by the event loop
+	//(it may block SIGCHLD, after the masks of the children are saved)
+	if(ev_init(&events,&bg_jobs,report_job)==-1){
+		return 1;
+	}
+	
+	//internal commands writing in a closed pipe must not stop FiSH
+	signal(SIGPIPE,SIG_IGN);
+	
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC,&start);
+	
+	if(cmdline!=NULL){
+		run_buffer(&li,cmdline,strlen(cmdline));
+	}else if(script!=NULL){
+		if(run_script(&li,script)==-1){
+			last_status = 127;
+		}
+	}else{
+		//starting to prompt
+		run_interactive(&li);
+	}
+	
+	if(timing){
+		clock_gettime(CLOCK_MONOTONIC,&end);
+		double elapsed = (end.tv_sec-start.tv_sec)+(end.tv_nsec-start.tv_nsec)/1e9;
+		fprintf(stderr,"fish: %zu lines in %.3f s (%.0f lines/s)\n",
+			lines_run,elapsed,elapsed>0 ? lines_run/elapsed : 0.0);
+	}
+	
+	if(trace_enabled && trace_dump()==-1){
+		perror(trace_file);
+	}
+	for(size_t i = 0; i<n_bg_timings;++i){
+		free(bg_timings[i]);
+	}
+	free(bg_timings);
+	line_destroy(&li);
+	ev_destroy(&events);
+	dircache_destroy(&dir_cache);
+	path_hash_destroy(&cmd_hash);
+	job_table_destroy(&bg_jobs);
+	return last_status;
+}
@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+#include "history.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define MIN_ENTRIES 1024
+#define MAX_TRIGRAMS 32
+#define HISTORY_FILL 1024
+
+/**
+ * Bytes and trigrams of a searched text, as set in the filters
+ */
+struct history_query {
+  uint64_t bytes[4];
+  unsigned trigrams[MAX_TRIGRAMS];
+  size_t n_trigrams;
+};
+
+int history_open(struct history *h, const char *path) {
+  assert(h);
+  assert(path);
+  memset(h, 0, sizeof(struct history));
+  h->fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  return h->fd == -1 ? -1 : 0;
+}
+
+void history_close(struct history *h) {
+  assert(h);
+  if (h->map != NULL) {
+    munmap((void *) h->map, h->map_size);
+  }
+  free(h->offsets);
+  free(h->blocks);
+  close(h->fd);
+  memset(h, 0, sizeof(struct history));
+  h->fd = -1;
+}
+
+/**
+ * Gives the number of the bit of a trigram in the filters
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static inline unsigned trigram_bit(const unsigned char *s) {
+  uint32_t t = (uint32_t) s[0] << 16 | (uint32_t) s[1] << 8 | s[2];
+  return (t * 2654435761u) >> 20;
+}
+
+/**
+ * Forgets the entries indexed, e.g. when the file was truncated
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void history_reset(struct history *h) {
+  h->end = 0;
+  h->n_entries = 0;
+  if (h->offsets != NULL) {
+    h->offsets[0] = 0;
+  }
+  memset(h->blocks, 0, h->cap_blocks * sizeof(struct history_block));
+}
+
+/**
+ * Maps the bytes appended to the file and indexes the offsets of their complete entries
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 on failure, the entries already indexed being kept
+ */
+static int history_refresh(struct history *h) {
+  struct stat st;
+  if (fstat(h->fd, &st) == -1) {
+    return -1;
+  }
+  size_t size = st.st_size;
+  if (size < h->end) {
+    history_reset(h);
+  }
+  if (size != h->map_size) {
+    void *map = NULL;
+    if (size > 0) {
+      /* the mapping follows the file, the pages already read staying mapped */
+      map = h->map == NULL ? mmap(NULL, size, PROT_READ, MAP_SHARED, h->fd, 0)
+                           : mremap((void *) h->map, h->map_size, size, MREMAP_MAYMOVE);
+    } else if (h->map != NULL) {
+      munmap((void *) h->map, h->map_size);
+    }
+    if (map == MAP_FAILED) {
+      return -1;
+    }
+    h->map = map;
+    h->map_size = size;
+  }
+  if (h->offsets == NULL) {
+    h->offsets = malloc(MIN_ENTRIES * sizeof(size_t));
+    if (h->offsets == NULL) {
+      return -1;
+    }
+    h->cap_entries = MIN_ENTRIES;
+    h->offsets[0] = 0;
+  }
+
+  /* a last line without its '\n' is being written, or was given up */
+  const char *p = h->map + h->end;
+  const char *stop = h->map + h->map_size;
+  const char *nl;
+  while (p < stop && (nl = memchr(p, '\n', stop - p)) != NULL) {
+    if (h->n_entries + 2 > h->cap_entries) {
+      size_t *bigger = realloc(h->offsets, 2 * h->cap_entries * sizeof(size_t));
+      if (bigger == NULL) {
+        return -1;
+      }
+      h->offsets = bigger;
+      h->cap_entries *= 2;
+    }
+    p = nl + 1;
+    h->offsets[++h->n_entries] = p - h->map;
+    h->end = p - h->map;
+  }
+
+  size_t n_blocks = (h->n_entries + HISTORY_BLOCK - 1) / HISTORY_BLOCK;
+  if (n_blocks > h->cap_blocks) {
+    size_t cap = h->cap_blocks ? 2 * h->cap_blocks : MIN_ENTRIES / HISTORY_BLOCK;
+    while (cap < n_blocks) {
+      cap *= 2;
+    }
+    struct history_block *bigger = realloc(h->blocks, cap * sizeof(struct history_block));
+    if (bigger == NULL) {
+      return -1;
+    }
+    memset(bigger + h->cap_blocks, 0, (cap - h->cap_blocks) * sizeof(struct history_block));
+    h->blocks = bigger;
+    h->cap_blocks = cap;
+  }
+  return 0;
+}
+
+size_t history_size(struct history *h) {
+  assert(h);
+  history_refresh(h);
+  return h->n_entries;
+}
+
+const char *history_get(const struct history *h, size_t i, size_t *len) {
+  assert(h);
+  assert(i < h->n_entries);
+  assert(len);
+  *len = h->offsets[i + 1] - h->offsets[i] - 1;
+  return h->map + h->offsets[i];
+}
+
+int history_add(struct history *h, const char *line) {
+  assert(h);
+  assert(line);
+  size_t len = strcspn(line, "\n");
+  if (len == 0) {
+    return 0;
+  }
+  history_refresh(h);
+  if (h->n_entries > 0) {
+    size_t last_len;
+    const char *last = history_get(h, h->n_entries - 1, &last_len);
+    if (last_len == len && memcmp(last, line, len) == 0) {
+      return 0;
+    }
+  }
+  /* a single write : with O_APPEND, the entries of several FiSH can't be mixed */
+  struct iovec iov[2] = { { (void *) line, len }, { "\n", 1 } };
+  ssize_t done;
+  do {
+    done = writev(h->fd, iov, 2);
+  } while (done == -1 && errno == EINTR);
+  return done == (ssize_t) len + 1 ? 0 : -1;
+}
+
+/**
+ * Puts in the filters of a block its entries appended since they were last built
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void block_fill(struct history *h, size_t b) {
+  struct history_block *block = &h->blocks[b];
+  size_t first = b * HISTORY_BLOCK;
+  size_t last = first + HISTORY_BLOCK < h->n_entries ? first + HISTORY_BLOCK : h->n_entries;
+  for (size_t i = first + block->filled; i < last; ++i) {
+    size_t len;
+    const unsigned char *s = (const unsigned char *) history_get(h, i, &len);
+    uint32_t t = 0;
+    for (size_t k = 0; k < len; ++k) {
+      block->bytes[s[k] >> 6] |= (uint64_t) 1 << (s[k] & 63);
+      t = (t << 8 | s[k]) & 0xffffff;
+      if (k >= 2) {
+        unsigned bit = (t * 2654435761u) >> 20;
+        block->trigrams[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+      }
+    }
+  }
+  block->filled = last - first;
+}
+
+/**
+ * Tells whether a block may hold an entry containing the text of a query
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool block_may_match(const struct history_block *block, const struct history_query *q) {
+  for (int w = 0; w < 4; ++w) {
+    if ((block->bytes[w] & q->bytes[w]) != q->bytes[w]) {
+      return false;
+    }
+  }
+  for (size_t k = 0; k < q->n_trigrams; ++k) {
+    if (!(block->trigrams[q->trigrams[k] >> 6] & (uint64_t) 1 << (q->trigrams[k] & 63))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ssize_t history_search(struct history *h, const char *text, size_t len, ssize_t start, int flags) {
+  assert(h);
+  assert(text || len == 0);
+
+  history_refresh(h);
+  ssize_t n = h->n_entries;
+  bool forward = flags & HISTORY_FORWARD;
+  bool prefix = flags & HISTORY_PREFIX;
+  if (n == 0 || (forward && start >= n) || (!forward && start < 0)) {
+    return -1;
+  }
+  if (forward && start < 0) {
+    start = 0;
+  } else if (!forward && start >= n) {
+    start = n - 1;
+  }
+
+  struct history_query q;
+  memset(&q, 0, sizeof(q));
+  const unsigned char *t = (const unsigned char *) text;
+  for (size_t k = 0; k < len; ++k) {
+    q.bytes[t[k] >> 6] |= (uint64_t) 1 << (t[k] & 63);
+  }
+  for (size_t k = 0; k + 2 < len && q.n_trigrams < MAX_TRIGRAMS; ++k) {
+    q.trigrams[q.n_trigrams++] = trigram_bit(t + k);
+  }
+
+  size_t budget = HISTORY_FILL;
+  ssize_t i = start;
+  while (i >= 0 && i < n) {
+    size_t b = i / HISTORY_BLOCK;
+    ssize_t first = b * HISTORY_BLOCK;
+    ssize_t last = first + HISTORY_BLOCK < n ? first + HISTORY_BLOCK : n;
+    /* a few blocks are put in the filters by each search, the other ones being read */
+    struct history_block *block = &h->blocks[b];
+    size_t count = last - first;
+    if (block->filled < count && (block->filled > 0 || budget > 0)) {
+      budget -= block->filled == 0;
+      block_fill(h, b);
+    }
+    if (len == 0 || (block->filled == count
+                         ? block_may_match(block, &q)
+                         : memmem(h->map + h->offsets[first], h->offsets[last] - h->offsets[first], text, len) != NULL)) {
+      for (; i >= first && i < last; i += forward ? 1 : -1) {
+        size_t entry_len;
+        const char *entry = history_get(h, i, &entry_len);
+        if (len == 0 || (prefix ? entry_len >= len && memcmp(entry, text, len) == 0
+                                : memmem(entry, entry_len, text, len) != NULL)) {
+          return i;
+        }
+      }
+    }
+    i = forward ? last : first - 1;
+  }
+  return -1;
+}
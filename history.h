@@ -0,0 +1,103 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define HISTORY_BLOCK 64
+
+#define HISTORY_PREFIX 1   // the entries starting with the text, instead of containing it
+#define HISTORY_FORWARD 2  // from the oldest to the newest, instead of the other way
+
+/**
+ * Filters of a block of HISTORY_BLOCK successive entries of the history
+ *
+ * A bit is set for each byte and for each (hashed) trigram found in the entries :
+ * a text having a byte or a trigram whose bit isn't set is in none of them.
+ */
+struct history_block {
+  uint64_t trigrams[64];
+  uint64_t bytes[4];
+  unsigned filled;         // number of entries of the block put in the filters
+};
+
+/**
+ * History of the command lines, shared by all the FiSH
+ *
+ * The file is an append-only log of lines, each entry being written by a single
+ * write with O_APPEND : the entries of several FiSH are never mixed. It is read
+ * through a mapping, and the offsets of its entries are indexed at the first use,
+ * then only the bytes appended since are read. The filters of a block are built
+ * the first time a search goes through it, so that the next searches skip the
+ * blocks which can't hold the text.
+ */
+struct history {
+  int fd;
+  const char *map;               // the file, NULL until the first use
+  size_t map_size;
+  size_t end;                    // bytes of the complete entries indexed
+  size_t *offsets;               // offset of each entry, then "end"
+  size_t n_entries;
+  size_t cap_entries;
+  struct history_block *blocks;  // filters of the entries, HISTORY_BLOCK per block
+  size_t cap_blocks;
+};
+
+/**
+ * Open the history file, created if needed
+ *
+ * @param h pointer on the struct history to initialize
+ * @param path the history file
+ * @return 0 on success, -1 if the file can't be opened
+ */
+int history_open(struct history *h, const char *path);
+
+/**
+ * Free everything allocated by a struct history and close its file
+ *
+ * @param h pointer on the struct history
+ */
+void history_close(struct history *h);
+
+/**
+ * Append a command line to the history, unless it is empty or the same as the last entry
+ *
+ * @param h pointer on the struct history
+ * @param line the command line, only its first line being kept
+ * @return 0 on success, -1 if it couldn't be written
+ */
+int history_add(struct history *h, const char *line);
+
+/**
+ * Read the entries appended to the file, by this FiSH or by another one
+ *
+ * @param h pointer on the struct history
+ * @return the number of entries, the oldest one being the entry 0
+ */
+size_t history_size(struct history *h);
+
+/**
+ * Give an entry of the history, valid until the next call of a history function
+ *
+ * @param h pointer on the struct history
+ * @param i number of the entry, lower than "history_size"
+ * @param len set to the length of the entry, which isn't '\0' terminated
+ * @return the first character of the entry
+ */
+const char *history_get(const struct history *h, size_t i, size_t *len);
+
+/**
+ * Search the entries matching a text, starting with the entry "start"
+ *
+ * @param h pointer on the struct history
+ * @param text the text searched, not in the history file itself
+ * @param len length of "text"
+ * @param start first entry tested, brought back to the last (or first, forward) entry if beyond
+ * @param flags HISTORY_PREFIX and HISTORY_FORWARD
+ * @return the number of the first entry matching, -1 if none
+ */
+ssize_t history_search(struct history *h, const char *text, size_t len, ssize_t start, int flags);
+
+#endif
@@ -0,0 +1,187 @@
+#define _DEFAULT_SOURCE
+#include "util.h"
+#include "events.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define N_JOBS 10000
+
+/**
+ * Job table shared with the SIGCHLD handler, as in FiSH
+ */
+static struct job_table jobs;
+
+/**
+ * Number of jobs reported by job_table_reap
+ */
+static volatile sig_atomic_t n_reported = 0;
+
+/**
+ * Counts the reaped jobs
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void count(pid_t pid, int wstatus, const struct rusage *usage) {
+  (void) pid;
+  (void) wstatus;
+  (void) usage;
+  ++n_reported;
+}
+
+/**
+ * Signal handler for SIGCHLD, the same as zombie_killer in FiSH without the messages
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void reaper(int signal) {
+  (void) signal;
+  job_table_reap(&jobs, count);
+}
+
+/**
+ * Prints the result of a test
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void check(const char *name, int ok) {
+  printf("TEST %s\n", name);
+  printf(ok ? "TEST OK!\n" : "UNEXPECTED RESULT\n");
+}
+
+/**
+ * Adds, finds and removes many pids, with deleted slots being reused
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void try_table(void) {
+  struct job_table t;
+  job_table_create(&t);
+
+  int ok = 1;
+  for (pid_t pid = 1; pid <= N_JOBS; ++pid) {
+    ok &= job_table_add(&t, pid) == 0;
+  }
+  ok &= t.size == N_JOBS;
+  for (pid_t pid = 1; pid <= N_JOBS; pid += 2) {
+    ok &= job_table_remove(&t, pid) == 0;
+  }
+  ok &= job_table_remove(&t, 1) == -1;
+  for (pid_t pid = 1; pid <= N_JOBS; ++pid) {
+    ok &= job_table_contains(&t, pid) == (pid % 2 == 0);
+  }
+  for (int round = 0; round < 100; ++round) {
+    for (pid_t pid = N_JOBS + 1; pid <= N_JOBS + 100; ++pid) {
+      ok &= job_table_add(&t, pid) == 0;
+    }
+    for (pid_t pid = N_JOBS + 1; pid <= N_JOBS + 100; ++pid) {
+      ok &= job_table_remove(&t, pid) == 0;
+    }
+  }
+  ok &= t.size == N_JOBS / 2;
+  ok &= t.capacity <= 4 * N_JOBS;
+
+  check("job table", ok);
+  job_table_destroy(&t);
+}
+
+/**
+ * Launches N_JOBS children exiting at once and checks that the SIGCHLD handler
+ * reaps them all, none being left as a zombie
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void try_reap(void) {
+  job_table_create(&jobs);
+
+  struct sigaction sa;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_handler = reaper;
+  sigaction(SIGCHLD, &sa, NULL);
+
+  sigset_t chld, old;
+  sigemptyset(&chld);
+  sigaddset(&chld, SIGCHLD);
+
+  int ok = 1;
+  for (int i = 0; i < N_JOBS; ++i) {
+    sigprocmask(SIG_BLOCK, &chld, &old);
+    pid_t pid = fork();
+    if (pid == 0) {
+      _exit(0);
+    }
+    if (pid == -1) {
+      perror("fork");
+      ok = 0;
+    } else {
+      ok &= job_table_add(&jobs, pid) == 0;
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+  }
+
+  /* waiting for the handler to empty the table */
+  sigprocmask(SIG_BLOCK, &chld, &old);
+  while (jobs.size > 0) {
+    sigsuspend(&old);
+  }
+  sigprocmask(SIG_SETMASK, &old, NULL);
+
+  ok &= n_reported == N_JOBS;
+  ok &= waitpid(-1, NULL, WNOHANG) == -1 && errno == ECHILD;
+  check("10000 background jobs reaped", ok);
+  job_table_destroy(&jobs);
+}
+
+/**
+ * Launches N_JOBS children watched by the event loop and checks that polling it
+ * reaps them all, without any signal handler
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void try_events(void) {
+  job_table_create(&jobs);
+  signal(SIGCHLD, SIG_DFL);
+  n_reported = 0;
+
+  struct event_loop loop;
+  int ok = ev_init(&loop, &jobs, count) == 0;
+  for (int i = 0; ok && i < N_JOBS; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      _exit(0);
+    }
+    if (pid == -1) {
+      perror("fork");
+      ok = 0;
+    } else {
+      ok &= job_table_add(&jobs, pid) == 0;
+      ev_watch(&loop, pid);
+    }
+  }
+
+  /* polling for at most 10 seconds */
+  struct timespec pause = { 0, 1000000 };
+  for (int i = 0; ok && jobs.size > 0 && i < 10000; ++i) {
+    if (ev_poll(&loop) == 0) {
+      nanosleep(&pause, NULL);
+    }
+  }
+
+  ok &= n_reported == N_JOBS;
+  ok &= waitpid(-1, NULL, WNOHANG) == -1 && errno == ECHILD;
+  check("10000 background jobs reaped by the event loop", ok);
+  ev_destroy(&loop);
+  job_table_destroy(&jobs);
+}
+
+int main() {
+  try_table();
+  try_reap();
+  try_events();
+  return 0;
+}
@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+#include "parallel.h"
+#include "events.h"
+#include "stats.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define OUTPUT_CHUNK (1 << 16)
+#define MAX_FAILED 101
+#define POLL_UNWATCHED_MS 100
+
+/**
+ * Job of the parallel internal command
+ */
+struct pjob {
+  pid_t pid;
+  int fd;       // read end of the pipe capturing the output, -1 once closed
+  char *out;    // output captured so far
+  size_t len;
+  size_t cap;
+  bool done;    // the output is complete and the process has been waited
+  int status;
+};
+
+/**
+ * Forks a child running a line, its standard output being captured by a pipe
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 on failure (the reason is printed)
+ */
+static int pjob_start(struct pjob *job, char *line, int (*run)(char *line), const sigset_t *mask) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1) {
+    perror("pipe");
+    return -1;
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    if (mask != NULL) {
+      sigprocmask(SIG_SETMASK, mask, NULL);
+    }
+    dup2(fds[1], 1);
+    close(fds[0]);
+    close(fds[1]);
+    int status = run(line);
+    fflush(stdout);
+    _exit(status);
+  }
+  /* the next children are forked without the write end : the pipe ends with the job */
+  close(fds[1]);
+  stats_add(STATS_FORKS, 1);
+  job->pid = pid;
+  job->fd = fds[0];
+  return 0;
+}
+
+/**
+ * Reads the output of a job, then waits for it once the output is complete
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void pjob_read(struct pjob *job) {
+  if (job->cap - job->len < OUTPUT_CHUNK) {
+    size_t cap = job->cap ? 2 * job->cap : OUTPUT_CHUNK;
+    char *out = realloc(job->out, cap);
+    if (out == NULL) {
+      fprintf(stderr, "Memory allocation failure\n");
+    } else {
+      job->out = out;
+      job->cap = cap;
+    }
+  }
+  ssize_t n = -1;
+  if (job->cap - job->len > 0) {
+    n = read(job->fd, job->out + job->len, job->cap - job->len);
+  }
+  if (n == -1 && errno == EINTR) {
+    return;
+  }
+  if (n > 0) {
+    job->len += n;
+    return;
+  }
+  close(job->fd);
+  job->fd = -1;
+  int wstatus;
+  if (waitpid(job->pid, &wstatus, 0) == -1) {
+    job->status = 127;
+  } else {
+    job->status = WIFSIGNALED(wstatus) ? 128 + WTERMSIG(wstatus) : WEXITSTATUS(wstatus);
+  }
+  job->done = true;
+}
+
+/**
+ * Prints the output of a finished job, then frees it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 1 if the job failed, 0 otherwise
+ */
+static int pjob_print(struct pjob *job) {
+  for (size_t done = 0; done < job->len;) {
+    ssize_t n = write(1, job->out + done, job->len - done);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    done += n;
+  }
+  free(job->out);
+  job->out = NULL;
+  job->len = job->cap = 0;
+  return job->status != 0;
+}
+
+/**
+ * Reads the outputs of the running jobs until they are over, blocking,
+ * once they can't be polled anymore
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void pjob_drain(struct pjob *jobs, const size_t *active, size_t n_active) {
+  for (size_t i = 0; i < n_active; ++i) {
+    struct pjob *job = &jobs[active[i]];
+    while (!job->done) {
+      pjob_read(job);
+    }
+  }
+}
+
+/**
+ * Fills the pollfds which wake parallel up when a background job of the shell is over,
+ * which frees a slot
+ *
+ * With pidfds, they are the pidfds of the jobs, the ones without a pidfd being polled
+ * every POLL_UNWATCHED_MS milliseconds. Otherwise it is the signalfd of SIGCHLD, watched
+ * only when parallel runs no job : the event loop would reap the jobs of parallel too.
+ * The epoll instance of the loop can't be polled instead, since it watches the input of
+ * the shell too.
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the number of pollfds filled, "*timeout" being set if some jobs must be polled
+ */
+static size_t pjob_watch_shell(struct event_loop *loop, struct pollfd *pfds, bool idle, int *timeout) {
+  size_t n = 0;
+  if (loop->sigfd != -1) {
+    if (idle) {
+      pfds[n].fd = loop->sigfd;
+      pfds[n++].events = POLLIN;
+    }
+    return n;
+  }
+  struct job_table *table = loop->jobs;
+  for (size_t i = 0; i < table->capacity; ++i) {
+    pid_t pid = table->slots[i].pid;
+    if (pid != JOB_FREE && pid != JOB_DELETED && table->slots[i].pidfd != -1) {
+      pfds[n].fd = table->slots[i].pidfd;
+      pfds[n++].events = POLLIN;
+    }
+  }
+  if (loop->unwatched > 0) {
+    *timeout = POLL_UNWATCHED_MS;
+  }
+  return n;
+}
+
+int parallel_run(char **lines, size_t n_lines, size_t width, bool keep_order,
+                 int (*run)(char *line), const sigset_t *mask, struct event_loop *loop) {
+  assert(lines || n_lines == 0);
+  assert(width > 0);
+  assert(run);
+  assert(loop);
+
+  struct pjob *jobs = calloc(n_lines ? n_lines : 1, sizeof(struct pjob));
+  size_t *active = malloc(width * sizeof(size_t));
+  /* the job table of the shell can only shrink while parallel runs */
+  struct pollfd *pfds = malloc((width + 1 + loop->jobs->size) * sizeof(struct pollfd));
+  if (jobs == NULL || active == NULL || pfds == NULL) {
+    fprintf(stderr, "Memory allocation failure\n");
+    free(jobs);
+    free(active);
+    free(pfds);
+    return MAX_FAILED;
+  }
+  size_t next = 0;     // next job to admit
+  size_t printed = 0;  // number of outputs printed
+  size_t n_active = 0; // number of running jobs
+  size_t failed = 0;
+  while (printed < n_lines) {
+    /* admitting the jobs in input order while a slot is free, the background jobs of the shell taking theirs */
+    while (next < n_lines && loop->jobs->size + n_active < width) {
+      struct pjob *job = &jobs[next];
+      if (pjob_start(job, lines[next], run, mask) == -1) {
+        job->done = true;
+        job->status = 127;
+        if (!keep_order) {
+          failed += pjob_print(job);
+          ++printed;
+        }
+      } else {
+        active[n_active++] = next;
+      }
+      ++next;
+    }
+
+    /* input order : printing the finished jobs which follow the last one printed */
+    while (keep_order && printed < next && jobs[printed].done) {
+      failed += pjob_print(&jobs[printed]);
+      ++printed;
+    }
+    bool waiting = next < n_lines && loop->jobs->size + n_active >= width;
+    if (n_active == 0 && !waiting) {
+      continue;
+    }
+
+    size_t n_fds = n_active;
+    for (size_t i = 0; i < n_active; ++i) {
+      pfds[i].fd = jobs[active[i]].fd;
+      pfds[i].events = POLLIN;
+    }
+    int timeout = -1;
+    if (waiting) {
+      n_fds += pjob_watch_shell(loop, pfds + n_active, n_active == 0, &timeout);
+    }
+    int n_ready = poll(pfds, n_fds, timeout);
+    if (n_ready == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll");
+      /* the running jobs are waited for, the ones not started yet fail */
+      pjob_drain(jobs, active, n_active);
+      for (size_t i = 0; i < n_active && !keep_order; ++i) {
+        failed += pjob_print(&jobs[active[i]]);
+      }
+      while (keep_order && printed < next) {
+        failed += pjob_print(&jobs[printed++]);
+      }
+      failed += n_lines - next;
+      break;
+    }
+    if (n_fds > n_active || n_ready == 0) {
+      /* a background job may be over : the event loop reaps and reports it */
+      ev_poll(loop);
+    }
+    for (size_t i = n_active; i-- > 0;) {
+      if (pfds[i].revents == 0) {
+        continue;
+      }
+      struct pjob *job = &jobs[active[i]];
+      pjob_read(job);
+      if (!job->done) {
+        continue;
+      }
+      active[i] = active[--n_active];
+      /* completion order : printed right now */
+      if (!keep_order) {
+        failed += pjob_print(job);
+        ++printed;
+      }
+    }
+  }
+
+  free(pfds);
+  free(active);
+  free(jobs);
+  return failed > MAX_FAILED ? MAX_FAILED : (int) failed;
+}
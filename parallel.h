@@ -0,0 +1,37 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <signal.h>
+
+#include "events.h"
+
+/**
+ * Job-slot scheduler of the parallel internal command
+ *
+ * Each job is a command line run in a child of FiSH (forked, without exec) whose
+ * standard output is captured through a pipe. At most "width" jobs run at once,
+ * the background jobs of the shell included : a job is admitted, in input order,
+ * as soon as fewer than "width" jobs are running, counting the live job table of
+ * the shell, whose terminated jobs are reaped and reported by its event loop
+ * meanwhile. The output of a job is printed as a whole, once the job is over,
+ * either in completion order or in input order.
+ */
+
+/**
+ * Runs command lines in parallel, writing their outputs on the standard output
+ *
+ * @param lines the command lines, modified by "run"
+ * @param n_lines number of lines
+ * @param width maximal number of jobs running at once
+ * @param keep_order true to print the outputs in input order, false for completion order
+ * @param run function running a line in the child, returning its exit status
+ * @param mask signal mask of the children
+ * @param loop the event loop of the shell, with its job table
+ * @return the number of jobs which failed (the ones not run included), at most 101
+ */
+int parallel_run(char **lines, size_t n_lines, size_t width, bool keep_order,
+                 int (*run)(char *line), const sigset_t *mask, struct event_loop *loop);
+
+#endif
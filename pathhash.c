@@ -0,0 +1,278 @@
+#define _DEFAULT_SOURCE
+#include "pathhash.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define INIT_CAP 64
+#define STAMP_INTERVAL 1000000000u // nanoseconds during which the modification times of PATH are trusted
+
+/**
+ * FNV-1a hash of a string
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static uint64_t hash_str(const char *str) {
+  uint64_t h = 14695981039346656037ULL;
+  for (; *str; ++str) {
+    h ^= (unsigned char) *str;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+void path_hash_init(struct path_hash *h) {
+  assert(h);
+  h->entries = NULL;
+  h->capacity = 0;
+  h->size = 0;
+  h->path_env = NULL;
+  h->stamp = 0;
+  h->stamped = 0;
+}
+
+void path_hash_reset(struct path_hash *h) {
+  assert(h);
+  for (size_t i = 0; i < h->capacity; ++i) {
+    free(h->entries[i].name);
+    free(h->entries[i].path);
+  }
+  if (h->capacity > 0) {
+    memset(h->entries, 0, h->capacity * sizeof(struct path_entry));
+  }
+  h->size = 0;
+  h->stamped = 0;
+}
+
+void path_hash_destroy(struct path_hash *h) {
+  assert(h);
+  path_hash_reset(h);
+  free(h->entries);
+  free(h->path_env);
+  path_hash_init(h);
+}
+
+/**
+ * Search PATH for a command, the way execvp does
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * An empty component of PATH stands for the current directory.
+ *
+ * @param name name of the command
+ * @return the path of the command in a dynamically allocated string, NULL if it isn't found
+ */
+static char *search_path(const char *name) {
+  const char *dirs = getenv("PATH");
+  if (dirs == NULL) {
+    dirs = "/bin:/usr/bin";
+  }
+  size_t len_name = strlen(name);
+
+  for (;;) {
+    const char *colon = strchr(dirs, ':');
+    size_t len_dir = colon ? (size_t) (colon - dirs) : strlen(dirs);
+    char candidate[len_dir + len_name + 3];
+    if (len_dir == 0) {
+      candidate[0] = '.';
+      len_dir = 1;
+    } else {
+      memcpy(candidate, dirs, len_dir);
+    }
+    candidate[len_dir] = '/';
+    memcpy(candidate + len_dir + 1, name, len_name + 1);
+
+    struct stat st;
+    if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+      return strdup(candidate);
+    }
+    if (colon == NULL) {
+      return NULL;
+    }
+    dirs = colon + 1;
+  }
+}
+
+/**
+ * Combine the modification times of the directories of PATH, so that a command
+ * added to one of them (or a directory created or removed) changes the result
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static uint64_t path_stamp(void) {
+  const char *dirs = getenv("PATH");
+  if (dirs == NULL) {
+    dirs = "/bin:/usr/bin";
+  }
+  uint64_t stamp = 14695981039346656037ULL;
+  for (;;) {
+    const char *colon = strchr(dirs, ':');
+    size_t len_dir = colon ? (size_t) (colon - dirs) : strlen(dirs);
+    char dir[len_dir + 2];
+    if (len_dir == 0) {
+      strcpy(dir, ".");
+    } else {
+      memcpy(dir, dirs, len_dir);
+      dir[len_dir] = '\0';
+    }
+    struct stat st;
+    uint64_t mtime = 0;
+    if (stat(dir, &st) == 0) {
+      mtime = (uint64_t) st.st_mtim.tv_sec * 1000000000u + st.st_mtim.tv_nsec;
+    }
+    stamp = (stamp ^ mtime) * 1099511628211ULL;
+    if (colon == NULL) {
+      return stamp;
+    }
+    dirs = colon + 1;
+  }
+}
+
+/**
+ * Give the stamp of the directories of PATH, computed again once it is older than
+ * STAMP_INTERVAL : a lookup answered by a negative entry costs no system call
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static uint64_t path_stamp_cached(struct path_hash *h) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  uint64_t now = (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec + 1;
+  if (h->stamped == 0 || now - h->stamped >= STAMP_INTERVAL) {
+    h->stamp = path_stamp();
+    h->stamped = now;
+  }
+  return h->stamp;
+}
+
+/**
+ * Find the slot of a name, free or not
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static struct path_entry *find_slot(const struct path_hash *h, const char *name) {
+  size_t mask = h->capacity - 1;
+  size_t i = hash_str(name) & mask;
+  while (h->entries[i].name && strcmp(h->entries[i].name, name) != 0) {
+    i = (i + 1) & mask;
+  }
+  return &h->entries[i];
+}
+
+/**
+ * Double the capacity of the table
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int grow(struct path_hash *h) {
+  struct path_hash bigger = *h;
+  bigger.capacity = h->capacity ? 2 * h->capacity : INIT_CAP;
+  bigger.entries = calloc(bigger.capacity, sizeof(struct path_entry));
+  if (bigger.entries == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < h->capacity; ++i) {
+    if (h->entries[i].name) {
+      *find_slot(&bigger, h->entries[i].name) = h->entries[i];
+    }
+  }
+  free(h->entries);
+  *h = bigger;
+  return 0;
+}
+
+/**
+ * Empty the table if PATH changed since the entries were computed
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void check_path_env(struct path_hash *h) {
+  const char *env = getenv("PATH");
+  if (env == NULL) {
+    env = "";
+  }
+  if (h->path_env && strcmp(h->path_env, env) == 0) {
+    return;
+  }
+  path_hash_reset(h);
+  free(h->path_env);
+  h->path_env = strdup(env);
+}
+
+const char *path_hash_lookup(struct path_hash *h, const char *name) {
+  assert(h);
+  assert(name);
+
+  if (strchr(name, '/')) {
+    return name;
+  }
+  check_path_env(h);
+
+  if (4 * (h->size + 1) > 3 * h->capacity && grow(h) == -1) {
+    fprintf(stderr, "Memory allocation failure\n");
+    return NULL;
+  }
+
+  struct path_entry *e = find_slot(h, name);
+  if (e->name == NULL) {
+    e->name = strdup(name);
+    if (e->name == NULL) {
+      fprintf(stderr, "Memory allocation failure\n");
+      return NULL;
+    }
+    e->stamp = path_stamp_cached(h);
+    e->path = search_path(name);
+    e->hits = 0;
+    ++h->size;
+  } else if (e->path == NULL) {
+    /* a negative entry is only trusted while the directories of PATH are unchanged */
+    uint64_t stamp = path_stamp_cached(h);
+    if (stamp != e->stamp) {
+      e->stamp = stamp;
+      e->path = search_path(name);
+    }
+  }
+  ++e->hits;
+  return e->path;
+}
+
+const char *path_hash_refresh(struct path_hash *h, const char *name) {
+  assert(h);
+  assert(name);
+
+  if (strchr(name, '/')) {
+    return name;
+  }
+  check_path_env(h);
+  if (h->capacity == 0) {
+    return path_hash_lookup(h, name);
+  }
+
+  struct path_entry *e = find_slot(h, name);
+  if (e->name == NULL) {
+    return path_hash_lookup(h, name);
+  }
+  free(e->path);
+  e->stamp = path_stamp_cached(h);
+  e->path = search_path(name);
+  return e->path;
+}
+
+void path_hash_print(const struct path_hash *h, FILE *out) {
+  assert(h);
+  assert(out);
+
+  fprintf(out, "hits\tcommand\n");
+  for (size_t i = 0; i < h->capacity; ++i) {
+    const struct path_entry *e = &h->entries[i];
+    if (e->name) {
+      fprintf(out, "%4zu\t%s\t%s\n", e->hits, e->name, e->path ? e->path : "(not found)");
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef PATHHASH_H
+#define PATHHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Entry of the command hash table
+ */
+struct path_entry {
+  char *name;   // NULL if the slot is free
+  char *path;   // absolute path of the command, NULL if it isn't in PATH (negative entry)
+  size_t hits;  // number of lookups answered by this entry
+  uint64_t stamp; // for a negative entry, the modification times of the PATH directories when it was searched
+};
+
+/**
+ * Hash table mapping command names to their location in PATH
+ *
+ * The entries are only valid for the value of PATH they were computed with :
+ * the whole table is emptied when PATH changes.
+ */
+struct path_hash {
+  struct path_entry *entries;
+  size_t capacity; // always a power of 2
+  size_t size;
+  char *path_env;  // copy of PATH when the entries were computed
+  uint64_t stamp;  // modification times of the directories of PATH, see "path_hash_lookup"
+  uint64_t stamped; // CLOCK_MONOTONIC time when "stamp" was computed, plus 1, 0 if it wasn't
+};
+
+/**
+ * Init an empty struct path_hash
+ *
+ * @param h pointer on the struct path_hash to initialize
+ */
+void path_hash_init(struct path_hash *h);
+
+/**
+ * Free all the memory used by the table
+ *
+ * @param h pointer on the struct path_hash to destroy
+ */
+void path_hash_destroy(struct path_hash *h);
+
+/**
+ * Forget all the entries, like "hash -r"
+ *
+ * @param h pointer on the struct path_hash
+ */
+void path_hash_reset(struct path_hash *h);
+
+/**
+ * Find the absolute path of a command
+ *
+ * PATH is only searched if the name isn't in the table yet, and the result is kept,
+ * even when the command isn't found : such a negative entry is searched again once
+ * one of the directories of PATH has been modified, e.g. when a command is installed.
+ * The modification times are checked at most once per second, so that a command
+ * installed may be missed during a second.
+ * Names holding a '/' are returned as is.
+ *
+ * @param h pointer on the struct path_hash
+ * @param name name of the command
+ * @return the path of the command, NULL if it isn't in PATH
+ */
+const char *path_hash_lookup(struct path_hash *h, const char *name);
+
+/**
+ * Search PATH again for a command whose cached path couldn't be run
+ *
+ * @param h pointer on the struct path_hash
+ * @param name name of the command
+ * @return the new path of the command, NULL if it isn't in PATH anymore
+ */
+const char *path_hash_refresh(struct path_hash *h, const char *name);
+
+/**
+ * Print the entries of the table, one per line : hits, then name and path
+ *
+ * @param h pointer on the struct path_hash
+ * @param out stream to print to
+ */
+void path_hash_print(const struct path_hash *h, FILE *out);
+
+#endif
@@ -0,0 +1,199 @@
+#include "scan.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/**
+ * Signature of the functions classifying a chunk of 64 bytes
+ */
+typedef void (*classify64_fn)(const unsigned char *p, uint64_t *space, uint64_t *quote, uint64_t *special);
+
+/**
+ * Classify 64 bytes, one at a time
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void classify64_scalar(const unsigned char *p, uint64_t *space, uint64_t *quote, uint64_t *special) {
+  uint64_t sp = 0, qu = 0, spe = 0;
+  for (size_t i = 0; i < 64; ++i) {
+    uint64_t bit = (uint64_t) 1 << i;
+    switch (p[i]) {
+      case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+        sp |= bit;
+        break;
+      case '"':
+        qu |= bit;
+        break;
+      case '<': case '>': case '&': case '|':
+        spe |= bit;
+        break;
+      default:
+        break;
+    }
+  }
+  *space = sp;
+  *quote = qu;
+  *special = spe;
+}
+
+#ifdef SCAN_X86
+
+/**
+ * Classify 64 bytes, 16 at a time with SSE2
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ * '\t' to '\r' are contiguous : (c - '\t') <= 4 as an unsigned byte is tested with min_epu8.
+ */
+__attribute__((target("sse2")))
+static void classify64_sse2(const unsigned char *p, uint64_t *space, uint64_t *quote, uint64_t *special) {
+  const __m128i blank = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i four = _mm_set1_epi8(4);
+  const __m128i dquote = _mm_set1_epi8('"');
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i gt = _mm_set1_epi8('>');
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i bar = _mm_set1_epi8('|');
+
+  uint64_t sp = 0, qu = 0, spe = 0;
+  for (int k = 0; k < 4; ++k) {
+    __m128i x = _mm_loadu_si128((const __m128i *) (p + 16 * k));
+    __m128i ctl = _mm_sub_epi8(x, tab);
+    __m128i s = _mm_or_si128(_mm_cmpeq_epi8(x, blank), _mm_cmpeq_epi8(_mm_min_epu8(ctl, four), ctl));
+    __m128i q = _mm_cmpeq_epi8(x, dquote);
+    __m128i o = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, lt), _mm_cmpeq_epi8(x, gt)),
+                             _mm_or_si128(_mm_cmpeq_epi8(x, amp), _mm_cmpeq_epi8(x, bar)));
+    sp |= (uint64_t) (uint16_t) _mm_movemask_epi8(s) << (16 * k);
+    qu |= (uint64_t) (uint16_t) _mm_movemask_epi8(q) << (16 * k);
+    spe |= (uint64_t) (uint16_t) _mm_movemask_epi8(o) << (16 * k);
+  }
+  *space = sp;
+  *quote = qu;
+  *special = spe;
+}
+
+/**
+ * Classify 64 bytes, 32 at a time with AVX2
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+__attribute__((target("avx2")))
+static void classify64_avx2(const unsigned char *p, uint64_t *space, uint64_t *quote, uint64_t *special) {
+  const __m256i blank = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i four = _mm256_set1_epi8(4);
+  const __m256i dquote = _mm256_set1_epi8('"');
+  const __m256i lt = _mm256_set1_epi8('<');
+  const __m256i gt = _mm256_set1_epi8('>');
+  const __m256i amp = _mm256_set1_epi8('&');
+  const __m256i bar = _mm256_set1_epi8('|');
+
+  uint64_t sp = 0, qu = 0, spe = 0;
+  for (int k = 0; k < 2; ++k) {
+    __m256i x = _mm256_loadu_si256((const __m256i *) (p + 32 * k));
+    __m256i ctl = _mm256_sub_epi8(x, tab);
+    __m256i s = _mm256_or_si256(_mm256_cmpeq_epi8(x, blank),
+                                _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, four), ctl));
+    __m256i q = _mm256_cmpeq_epi8(x, dquote);
+    __m256i o = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, lt), _mm256_cmpeq_epi8(x, gt)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(x, amp), _mm256_cmpeq_epi8(x, bar)));
+    sp |= (uint64_t) (uint32_t) _mm256_movemask_epi8(s) << (32 * k);
+    qu |= (uint64_t) (uint32_t) _mm256_movemask_epi8(q) << (32 * k);
+    spe |= (uint64_t) (uint32_t) _mm256_movemask_epi8(o) << (32 * k);
+  }
+  *space = sp;
+  *quote = qu;
+  *special = spe;
+}
+
+#endif
+
+/**
+ * Choose the fastest classification function supported by the processor
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return pointer on the classification function
+ */
+static classify64_fn classify64_select(void) {
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return classify64_avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return classify64_sse2;
+  }
+#endif
+  return classify64_scalar;
+}
+
+size_t scan_words(size_t len) {
+  return len / 64 + 1;
+}
+
+void scan_classify(struct scan *sc, const char *str, size_t len) {
+  assert(sc);
+  assert(str);
+
+  static classify64_fn classify64 = NULL;
+  if (classify64 == NULL) {
+    classify64 = classify64_select();
+  }
+
+  const unsigned char *p = (const unsigned char *) str;
+  size_t w = 0;
+  for (; 64 * (w + 1) <= len; ++w) {
+    classify64(p + 64 * w, &sc->space[w], &sc->quote[w], &sc->special[w]);
+  }
+
+  // the tail is padded with '\0', which belongs to no class
+  unsigned char tail[64] = { 0 };
+  memcpy(tail, p + 64 * w, len - 64 * w);
+  classify64(tail, &sc->space[w], &sc->quote[w], &sc->special[w]);
+
+  sc->len = len;
+}
+
+size_t scan_next(const uint64_t *bits, size_t from, size_t len) {
+  if (from >= len) {
+    return len;
+  }
+  size_t w = from / 64;
+  uint64_t word = bits[w] & (~(uint64_t) 0 << (from % 64));
+  size_t last = (len - 1) / 64;
+  while (word == 0) {
+    if (w == last) {
+      return len;
+    }
+    word = bits[++w];
+  }
+  size_t i = 64 * w + __builtin_ctzll(word);
+  return i < len ? i : len;
+}
+
+size_t scan_next_clear(const uint64_t *bits, size_t from, size_t len) {
+  if (from >= len) {
+    return len;
+  }
+  size_t w = from / 64;
+  uint64_t word = ~bits[w] & (~(uint64_t) 0 << (from % 64));
+  size_t last = (len - 1) / 64;
+  while (word == 0) {
+    if (w == last) {
+      return len;
+    }
+    word = ~bits[++w];
+  }
+  size_t i = 64 * w + __builtin_ctzll(word);
+  return i < len ? i : len;
+}
+
+bool scan_any(const uint64_t *bits, size_t from, size_t to) {
+  return from < to && scan_next(bits, from, to) < to;
+}
@@ -0,0 +1,71 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Character classes of a command line, one bit per byte
+ *
+ * Bit i of a bitmap is set when the i-th byte of the line belongs to the class.
+ * Bits beyond the length of the line are always 0.
+ */
+struct scan {
+  uint64_t *space;   // ' ', '\t', '\n', '\v', '\f', '\r' (isspace in the C locale)
+  uint64_t *quote;   // '"'
+  uint64_t *special; // '<', '>', '&', '|'
+  size_t len;
+};
+
+/**
+ * Number of 64 bits words needed by each bitmap of a line of "len" bytes
+ *
+ * @param len length of the line
+ * @return number of words
+ */
+size_t scan_words(size_t len);
+
+/**
+ * Classify all the bytes of "str" in a single pass
+ *
+ * SSE2 or AVX2 is used when the processor supports it, a scalar loop otherwise.
+ * The three bitmaps of "sc" must already point on "scan_words(len)" words each.
+ *
+ * @param sc pointer on the struct scan to fill
+ * @param str pointer on the first char of the line
+ * @param len length of the line
+ */
+void scan_classify(struct scan *sc, const char *str, size_t len);
+
+/**
+ * Search the first set bit of a bitmap from the "from" position
+ *
+ * @param bits bitmap of a struct scan
+ * @param from index of the first byte to look at
+ * @param len length of the line
+ * @return the index of the first set bit, "len" if there is none
+ */
+size_t scan_next(const uint64_t *bits, size_t from, size_t len);
+
+/**
+ * Search the first clear bit of a bitmap from the "from" position
+ *
+ * @param bits bitmap of a struct scan
+ * @param from index of the first byte to look at
+ * @param len length of the line
+ * @return the index of the first clear bit, "len" if there is none
+ */
+size_t scan_next_clear(const uint64_t *bits, size_t from, size_t len);
+
+/**
+ * Test if a bitmap has a set bit in the range [from, to[
+ *
+ * @param bits bitmap of a struct scan
+ * @param from index of the first byte of the range
+ * @param to index of the byte following the range
+ * @return true if at least one bit is set, false otherwise
+ */
+bool scan_any(const uint64_t *bits, size_t from, size_t to);
+
+#endif
@@ -0,0 +1,815 @@
+#define _GNU_SOURCE
+#include "script.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_CAP 16
+#define MAX_NAME 256
+#define NO_JUMP UINT32_MAX
+#define BLANKS " \t\n\v\f\r"
+
+/**
+ * Control structure being compiled
+ */
+enum block_kind { BLOCK_IF, BLOCK_WHILE, BLOCK_FOR, BLOCK_REPEAT };
+
+struct block {
+  enum block_kind kind;
+  size_t lineno;       // line of the keyword, for the errors
+  uint32_t top;        // instruction starting an iteration : the condition of a "while", the SCRIPT_NEXT of the others
+  uint32_t failed;     // SCRIPT_JUMP_FAILED going to the next branch of an "if" or out of a "while", NO_JUMP if none
+  uint32_t exits;      // chain of the jumps to the end of the block, plus 1, 0 if none
+  uint32_t loop;       // the loop of a "for" or a "repeat"
+  bool has_else;
+  const char *name;    // the variable of a "for"
+  size_t name_len;
+};
+
+/**
+ * State of the compiler : the control structures open, the innermost last
+ */
+struct compiler {
+  struct script *s;
+  struct block *blocks;
+  size_t n_blocks;
+  size_t cap_blocks;
+  size_t lineno;
+};
+
+/**
+ * Gives an array with room for one more element, NULL if a memory allocation failure
+ * occurs (the array is then unchanged)
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void *grow(void *array, size_t *cap, size_t n, size_t size) {
+  if (n < *cap) {
+    return array;
+  }
+  size_t new_cap = *cap ? 2 * *cap : MIN_CAP;
+  void *bigger = realloc(array, new_cap * size);
+  if (bigger != NULL) {
+    *cap = new_cap;
+  }
+  return bigger;
+}
+
+/**
+ * Prints an error of the script, giving -2 to tell it from a memory allocation failure
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int compile_error(size_t lineno, const char *message) {
+  fprintf(stderr, "Error while compiling line %zu: %s\n", lineno, message);
+  return -2;
+}
+
+/**
+ * Appends an instruction, giving its index
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int64_t emit(struct script *s, enum script_op op, size_t a, size_t b) {
+  struct script_insn *code = grow(s->code, &s->cap_code, s->n_code, sizeof(struct script_insn));
+  if (code == NULL) {
+    return -1;
+  }
+  s->code = code;
+  code[s->n_code] = (struct script_insn) { op, a, b };
+  return s->n_code++;
+}
+
+/**
+ * Sets the target of a chain of jumps
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void patch(struct script *s, uint32_t chain, size_t target) {
+  while (chain != 0) {
+    struct script_insn *insn = &s->code[chain - 1];
+    chain = insn->a;
+    insn->a = target;
+  }
+}
+
+/**
+ * Appends a jump to the chain of the jumps leaving a block
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int emit_exit(struct script *s, struct block *b) {
+  int64_t jump = emit(s, SCRIPT_JUMP, b->exits, 0);
+  if (jump == -1) {
+    return -1;
+  }
+  b->exits = jump + 1;
+  return 0;
+}
+
+/**
+ * Appends a segment to the current template
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int add_segment(struct script *s, const char *text, size_t len, uint32_t kind) {
+  struct script_segment *segments =
+      grow(s->segments, &s->cap_segments, s->n_segments, sizeof(struct script_segment));
+  if (segments == NULL) {
+    return -1;
+  }
+  s->segments = segments;
+  segments[s->n_segments++] = (struct script_segment) { text, len, kind };
+  return 0;
+}
+
+/**
+ * Gives the length of the name of a variable starting a text, 0 if there is none
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static size_t name_length(const char *text) {
+  size_t len = 0;
+  while ((text[len] >= 'a' && text[len] <= 'z') || (text[len] >= 'A' && text[len] <= 'Z') || text[len] == '_'
+         || (len > 0 && text[len] >= '0' && text[len] <= '9')) {
+    ++len;
+  }
+  return len;
+}
+
+/**
+ * Finds the next variable of a text : "$name", "${name}" or "$?"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return pointer on its '$', NULL if there is none ; "pname" and "plen" are set to its name,
+ * of length 0 for "$?", and "pskip" to the number of characters after the '$'
+ */
+static const char *next_variable(const char *p, const char **pname, size_t *plen, size_t *pskip) {
+  for (p = strchr(p, '$'); p != NULL; p = strchr(p + 1, '$')) {
+    const char *name = p + 1;
+    size_t len = 0;
+    size_t skip = 0;
+    if (*name == '?') {
+      skip = 1;
+    } else if (*name == '{') {
+      len = name_length(++name);
+      skip = len > 0 && name[len] == '}' ? len + 2 : 0;
+    } else {
+      len = skip = name_length(name);
+    }
+    if (skip != 0) {
+      *pname = name;
+      *plen = len;
+      *pskip = skip;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Tells whether a command line holds a pattern, split into words the way the parser does :
+ * the words between quotes aren't patterns, nor the ones holding variables, which are slots
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static bool has_pattern(const char *text) {
+  const char *p = text + strspn(text, BLANKS);
+  while (*p != '\0') {
+    size_t len;
+    if (*p == '"') {
+      const char *quote = strchr(p + 1, '"');
+      len = quote != NULL ? (size_t) (quote + 1 - p) : strlen(p);
+    } else {
+      len = strcspn(p, BLANKS);
+      const char *name;
+      size_t name_len;
+      size_t skip;
+      const char *var = next_variable(p, &name, &name_len, &skip);
+      if ((var == NULL || var >= p + len) && expand_has_magic(p, len)) {
+        return true;
+      }
+    }
+    p += len;
+    p += strspn(p, BLANKS);
+  }
+  return false;
+}
+
+/**
+ * Compiles the variables of a text into a template, resolved in the
+ * control structures open, giving the index of the template
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int64_t add_template(struct compiler *c, const char *text) {
+  struct script *s = c->s;
+  struct script_template *templates =
+      grow(s->templates, &s->cap_templates, s->n_templates, sizeof(struct script_template));
+  if (templates == NULL) {
+    return -1;
+  }
+  s->templates = templates;
+  size_t first = s->n_segments;
+  const char *name;
+  size_t len;
+  size_t skip;
+  for (const char *p = next_variable(text, &name, &len, &skip); p != NULL;
+       p = next_variable(p + 1 + skip, &name, &len, &skip)) {
+    uint32_t kind = len == 0 ? SCRIPT_STATUS : SCRIPT_ENV;
+    for (size_t i = c->n_blocks; i > 0 && kind == SCRIPT_ENV; --i) {
+      const struct block *b = &c->blocks[i - 1];
+      if (b->kind == BLOCK_FOR && b->name_len == len && memcmp(b->name, name, len) == 0) {
+        kind = SCRIPT_VAR + b->loop;
+      }
+    }
+    if (add_segment(s, name, len, kind) == -1) {
+      return -1;
+    }
+  }
+  templates[s->n_templates] = (struct script_template) { first, s->n_segments - first };
+  return s->n_templates++;
+}
+
+/**
+ * Appends a line, giving its index
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int64_t add_line(struct compiler *c, char *text, bool once, bool reparse) {
+  struct script *s = c->s;
+  const char *name;
+  size_t len;
+  size_t skip;
+  int64_t vars = next_variable(text, &name, &len, &skip) == NULL ? (int64_t) UINT32_MAX : add_template(c, text);
+  struct script_line *lines = grow(s->lines, &s->cap_lines, s->n_lines, sizeof(struct script_line));
+  if (vars == -1 || lines == NULL) {
+    return -1;
+  }
+  s->lines = lines;
+  struct script_line *line = &lines[s->n_lines];
+  memset(line, 0, sizeof(struct script_line));
+  line->text = text;
+  line->vars = vars;
+  line->once = once;
+  line->reparse = reparse;
+  return s->n_lines++;
+}
+
+/**
+ * Compiles a command line : it is parsed once if it may run several times
+ * and holds no pattern, in place when it runs if it runs once and holds no variable
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int compile_cmdline(struct compiler *c, char *text, bool repeated) {
+  struct script *s = c->s;
+  for (size_t i = 0; i < c->n_blocks && !repeated; ++i) {
+    repeated = c->blocks[i].kind != BLOCK_IF;
+  }
+  const char *name;
+  size_t len;
+  size_t skip;
+  bool text_only = !repeated && next_variable(text, &name, &len, &skip) == NULL;
+  int64_t line = add_line(c, text, !repeated, repeated && has_pattern(text));
+  if (line == -1) {
+    return -1;
+  }
+  return emit(s, text_only ? SCRIPT_TEXT : SCRIPT_LINE, line, 0) == -1 ? -1 : 0;
+}
+
+/**
+ * Opens a control structure
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static struct block *open_block(struct compiler *c, enum block_kind kind) {
+  struct block *blocks = grow(c->blocks, &c->cap_blocks, c->n_blocks, sizeof(struct block));
+  if (blocks == NULL) {
+    return NULL;
+  }
+  c->blocks = blocks;
+  struct block *b = &blocks[c->n_blocks++];
+  memset(b, 0, sizeof(struct block));
+  b->kind = kind;
+  b->lineno = c->lineno;
+  b->top = c->s->n_code;
+  b->failed = NO_JUMP;
+  return b;
+}
+
+/**
+ * Compiles the condition of an "if" or a "while", followed by the jump taken when it fails
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int compile_condition(struct compiler *c, struct block *b, char *cond, const char *keyword) {
+  if (*cond == '\0') {
+    char message[64];
+    snprintf(message, sizeof(message), "\"%s\" needs a command line", keyword);
+    return compile_error(c->lineno, message);
+  }
+  if (compile_cmdline(c, cond, b->kind == BLOCK_WHILE) == -1) {
+    return -1;
+  }
+  int64_t jump = emit(c->s, SCRIPT_JUMP_FAILED, 0, 0);
+  b->failed = jump;
+  return jump == -1 ? -1 : 0;
+}
+
+/**
+ * Opens a loop, "words" being the text of the words of a "for", NULL for a "repeat"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int compile_loop(struct compiler *c, enum block_kind kind, char *words, size_t count) {
+  struct script *s = c->s;
+  int64_t line = words == NULL ? (int64_t) UINT32_MAX : add_line(c, words, false, true);
+  struct script_loop *loops = grow(s->loops, &s->cap_loops, s->n_loops, sizeof(struct script_loop));
+  if (line == -1 || loops == NULL) {
+    return -1;
+  }
+  s->loops = loops;
+  struct script_loop *loop = &loops[s->n_loops];
+  loop->words = line;
+  loop->n = count;
+  loop->next = 0;
+  struct block *b = open_block(c, kind);
+  if (b == NULL || emit(s, SCRIPT_LOOP, s->n_loops, 0) == -1) {
+    return -1;
+  }
+  b->loop = s->n_loops++;
+  b->top = s->n_code;
+  return emit(s, SCRIPT_NEXT, b->loop, 0) == -1 ? -1 : 0;
+}
+
+/**
+ * Gives the innermost loop open, NULL if there is none
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static struct block *innermost_loop(struct compiler *c) {
+  for (size_t i = c->n_blocks; i > 0; --i) {
+    if (c->blocks[i - 1].kind != BLOCK_IF) {
+      return &c->blocks[i - 1];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Closes the innermost control structure
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int compile_end(struct compiler *c) {
+  struct script *s = c->s;
+  struct block *b = &c->blocks[c->n_blocks - 1];
+  if (b->kind != BLOCK_IF && emit(s, SCRIPT_JUMP, b->top, 0) == -1) {
+    return -1;
+  }
+  if (b->failed != NO_JUMP) {
+    s->code[b->failed].a = s->n_code;
+  }
+  if (b->kind == BLOCK_FOR || b->kind == BLOCK_REPEAT) {
+    s->code[b->top].b = s->n_code;
+  }
+  patch(s, b->exits, s->n_code);
+  --c->n_blocks;
+  return 0;
+}
+
+/**
+ * Compiles a line of the script
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int compile_line(struct compiler *c, char *text) {
+  struct script *s = c->s;
+  char *word = text + strspn(text, " \t");
+  size_t len = strcspn(word, " \t");
+  char *rest = word + len + strspn(word + len, " \t");
+  struct block *b = c->n_blocks > 0 ? &c->blocks[c->n_blocks - 1] : NULL;
+
+  if (len == 2 && memcmp(word, "if", 2) == 0) {
+    b = open_block(c, BLOCK_IF);
+    return b == NULL ? -1 : compile_condition(c, b, rest, "if");
+  }
+  if (len == 5 && memcmp(word, "while", 5) == 0) {
+    b = open_block(c, BLOCK_WHILE);
+    return b == NULL ? -1 : compile_condition(c, b, rest, "while");
+  }
+  if (len == 4 && memcmp(word, "else", 4) == 0) {
+    if (b == NULL || b->kind != BLOCK_IF || b->has_else) {
+      return compile_error(c->lineno, "\"else\" without \"if\"");
+    }
+    /* the branch taken ends the "if", the condition which failed goes to the next one */
+    if (emit_exit(s, b) == -1) {
+      return -1;
+    }
+    s->code[b->failed].a = s->n_code;
+    b->failed = NO_JUMP;
+    size_t if_len = strcspn(rest, " \t");
+    if (if_len == 2 && memcmp(rest, "if", 2) == 0) {
+      return compile_condition(c, b, rest + 2 + strspn(rest + 2, " \t"), "else if");
+    }
+    b->has_else = true;
+    return *rest == '\0' ? 0 : compile_error(c->lineno, "\"else\" takes no argument");
+  }
+  if (len == 3 && memcmp(word, "for", 3) == 0) {
+    size_t name_len = name_length(rest);
+    char *in = rest + name_len + strspn(rest + name_len, " \t");
+    if (name_len == 0 || strcspn(rest, " \t") != name_len || strncmp(in, "in", 2) != 0
+        || (in[2] != '\0' && in[2] != ' ' && in[2] != '\t')) {
+      return compile_error(c->lineno, "usage: for name in words");
+    }
+    if (compile_loop(c, BLOCK_FOR, in + 2 + strspn(in + 2, " \t"), 0) == -1) {
+      return -1;
+    }
+    b = &c->blocks[c->n_blocks - 1];
+    b->name = rest;
+    b->name_len = name_len;
+    return 0;
+  }
+  if (len == 6 && memcmp(word, "repeat", 6) == 0) {
+    char *end;
+    unsigned long long count = strtoull(rest, &end, 10);
+    if (*rest < '0' || *rest > '9' || end[strspn(end, " \t")] != '\0') {
+      return compile_error(c->lineno, "usage: repeat N");
+    }
+    return compile_loop(c, BLOCK_REPEAT, NULL, count);
+  }
+  if ((len == 5 && memcmp(word, "break", 5) == 0) || (len == 8 && memcmp(word, "continue", 8) == 0)) {
+    struct block *loop = innermost_loop(c);
+    if (loop == NULL || *rest != '\0') {
+      return compile_error(c->lineno, len == 5 ? "\"break\" outside of a loop" : "\"continue\" outside of a loop");
+    }
+    return len == 5 ? emit_exit(s, loop) : emit(s, SCRIPT_JUMP, loop->top, 0) == -1 ? -1 : 0;
+  }
+  if (len == 3 && memcmp(word, "end", 3) == 0) {
+    if (b == NULL || *rest != '\0') {
+      return compile_error(c->lineno, b == NULL ? "\"end\" without a block" : "\"end\" takes no argument");
+    }
+    return compile_end(c);
+  }
+  return compile_cmdline(c, text, false);
+}
+
+int script_compile(struct script *s, char *data, size_t len) {
+  assert(s);
+  assert(data || len == 0);
+  memset(s, 0, sizeof(struct script));
+  struct compiler c = { s, NULL, 0, 0, 0 };
+  char *end = data + len;
+  int status = 0;
+  while (data < end && status == 0) {
+    ++c.lineno;
+    char *nl = memchr(data, '\n', end - data);
+    char *text = data;
+    if (nl != NULL) {
+      *nl = '\0';
+      data = nl + 1;
+    } else {
+      /* the last line has no '\n' and the buffer may not be followed by a '\0' */
+      text = s->last = strndup(data, end - data);
+      data = end;
+    }
+    status = text == NULL ? -1 : compile_line(&c, text);
+  }
+  if (status == -1) {
+    fprintf(stderr, "Memory allocation failure\n");
+  }
+  if (status == 0 && c.n_blocks > 0) {
+    status = compile_error(c.blocks[c.n_blocks - 1].lineno, "missing \"end\"");
+  }
+  free(c.blocks);
+  if (status != 0) {
+    script_destroy(s);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Appends bytes to the values of the slots of a line
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int buf_put(struct script_line *line, size_t *len, const char *text, size_t n) {
+  if (*len + n + 1 > line->buf_cap) {
+    size_t cap = line->buf_cap ? line->buf_cap : 256;
+    while (cap < *len + n + 1) {
+      cap *= 2;
+    }
+    char *buf = realloc(line->buf, cap);
+    if (buf == NULL) {
+      return -1;
+    }
+    line->buf = buf;
+    line->buf_cap = cap;
+  }
+  memcpy(line->buf + *len, text, n);
+  *len += n;
+  line->buf[*len] = '\0';
+  return 0;
+}
+
+/**
+ * Appends a segment to the slot being made
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int add_slot_segment(struct script_line *line, const char *text, size_t len, uint32_t kind) {
+  struct script_segment *segments =
+      grow(line->segments, &line->cap_segments, line->n_segments, sizeof(struct script_segment));
+  if (segments == NULL) {
+    return -1;
+  }
+  line->segments = segments;
+  segments[line->n_segments++] = (struct script_segment) { text, len, kind };
+  return 0;
+}
+
+/**
+ * Makes a word of a line parsed a slot if it holds variables, their kinds
+ * being the ones resolved when the line was compiled
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int add_slot(const struct script *s, struct script_line *line, char **where) {
+  const char *literal = *where;
+  const char *name;
+  size_t len;
+  size_t skip;
+  const char *p = next_variable(literal, &name, &len, &skip);
+  if (p == NULL) {
+    return 0;
+  }
+  struct script_slot *slots = grow(line->slots, &line->cap_slots, line->n_slots, sizeof(struct script_slot));
+  if (slots == NULL) {
+    return -1;
+  }
+  line->slots = slots;
+  const struct script_template *t = &s->templates[line->vars];
+  size_t first = line->n_segments;
+  for (; p != NULL; p = next_variable(literal, &name, &len, &skip)) {
+    uint32_t kind = len == 0 ? SCRIPT_STATUS : SCRIPT_ENV;
+    for (size_t i = t->first; i < t->first + t->n && kind == SCRIPT_ENV; ++i) {
+      const struct script_segment *var = &s->segments[i];
+      if (var->kind != SCRIPT_STATUS && var->len == len && memcmp(var->text, name, len) == 0) {
+        kind = var->kind;
+      }
+    }
+    if ((p > literal && add_slot_segment(line, literal, p - literal, SCRIPT_LITERAL) == -1)
+        || add_slot_segment(line, name, len, kind) == -1) {
+      return -1;
+    }
+    literal = p + 1 + skip;
+  }
+  if (*literal != '\0' && add_slot_segment(line, literal, strlen(literal), SCRIPT_LITERAL) == -1) {
+    return -1;
+  }
+  slots[line->n_slots++] = (struct script_slot) { where, first, line->n_segments - first, 0 };
+  return 0;
+}
+
+/**
+ * Parses a line into "li", then finds its slots, giving 0 on success,
+ * 2 if the line isn't valid, -1 if a memory allocation failure occurs ("li" is then reset)
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int parse_line(const struct script *s, struct script_line *line, struct line *li) {
+  /* the text is copied by the parser, so that a line which isn't valid is parsed again when it runs again */
+  uint64_t start = trace_begin();
+  uint64_t parse_start = stats_now();
+  int parsed = line_parse(li, line->text);
+  stats_observe(STATS_PARSE_NS, stats_now() - parse_start);
+  stats_add(STATS_LINES, 1);
+  trace_end("parse", start, NULL);
+  if (parsed == -1) {
+    stats_add(STATS_PARSE_ERRORS, 1);
+    line_reset(li);
+    return 2;
+  }
+  line->n_slots = 0;
+  line->n_segments = 0;
+  if (line->vars == UINT32_MAX) {
+    return 0;
+  }
+  int status = li->redirect_input ? add_slot(s, line, &li->file_input) : 0;
+  for (size_t i = 0; i < li->n_cmds && status == 0; ++i) {
+    for (size_t j = 0; j < li->cmds[i].n_args && status == 0; ++j) {
+      status = add_slot(s, line, &li->cmds[i].args[j]);
+    }
+  }
+  for (size_t i = 0; i < li->n_outputs && status == 0; ++i) {
+    status = add_slot(s, line, &li->file_outputs[i]);
+  }
+  if (status == -1) {
+    line_reset(li);
+  }
+  return status;
+}
+
+/**
+ * Gives the values of their variables to the slots of a line parsed
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int fill_slots(const struct script *s, struct script_line *line, struct line *li, int status) {
+  size_t len = 0;
+  for (size_t i = 0; i < line->n_slots; ++i) {
+    struct script_slot *slot = &line->slots[i];
+    slot->value = len;
+    for (size_t j = slot->first; j < slot->first + slot->n; ++j) {
+      const struct script_segment *seg = &line->segments[j];
+      const char *value = seg->text;
+      size_t value_len = seg->len;
+      char tmp[MAX_NAME];
+      if (seg->kind == SCRIPT_STATUS) {
+        value_len = snprintf(tmp, sizeof(tmp), "%d", status);
+        value = tmp;
+      } else if (seg->kind == SCRIPT_ENV) {
+        /* a name too long for the buffer can't be set : it is replaced by nothing */
+        value = NULL;
+        if (seg->len < MAX_NAME) {
+          memcpy(tmp, seg->text, seg->len);
+          tmp[seg->len] = '\0';
+          value = getenv(tmp);
+        }
+        value_len = value ? strlen(value) : 0;
+      } else if (seg->kind >= SCRIPT_VAR) {
+        const struct script_loop *loop = &s->loops[seg->kind - SCRIPT_VAR];
+        value = s->lines[loop->words].li->cmds[0].args[loop->next - 1];
+        value_len = strlen(value);
+      }
+      if (buf_put(line, &len, value, value_len) == -1) {
+        return -1;
+      }
+    }
+    /* the '\0' ending the value */
+    if (buf_put(line, &len, "", 1) == -1) {
+      return -1;
+    }
+  }
+  /* the buffer may have moved : the words point in it once it is complete */
+  for (size_t i = 0; i < line->n_slots; ++i) {
+    *line->slots[i].where = line->buf + line->slots[i].value;
+  }
+  if (li->n_outputs > 0) {
+    li->file_output = li->file_outputs[0];
+  }
+  return 0;
+}
+
+/**
+ * Gives a line ready to run : it is parsed the first time it runs, or each time if it
+ * runs once or holds a pattern, then its slots are filled, "status" being the value of "$?"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the line parsed, NULL if it can't run, "status" being then set
+ */
+static struct line *prepare_line(const struct script *s, struct script_line *line, struct line *li, int *status) {
+  struct line *parsed = line->once ? li : line->li;
+  int err = 0;
+  if (parsed == NULL) {
+    parsed = malloc(sizeof(struct line));
+    if (parsed == NULL) {
+      fprintf(stderr, "Memory allocation failure\n");
+      *status = 1;
+      return NULL;
+    }
+    line_init(parsed);
+    parsed->glob.cache = li->glob.cache;
+    err = parse_line(s, line, parsed);
+  } else if (line->once || line->reparse) {
+    if (!line->once) {
+      line_reset(parsed);
+    }
+    err = parse_line(s, line, parsed);
+  }
+  if (err == 0 && fill_slots(s, line, parsed, *status) == -1) {
+    err = -1;
+  }
+  if (err != 0) {
+    if (err == -1) {
+      fprintf(stderr, "Memory allocation failure\n");
+    }
+    if (parsed == li) {
+      line_reset(li);
+    } else {
+      line_destroy(parsed);
+      free(parsed);
+      parsed = NULL;
+    }
+    *status = err == -1 ? 1 : 2;
+  }
+  if (!line->once) {
+    line->li = parsed;
+  }
+  return err == 0 ? parsed : NULL;
+}
+
+/**
+ * Starts a loop : the words of a "for" are parsed like the arguments
+ * of a command, so that the patterns are expanded
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int start_loop(const struct script *s, struct script_loop *loop, struct line *li, int status) {
+  loop->next = 0;
+  if (loop->words == UINT32_MAX) {
+    return status;
+  }
+  loop->n = 0;
+  struct line *words = prepare_line(s, &s->lines[loop->words], li, &status);
+  if (words == NULL) {
+    return status;
+  }
+  if (words->n_cmds > 1 || words->redirect_input || words->n_outputs > 0 || words->background) {
+    fprintf(stderr, "for: the words can't hold a pipe, a redirection or a '&'\n");
+    return 2;
+  }
+  loop->n = words->n_cmds == 1 ? words->cmds[0].n_args : 0;
+  return status;
+}
+
+int script_run(struct script *s, struct line *li, int (*run_text)(struct line *li, char *text),
+               int (*run_line)(struct line *li, const char *text)) {
+  assert(s);
+  assert(li);
+  assert(run_text && run_line);
+  int status = 0;
+  size_t pc = 0;
+  while (pc < s->n_code && status != -1) {
+    const struct script_insn *insn = &s->code[pc++];
+    switch (insn->op) {
+      case SCRIPT_TEXT:
+        status = run_text(li, s->lines[insn->a].text);
+        break;
+      case SCRIPT_LINE: {
+        struct script_line *line = &s->lines[insn->a];
+        struct line *parsed = prepare_line(s, line, li, &status);
+        if (parsed != NULL) {
+          status = run_line(parsed, line->text);
+          if (parsed == li) {
+            line_reset(li);
+          }
+        }
+        break;
+      }
+      case SCRIPT_JUMP:
+        pc = insn->a;
+        break;
+      case SCRIPT_JUMP_FAILED:
+        /* like in sh, an "if" without branch taken or a "while" which ends is a success */
+        if (status != 0) {
+          status = 0;
+          pc = insn->a;
+        }
+        break;
+      case SCRIPT_LOOP:
+        status = start_loop(s, &s->loops[insn->a], li, status);
+        break;
+      case SCRIPT_NEXT: {
+        struct script_loop *loop = &s->loops[insn->a];
+        if (loop->next == loop->n) {
+          pc = insn->b;
+        } else {
+          ++loop->next;
+        }
+        break;
+      }
+    }
+  }
+  return status;
+}
+
+void script_destroy(struct script *s) {
+  assert(s);
+  for (size_t i = 0; i < s->n_lines; ++i) {
+    struct script_line *line = &s->lines[i];
+    if (line->li != NULL) {
+      line_destroy(line->li);
+      free(line->li);
+    }
+    free(line->slots);
+    free(line->segments);
+    free(line->buf);
+  }
+  free(s->code);
+  free(s->lines);
+  free(s->segments);
+  free(s->templates);
+  free(s->loops);
+  free(s->last);
+  memset(s, 0, sizeof(struct script));
+}
@@ -0,0 +1,167 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cmdline.h"
+
+/**
+ * Compiler and virtual machine of the scripts
+ *
+ * A script is compiled once into a small bytecode, then run by "script_run".
+ * Each line is a command line, or one of the control structures :
+ *
+ *   if cmdline / else if cmdline / else / end
+ *   while cmdline / end
+ *   for name in words / end
+ *   repeat N / end
+ *   break, continue
+ *
+ * A condition holds when its command line exits with status 0. In a command line
+ * (and in the words of a "for"), "$name" or "${name}" is replaced by the variable
+ * of the innermost "for" having this name, else by the environment variable, "$?"
+ * by the status of the last line. The line is parsed before its variables are
+ * replaced : a word holding variables is given their values as a whole, it is
+ * never split, expanded as a pattern nor parsed again, so that a value can't add
+ * a word, a redirection or a pipe to the line.
+ *
+ * The lines of the loops are parsed once, the first time they run, and their
+ * structure is kept with argv already built, the words holding variables being
+ * slots filled before each run : only the lines holding a pattern out of quotes
+ * are parsed each time, since their patterns may match other paths. The other lines
+ * are run once, so they are parsed in place when they run, or into the line given
+ * to "script_run" if they hold variables.
+ */
+
+/**
+ * Operations of the bytecode
+ */
+enum script_op {
+  SCRIPT_TEXT,         // parse and run the line "a" in place, it runs once and holds no variable
+  SCRIPT_LINE,         // fill the slots of the line "a", parsed when needed, then run it
+  SCRIPT_JUMP,         // go to the instruction "a"
+  SCRIPT_JUMP_FAILED,  // go to the instruction "a" if the last status isn't 0, which becomes 0
+  SCRIPT_LOOP,         // start the loop "a" : a "for" computes its words
+  SCRIPT_NEXT,         // next iteration of the loop "a", going to the instruction "b" when it is over
+};
+
+struct script_insn {
+  uint32_t op;
+  uint32_t a;
+  uint32_t b;
+};
+
+/**
+ * Part of a word : text, or a variable replaced by its value
+ */
+struct script_segment {
+  const char *text;   // the text, or the name of an environment variable
+  size_t len;
+  uint32_t kind;      // SCRIPT_LITERAL, SCRIPT_ENV, SCRIPT_STATUS, or SCRIPT_VAR plus the loop of the variable
+};
+
+#define SCRIPT_LITERAL 0
+#define SCRIPT_ENV 1
+#define SCRIPT_STATUS 2
+#define SCRIPT_VAR 3
+
+/**
+ * Variables of a line, resolved when it is compiled : the segments "first" to "first + n - 1"
+ */
+struct script_template {
+  size_t first;
+  size_t n;
+};
+
+/**
+ * Word of a line parsed which holds variables, made of the segments "first" to "first + n - 1" of the line
+ */
+struct script_slot {
+  char **where;       // the argument or the filename in the line parsed
+  size_t first;
+  size_t n;
+  size_t value;       // offset of its value in the buffer of the line
+};
+
+/**
+ * Line of a script, "text" pointing in the buffer compiled
+ */
+struct script_line {
+  char *text;
+  struct line *li;    // the line parsed, NULL before it runs ; a line run once is parsed into the one of "script_run"
+  uint32_t vars;      // template of the variables of the text, UINT32_MAX if it has none
+  bool once;          // runs once at most : it isn't kept parsed
+  bool reparse;       // holds a pattern : it is parsed each time it runs
+  struct script_slot *slots;
+  size_t n_slots;
+  size_t cap_slots;
+  struct script_segment *segments;  // segments of the slots
+  size_t n_segments;
+  size_t cap_segments;
+  char *buf;          // values of the slots
+  size_t buf_cap;
+};
+
+/**
+ * Loop of a script : a "for" goes through "words", a "repeat" counts up to "n"
+ */
+struct script_loop {
+  uint32_t words;     // line of the words of a "for", parsed when the loop starts, UINT32_MAX for a "repeat"
+  size_t n;
+  size_t next;
+};
+
+struct script {
+  struct script_insn *code;
+  size_t n_code;
+  size_t cap_code;
+  struct script_line *lines;
+  size_t n_lines;
+  size_t cap_lines;
+  struct script_segment *segments;
+  size_t n_segments;
+  size_t cap_segments;
+  struct script_template *templates;
+  size_t n_templates;
+  size_t cap_templates;
+  struct script_loop *loops;
+  size_t n_loops;
+  size_t cap_loops;
+  char *last;     // copy of the last line, when the buffer doesn't end with a '\n'
+};
+
+/**
+ * Compile a script
+ *
+ * The buffer is split into lines in place : it must outlive the script.
+ * An error of the control structures is printed with its line number.
+ *
+ * @param s pointer on the struct script to fill
+ * @param data the text of the script, which is modified
+ * @param len the size of the text, which may not end with a '\0'
+ * @return 0 on success, -1 if the script isn't valid or a memory allocation failure occurs
+ */
+int script_compile(struct script *s, char *data, size_t len);
+
+/**
+ * Run a compiled script
+ *
+ * @param s pointer on the struct script
+ * @param li line structure given to "run_text"
+ * @param run_text function parsing a text in place into "li", running it, then resetting "li"
+ * @param run_line function running a line already parsed, without modifying it, "text" being its text
+ * @return the status of the last line, -1 as soon as one of the functions returns -1
+ */
+int script_run(struct script *s, struct line *li, int (*run_text)(struct line *li, char *text),
+               int (*run_line)(struct line *li, const char *text));
+
+/**
+ * Free everything allocated by a struct script
+ *
+ * @param s pointer on the struct script
+ */
+void script_destroy(struct script *s);
+
+#endif
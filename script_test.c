@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include "script.h"
+#include "stats.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * Lines run by the script, each one written as its arguments separated by ','
+ * and its output redirections, the lines being separated by "; "
+ */
+static char runs[1024];
+
+/**
+ * Number of lines parsed by "run_text", the other ones being counted in the statistics
+ */
+static unsigned long long text_parses = 0;
+
+/**
+ * Number of conditions "[" run, the first three ones holding
+ */
+static int n_tests = 0;
+
+/**
+ * Records a line instead of running it, giving its status : 1 for "false", for a "["
+ * after the third one, 0 otherwise
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ */
+static int record(struct line *li, const char *text) {
+  (void) text;
+  strcat(runs, runs[0] ? "; " : "");
+  for (size_t i = 0; i < li->n_cmds; ++i) {
+    for (size_t j = 0; j < li->cmds[i].n_args; ++j) {
+      strcat(runs, i + j > 0 ? "," : "");
+      strcat(runs, li->cmds[i].args[j]);
+    }
+  }
+  for (size_t i = 0; i < li->n_outputs; ++i) {
+    strcat(runs, ">");
+    strcat(runs, li->file_outputs[i]);
+  }
+  const char *cmd = li->n_cmds > 0 ? li->cmds[0].args[0] : "";
+  if (strcmp(cmd, "[") == 0) {
+    return ++n_tests > 3;
+  }
+  return strcmp(cmd, "false") == 0;
+}
+
+/**
+ * Parses a line in place, then records it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ */
+static int record_text(struct line *li, char *text) {
+  ++text_parses;
+  if (line_parse_inplace(li, text) == -1) {
+    line_reset(li);
+    return 2;
+  }
+  int status = record(li, text);
+  line_reset(li);
+  return status;
+}
+
+/**
+ * Compiles and runs a script, then checks the lines run and the number of lines parsed
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file.
+ */
+static void try_script(const char *str, const char *expected, unsigned long long parses) {
+  printf("TEST SCRIPT %s", str);
+  char text[256];
+  strcpy(text, str);
+  runs[0] = '\0';
+  n_tests = 0;
+  text_parses = 0;
+  unsigned long long lines = stats.counters[STATS_LINES];
+
+  struct line li;
+  line_init(&li);
+  struct script script;
+  if (script_compile(&script, text, strlen(text)) == 0) {
+    script_run(&script, &li, record_text, record);
+    script_destroy(&script);
+  }
+  line_destroy(&li);
+
+  parses += lines;
+  if (strcmp(runs, expected) != 0) {
+    printf("UNEXPECTED RUNS \"%s\" INSTEAD OF \"%s\"\n", runs, expected);
+  }
+  else if (stats.counters[STATS_LINES] + text_parses != parses) {
+    printf("UNEXPECTED NUMBER OF LINES PARSED %llu INSTEAD OF %llu\n",
+           (unsigned long long) (stats.counters[STATS_LINES] + text_parses - lines), parses - lines);
+  }
+  else {
+    printf("TEST OK!\n");
+  }
+}
+
+int main() {
+  setenv("X", "a > b", 1);
+
+  /* a condition "[ ... ]" isn't a pattern : the lines of the loop are parsed once */
+  try_script("while [ -n $X ]\ntrue\nend\n", "[,-n,a > b,]; true; [,-n,a > b,]; true; [,-n,a > b,]; true; [,-n,a > b,]", 2);
+  try_script("repeat 3\necho \"*.c\" [ab\nend\n", "echo,*.c,[ab; echo,*.c,[ab; echo,*.c,[ab", 1);
+  try_script("repeat 3\necho $X*\nend\n", "echo,a > b*; echo,a > b*; echo,a > b*", 1);
+
+  /* a pattern may match other paths each time */
+  try_script("repeat 3\necho *.none\nend\n", "echo,*.none; echo,*.none; echo,*.none", 3);
+
+  /* a value is a whole word, never parsed again */
+  try_script("for w in one $X\necho $w > ${w}.txt\nend\n", "echo,one>one.txt; echo,a > b>a > b.txt", 2);
+  try_script("echo $X | cat\n", "echo,a > b,cat", 1);
+  try_script("false\necho $? \"${X}\"\n", "false; echo,1,a > b", 2);
+
+  return 0;
+}
@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include "spawn.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <spawn.h>
+#include <unistd.h>
+
+#define TEE_CHUNK (1 << 16)
+#define RW_BUF_SIZE (1 << 16)
+
+extern char **environ;
+
+pid_t spawn_cmd(struct path_hash *hash, char **argv, int input, int output, const int *to_close, size_t n_close, const sigset_t *mask) {
+  assert(argv);
+  assert(argv[0]);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+
+  /* redirecting to the required streams, then closing the originals */
+  if (input != 0) {
+    posix_spawn_file_actions_adddup2(&actions, input, 0);
+  }
+  if (output != 1) {
+    posix_spawn_file_actions_adddup2(&actions, output, 1);
+  }
+  if (input > 1) {
+    posix_spawn_file_actions_addclose(&actions, input);
+  }
+  if (output > 1 && output != input) {
+    posix_spawn_file_actions_addclose(&actions, output);
+  }
+  for (size_t i = 0; i < n_close; ++i) {
+    int fd = to_close[i];
+    if (fd > 1 && fd != input && fd != output) {
+      posix_spawn_file_actions_addclose(&actions, fd);
+    }
+  }
+
+  /* signals ignored by the shell get back their default action */
+  short flags = POSIX_SPAWN_SETSIGDEF;
+  sigset_t dfl;
+  sigemptyset(&dfl);
+  sigaddset(&dfl, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attr, &dfl);
+  if (mask) {
+    flags |= POSIX_SPAWN_SETSIGMASK;
+    posix_spawnattr_setsigmask(&attr, mask);
+  }
+  posix_spawnattr_setflags(&attr, flags);
+
+  pid_t pid;
+  int err;
+  if (hash == NULL) {
+    uint64_t start = trace_begin();
+    err = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+    trace_end("exec", start, argv[0]);
+  } else {
+    uint64_t start = trace_begin();
+    const char *path = path_hash_lookup(hash, argv[0]);
+    trace_end("lookup", start, argv[0]);
+    start = trace_begin();
+    err = path ? posix_spawn(&pid, path, &actions, &attr, argv, environ) : ENOENT;
+    trace_end("exec", start, argv[0]);
+    if (path && (err == ENOENT || err == EACCES) && path != argv[0]) {
+      /* the cached command has been moved or removed */
+      path = path_hash_refresh(hash, argv[0]);
+      err = path ? posix_spawn(&pid, path, &actions, &attr, argv, environ) : ENOENT;
+    }
+    if (path == NULL) {
+      posix_spawnattr_destroy(&attr);
+      posix_spawn_file_actions_destroy(&actions);
+      fprintf(stderr, "%s: command not found\n", argv[0]);
+      stats_add(STATS_EXEC_FAILURES, 1);
+      return -1;
+    }
+  }
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (err != 0) {
+    fprintf(stderr, "%s: %s\n", argv[0], strerror(err));
+    stats_add(STATS_EXEC_FAILURES, 1);
+    return -1;
+  }
+  stats_add(STATS_EXECS, 1);
+  return pid;
+}
+
+/**
+ * Capacity of the pipes created by spawn_pipes, 0 for the default one
+ */
+static int pipe_size = 0;
+
+/**
+ * Moves exactly "len" bytes from the pipe "input" to the file "output"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int spawn_drain(int input, int output, size_t len) {
+  bool spliced = true;
+  while (len > 0) {
+    ssize_t n;
+    if (spliced) {
+      n = splice(input, NULL, output, NULL, len, SPLICE_F_MOVE);
+      if (n == -1 && errno == EINVAL) {
+        spliced = false;
+        continue;
+      }
+    } else {
+      char buf[RW_BUF_SIZE];
+      n = read(input, buf, len < sizeof(buf) ? len : sizeof(buf));
+      for (ssize_t done = 0; done < n;) {
+        ssize_t w = write(output, buf + done, n - done);
+        if (w == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return -1;
+        }
+        done += w;
+      }
+    }
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    len -= n;
+  }
+  return 0;
+}
+
+int spawn_tee(int input, const int *outputs, size_t n_outputs) {
+  assert(outputs);
+  assert(n_outputs > 1);
+
+  int scratch[2];
+  if (pipe2(scratch, O_CLOEXEC) == -1) {
+    perror("pipe");
+    return -1;
+  }
+  int ret = 0;
+  for (;;) {
+    /* waiting for bytes, which are duplicated without being consumed */
+    ssize_t len = tee(input, scratch[1], TEE_CHUNK, 0);
+    if (len == -1 && errno == EINTR) {
+      continue;
+    }
+    if (len <= 0) {
+      if (len == -1) {
+        perror("tee");
+        ret = -1;
+      }
+      break;
+    }
+    /* the same "len" bytes, still at the front of the pipe, for each file but the last */
+    for (size_t i = 0; i + 1 < n_outputs && ret == 0; ++i) {
+      ssize_t n = i == 0 ? len : tee(input, scratch[1], len, 0);
+      if (n >= 0 && n != len) {
+        errno = EIO;
+      }
+      if (n != len || spawn_drain(scratch[0], outputs[i], len) == -1) {
+        perror("tee");
+        ret = -1;
+      }
+    }
+    if (ret == 0 && spawn_drain(input, outputs[n_outputs - 1], len) == -1) {
+      perror("tee");
+      ret = -1;
+    }
+    if (ret == -1) {
+      break;
+    }
+  }
+  close(scratch[0]);
+  close(scratch[1]);
+  return ret;
+}
+
+size_t spawn_set_pipe_size(size_t size) {
+  size_t max = 1 << 20;
+  FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+  if (f != NULL) {
+    if (fscanf(f, "%zu", &max) != 1) {
+      max = 1 << 20;
+    }
+    fclose(f);
+  }
+  if (size > max) {
+    size = max;
+  }
+  pipe_size = size;
+  return size;
+}
+
+int spawn_pipes(struct stage *stages, size_t n_cmds, int input, int output) {
+  assert(stages);
+  assert(n_cmds > 0);
+
+  stages[0].input = input;
+  for (size_t i = 0; i + 1 < n_cmds; ++i) {
+    int tube[2];
+    if (pipe2(tube, O_CLOEXEC) == -1) {
+      perror("pipe");
+      for (size_t j = 0; j < i; ++j) {
+        spawn_stage_close(&stages[j], input, output);
+      }
+      if (stages[i].input != input) {
+        close(stages[i].input);
+      }
+      return -1;
+    }
+    if (pipe_size > 0) {
+      /* on failure (e.g. the per-user limit is reached), the pipe keeps its default capacity */
+      fcntl(tube[1], F_SETPIPE_SZ, pipe_size);
+    }
+    stages[i].output = tube[1];
+    stages[i + 1].input = tube[0];
+  }
+  stages[n_cmds - 1].output = output;
+  return 0;
+}
+
+void spawn_stage_close(const struct stage *st, int input, int output) {
+  assert(st);
+
+  if (st->input != input) {
+    close(st->input);
+  }
+  if (st->output != output) {
+    close(st->output);
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <stddef.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "pathhash.h"
+
+/**
+ * Launches a program without duplicating the shell
+ *
+ * The child is created with posix_spawn (vfork-like : the memory of the shell isn't copied)
+ * and its standard streams are redirected by file actions.
+ * The program is searched in PATH through the command hash table, so that the child is given
+ * its absolute path; if that path can't be run anymore, PATH is searched again once.
+ *
+ * @param hash command hash table, NULL to let posix_spawnp search PATH every time
+ * @param argv arguments of the program, terminated by a NULL pointer
+ * @param input file descriptor to use as standard input
+ * @param output file descriptor to use as standard output
+ * @param to_close file descriptors of the shell to close in the child
+ * @param n_close number of file descriptors in "to_close"
+ * @param mask signal mask of the child, NULL to inherit the one of the shell
+ * @return the pid of the child, -1 if it couldn't be launched (the reason is printed)
+ */
+pid_t spawn_cmd(struct path_hash *hash, char **argv, int input, int output, const int *to_close, size_t n_close, const sigset_t *mask);
+
+/**
+ * Standard streams of a command of a pipeline
+ */
+struct stage {
+  int input;
+  int output;
+};
+
+/**
+ * Sets the capacity of the pipes created by "spawn_pipes"
+ *
+ * Larger pipes let the stages of a high-volume pipeline run longer between
+ * two context switches. The size is capped at /proc/sys/fs/pipe-max-size.
+ *
+ * @param size capacity in bytes, 0 to keep the default capacity of the kernel
+ * @return the capacity that will be asked for, after capping
+ */
+size_t spawn_set_pipe_size(size_t size);
+
+/**
+ * Creates the pipes between the commands of a pipeline
+ *
+ * The pipes are close-on-exec : a child only keeps the ends it is given as standard streams.
+ * Their capacity is the one set by "spawn_set_pipe_size", when the kernel allows it.
+ * The first command reads "input" and the last one writes "output".
+ *
+ * @param stages array of "n_cmds" stages to fill
+ * @param n_cmds number of commands
+ * @param input file descriptor to use as standard input of the first command
+ * @param output file descriptor to use as standard output of the last command
+ * @return 0 on success, -1 on failure (the reason is printed and no pipe is left open)
+ */
+int spawn_pipes(struct stage *stages, size_t n_cmds, int input, int output);
+
+/**
+ * Closes in the shell the ends of pipes of a stage, once handed to its child
+ *
+ * @param st the stage
+ * @param input file descriptor given to "spawn_pipes", left open
+ * @param output file descriptor given to "spawn_pipes", left open
+ */
+void spawn_stage_close(const struct stage *st, int input, int output);
+
+/**
+ * Copies everything written in a pipe to several files (at least 2), until the pipe is closed
+ *
+ * The bytes stay in the kernel : they are duplicated with tee into a scratch pipe,
+ * then spliced from it to each file but the last, the last one receiving the original bytes.
+ * Files that can't be spliced to (e.g. opened with O_APPEND) are written with read and write.
+ *
+ * @param input read end of the pipe
+ * @param outputs files to write
+ * @param n_outputs number of files
+ * @return 0 on success, -1 on failure (the reason is printed)
+ */
+int spawn_tee(int input, const int *outputs, size_t n_outputs);
+
+#endif
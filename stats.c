@@ -0,0 +1,72 @@
+#define _GNU_SOURCE
+#include "stats.h"
+
+#include <assert.h>
+
+struct stats stats;
+
+/**
+ * Names of the counters and of the histograms, in the order of their enums
+ */
+static const char *const counter_names[STATS_N_COUNTERS] = {
+  "fish_lines_parsed_total", "fish_parse_errors_total", "fish_forks_total", "fish_execs_total",
+  "fish_exec_failures_total", "fish_jobs_started_total", "fish_jobs_reaped_total",
+};
+static const char *const histogram_names[STATS_N_HISTOGRAMS] = {
+  "fish_parse_ns", "fish_spawn_ns", "fish_foreground_ns",
+};
+
+void stats_jobs(size_t n) {
+  atomic_store_explicit(&stats.jobs, n, memory_order_relaxed);
+  uint64_t peak = atomic_load_explicit(&stats.jobs_peak, memory_order_relaxed);
+  while (n > peak && !atomic_compare_exchange_weak_explicit(&stats.jobs_peak, &peak, n, memory_order_relaxed,
+                                                            memory_order_relaxed)) {
+  }
+}
+
+void stats_reset(void) {
+  for (int c = 0; c < STATS_N_COUNTERS; ++c) {
+    atomic_store_explicit(&stats.counters[c], 0, memory_order_relaxed);
+  }
+  for (int h = 0; h < STATS_N_HISTOGRAMS; ++h) {
+    for (int b = 0; b < STATS_BUCKETS; ++b) {
+      atomic_store_explicit(&stats.buckets[h][b], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&stats.sums[h], 0, memory_order_relaxed);
+  }
+  atomic_store_explicit(&stats.jobs_peak, atomic_load_explicit(&stats.jobs, memory_order_relaxed),
+                        memory_order_relaxed);
+}
+
+void stats_print(FILE *out) {
+  assert(out);
+  for (int c = 0; c < STATS_N_COUNTERS; ++c) {
+    fprintf(out, "%s %llu\n", counter_names[c],
+            (unsigned long long) atomic_load_explicit(&stats.counters[c], memory_order_relaxed));
+  }
+  fprintf(out, "fish_jobs %llu\n", (unsigned long long) atomic_load_explicit(&stats.jobs, memory_order_relaxed));
+  fprintf(out, "fish_jobs_peak %llu\n",
+          (unsigned long long) atomic_load_explicit(&stats.jobs_peak, memory_order_relaxed));
+  for (int h = 0; h < STATS_N_HISTOGRAMS; ++h) {
+    uint64_t counts[STATS_BUCKETS];
+    int last = -1;
+    for (int b = 0; b < STATS_BUCKETS; ++b) {
+      counts[b] = atomic_load_explicit(&stats.buckets[h][b], memory_order_relaxed);
+      last = counts[b] ? b : last;
+    }
+    /* the bucket b holds the durations lower than 2^b */
+    uint64_t total = 0;
+    for (int b = 0; b <= last && b < STATS_BUCKETS - 1; ++b) {
+      total += counts[b];
+      fprintf(out, "%s_bucket{le=\"%llu\"} %llu\n", histogram_names[h],
+              b == 0 ? 0ULL : (unsigned long long) ((UINT64_C(1) << b) - 1), (unsigned long long) total);
+    }
+    if (last == STATS_BUCKETS - 1) {
+      total += counts[last];
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", histogram_names[h], (unsigned long long) total);
+    fprintf(out, "%s_sum %llu\n", histogram_names[h],
+            (unsigned long long) atomic_load_explicit(&stats.sums[h], memory_order_relaxed));
+    fprintf(out, "%s_count %llu\n", histogram_names[h], (unsigned long long) total);
+  }
+}
@@ -0,0 +1,116 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define STATS_BUCKETS 64
+
+/**
+ * Counters of the runtime statistics
+ */
+enum stats_counter {
+  STATS_LINES,          // command lines parsed
+  STATS_PARSE_ERRORS,   // command lines which weren't valid
+  STATS_FORKS,          // processes forked by FiSH, without exec
+  STATS_EXECS,          // commands executed
+  STATS_EXEC_FAILURES,  // commands which couldn't be executed
+  STATS_JOBS_STARTED,   // processes started in background
+  STATS_JOBS_REAPED,    // background processes reaped
+  STATS_N_COUNTERS
+};
+
+/**
+ * Histograms of durations, in nanoseconds
+ */
+enum stats_histogram {
+  STATS_PARSE_NS,       // parsing of a command line
+  STATS_SPAWN_NS,       // start of a process
+  STATS_FOREGROUND_NS,  // foreground line, from its first process started to its last one reaped
+  STATS_N_HISTOGRAMS
+};
+
+/**
+ * Runtime statistics of FiSH, always collected
+ *
+ * Every value is updated with a relaxed atomic operation, lock-free : the
+ * statistics may be updated from a signal handler, e.g. when the jobs are reaped.
+ * The bucket i of a histogram counts the durations d with 2^(i-1) <= d < 2^i
+ * nanoseconds, the bucket 0 the null ones.
+ */
+struct stats {
+  _Atomic uint64_t counters[STATS_N_COUNTERS];
+  _Atomic uint64_t jobs;        // background processes running
+  _Atomic uint64_t jobs_peak;   // maximum of "jobs"
+  _Atomic uint64_t buckets[STATS_N_HISTOGRAMS][STATS_BUCKETS];
+  _Atomic uint64_t sums[STATS_N_HISTOGRAMS];
+};
+
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_LONG_LOCK_FREE != 2
+#error "the statistics need lock-free 64-bit atomics"
+#endif
+
+/**
+ * The statistics of FiSH
+ */
+extern struct stats stats;
+
+/**
+ * Give the current time, for the histograms
+ *
+ * @return the time in nanoseconds, CLOCK_MONOTONIC
+ */
+static inline uint64_t stats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Add to a counter
+ *
+ * @param c the counter
+ * @param n the value added
+ */
+static inline void stats_add(enum stats_counter c, uint64_t n) {
+  atomic_fetch_add_explicit(&stats.counters[c], n, memory_order_relaxed);
+}
+
+/**
+ * Count a duration in a histogram
+ *
+ * @param h the histogram
+ * @param ns the duration in nanoseconds
+ */
+static inline void stats_observe(enum stats_histogram h, uint64_t ns) {
+  unsigned bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+  atomic_fetch_add_explicit(&stats.buckets[h][bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1], 1,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.sums[h], ns, memory_order_relaxed);
+}
+
+/**
+ * Set the number of background processes running, keeping its maximum
+ *
+ * @param n the number of background processes
+ */
+void stats_jobs(size_t n);
+
+/**
+ * Set all the statistics to 0, the peak of the jobs becoming the number running
+ */
+void stats_reset(void);
+
+/**
+ * Print the statistics in the text format of Prometheus : one "name value" line
+ * per counter, and cumulated buckets "name_bucket{le="bound"} count" up to the
+ * last one not empty, then "name_sum" and "name_count", for each histogram
+ *
+ * @param out where to print them
+ */
+void stats_print(FILE *out);
+
+#endif
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+#include "timing.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct timing *timing_start(size_t n_stages) {
+  struct timing *t = malloc(sizeof(struct timing) + n_stages * sizeof(struct timing_stage));
+  if (t == NULL) {
+    return NULL;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t->start);
+  t->pending = 0;
+  t->n_stages = n_stages;
+  memset(t->stages, 0, n_stages * sizeof(struct timing_stage));
+  return t;
+}
+
+/**
+ * Gives the stage of a timing at a position of the line, named after its command
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static struct timing_stage *timing_add(struct timing *t, size_t index, const char *name, pid_t pid) {
+  assert(index < t->n_stages);
+  struct timing_stage *stage = &t->stages[index];
+  memset(stage, 0, sizeof(struct timing_stage));
+  snprintf(stage->name, TIMING_NAME, "%s", name);
+  stage->pid = pid;
+  return stage;
+}
+
+void timing_spawned(struct timing *t, size_t index, const char *name, pid_t pid) {
+  assert(t);
+  assert(name);
+  assert(pid > 0);
+  timing_add(t, index, name, pid);
+  ++t->pending;
+}
+
+/**
+ * Gives the difference of two times
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static struct timeval tv_sub(struct timeval a, struct timeval b) {
+  struct timeval d = { a.tv_sec - b.tv_sec, a.tv_usec - b.tv_usec };
+  if (d.tv_usec < 0) {
+    --d.tv_sec;
+    d.tv_usec += 1000000;
+  }
+  return d;
+}
+
+void timing_ran(struct timing *t, size_t index, const char *name, const struct rusage *before,
+                const struct rusage *after) {
+  assert(t);
+  assert(name);
+  assert(before && after);
+  struct timing_stage *stage = timing_add(t, index, name, 0);
+  stage->done = true;
+  clock_gettime(CLOCK_MONOTONIC, &stage->end);
+  stage->usage.ru_utime = tv_sub(after->ru_utime, before->ru_utime);
+  stage->usage.ru_stime = tv_sub(after->ru_stime, before->ru_stime);
+  /* the peak of FiSH itself : it can't be told apart from the one of the stage */
+  stage->usage.ru_maxrss = after->ru_maxrss;
+  stage->usage.ru_nvcsw = after->ru_nvcsw - before->ru_nvcsw;
+  stage->usage.ru_nivcsw = after->ru_nivcsw - before->ru_nivcsw;
+  stage->usage.ru_minflt = after->ru_minflt - before->ru_minflt;
+  stage->usage.ru_majflt = after->ru_majflt - before->ru_majflt;
+}
+
+bool timing_reaped(struct timing *t, pid_t pid, const struct rusage *usage) {
+  assert(t);
+  assert(usage);
+  for (size_t i = 0; i < t->n_stages; ++i) {
+    struct timing_stage *stage = &t->stages[i];
+    if (stage->pid == pid && !stage->done) {
+      clock_gettime(CLOCK_MONOTONIC, &stage->end);
+      stage->usage = *usage;
+      stage->done = true;
+      --t->pending;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Gives the number of seconds between two times
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static double ts_diff(struct timespec a, struct timespec b) {
+  return (a.tv_sec - b.tv_sec) + (a.tv_nsec - b.tv_nsec) / 1e9;
+}
+
+/**
+ * Prints a line of the table of the resources
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void print_usage(FILE *out, const char *name, double real, const struct rusage *u) {
+  fprintf(out, "%-16s %9.3f %9.3f %9.3f %10ld %7ld %7ld %8ld %7ld\n", name, real,
+          u->ru_utime.tv_sec + u->ru_utime.tv_usec / 1e6, u->ru_stime.tv_sec + u->ru_stime.tv_usec / 1e6,
+          u->ru_maxrss, u->ru_nvcsw, u->ru_nivcsw, u->ru_minflt, u->ru_majflt);
+}
+
+void timing_print(const struct timing *t, FILE *out) {
+  assert(t);
+  assert(out);
+  fprintf(out, "%-16s %9s %9s %9s %10s %7s %7s %8s %7s\n", "command", "real(s)", "user(s)", "sys(s)",
+          "maxrss(KB)", "vcsw", "ivcsw", "minflt", "majflt");
+  struct rusage total;
+  memset(&total, 0, sizeof(total));
+  struct timespec end = t->start;
+  for (size_t i = 0; i < t->n_stages; ++i) {
+    const struct timing_stage *stage = &t->stages[i];
+    if (!stage->done) {
+      continue;
+    }
+    const struct rusage *u = &stage->usage;
+    print_usage(out, stage->name, ts_diff(stage->end, t->start), u);
+    total.ru_utime.tv_sec += u->ru_utime.tv_sec;
+    total.ru_utime.tv_usec += u->ru_utime.tv_usec;
+    total.ru_stime.tv_sec += u->ru_stime.tv_sec;
+    total.ru_stime.tv_usec += u->ru_stime.tv_usec;
+    total.ru_maxrss = u->ru_maxrss > total.ru_maxrss ? u->ru_maxrss : total.ru_maxrss;
+    total.ru_nvcsw += u->ru_nvcsw;
+    total.ru_nivcsw += u->ru_nivcsw;
+    total.ru_minflt += u->ru_minflt;
+    total.ru_majflt += u->ru_majflt;
+    if (ts_diff(stage->end, end) > 0) {
+      end = stage->end;
+    }
+  }
+  /* the stages run at the same time : the real time of the line is the one of the last */
+  print_usage(out, "total", ts_diff(end, t->start), &total);
+}
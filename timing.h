@@ -0,0 +1,83 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#define TIMING_NAME 32
+
+/**
+ * Resources used by a stage of a timed command line
+ */
+struct timing_stage {
+  char name[TIMING_NAME];   // the command, possibly truncated
+  pid_t pid;                // the process, 0 if the stage runs in FiSH
+  bool done;                // true once the stage terminated
+  struct timespec end;      // when it terminated
+  struct rusage usage;      // given by wait4, or the difference of getrusage in FiSH
+};
+
+/**
+ * Resources used by the stages of a command line prefixed by "time"
+ */
+struct timing {
+  struct timespec start;
+  size_t pending;                 // processes not reaped yet
+  size_t n_stages;                // stages of the line, in pipeline order, the unused ones having no name
+  struct timing_stage stages[];
+};
+
+/**
+ * Allocate a struct timing, the line starting now
+ *
+ * @param n_stages number of stages of the line, all unused until they are added
+ * @return the struct timing to free, NULL if a memory allocation failure occurs
+ */
+struct timing *timing_start(size_t n_stages);
+
+/**
+ * Add a stage run by a process to a timing
+ *
+ * @param t pointer on the struct timing
+ * @param index the position of the stage in the line
+ * @param name the command of the stage
+ * @param pid the process running it
+ */
+void timing_spawned(struct timing *t, size_t index, const char *name, pid_t pid);
+
+/**
+ * Add a stage run in FiSH to a timing, once it is over
+ *
+ * @param t pointer on the struct timing
+ * @param index the position of the stage in the line
+ * @param name the command of the stage
+ * @param before resources used by FiSH (RUSAGE_SELF) when the stage started
+ * @param after resources used by FiSH when it ended
+ */
+void timing_ran(struct timing *t, size_t index, const char *name, const struct rusage *before, const struct rusage *after);
+
+/**
+ * Record the end of a process, if it runs a stage of the timing
+ *
+ * @param t pointer on the struct timing
+ * @param pid the process reaped
+ * @param usage the resources it used, given by wait4
+ * @return true if the process runs a stage of the timing
+ */
+bool timing_reaped(struct timing *t, pid_t pid, const struct rusage *usage);
+
+/**
+ * Print the wall time, the user and system CPU time, the maximal resident set size,
+ * the context switches and the page faults of each stage, in pipeline order, then
+ * of the whole line
+ *
+ * @param t pointer on the struct timing
+ * @param out where to print them
+ */
+void timing_print(const struct timing *t, FILE *out);
+
+#endif
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DUMP_BUF (1 << 16)
+
+bool trace_enabled = false;
+
+/**
+ * The ring buffer of the spans, "head" being the number of spans recorded so far
+ */
+static struct trace_event *ring = NULL;
+static _Atomic uint64_t head = 0;
+
+/**
+ * The trace file and the pid written in the events
+ */
+static char *trace_path = NULL;
+static pid_t trace_pid;
+
+/**
+ * True while the trace is being written, so that a SIGUSR1 received meanwhile is ignored
+ */
+static atomic_flag dumping = ATOMIC_FLAG_INIT;
+
+/**
+ * Buffer of the JSON text written by "trace_dump"
+ */
+struct dump {
+  int fd;
+  size_t len;
+  bool failed;
+  char buf[DUMP_BUF];
+};
+
+/**
+ * Writes the text buffered, keeping the failure of "write"
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dump_flush(struct dump *d) {
+  for (size_t done = 0; done < d->len && !d->failed;) {
+    ssize_t n = write(d->fd, d->buf + done, d->len - done);
+    if (n == -1 && errno != EINTR) {
+      d->failed = true;
+    }
+    done += n > 0 ? n : 0;
+  }
+  d->len = 0;
+}
+
+/**
+ * Appends bytes to the JSON text, escaping them inside a string if "escape" is true
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dump_put(struct dump *d, const char *s, size_t n, bool escape) {
+  for (size_t i = 0; i < n; ++i) {
+    if (d->len + 6 > DUMP_BUF) {
+      dump_flush(d);
+    }
+    unsigned char c = s[i];
+    if (escape && (c == '"' || c == '\\')) {
+      d->buf[d->len++] = '\\';
+    } else if (escape && c < 0x20) {
+      static const char hex[] = "0123456789abcdef";
+      memcpy(d->buf + d->len, "\\u00", 4);
+      d->buf[d->len + 4] = hex[c >> 4];
+      d->buf[d->len + 5] = hex[c & 15];
+      d->len += 6;
+      continue;
+    }
+    d->buf[d->len++] = c;
+  }
+}
+
+/**
+ * Appends a string to the JSON text, as is
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dump_str(struct dump *d, const char *s) {
+  dump_put(d, s, strlen(s), false);
+}
+
+/**
+ * Appends a number of nanoseconds to the JSON text, in microseconds (the unit of
+ * the Chrome traces) with 3 decimals, without snprintf which isn't async-signal-safe
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dump_us(struct dump *d, uint64_t ns) {
+  char digits[32];
+  size_t n = 0;
+  for (int i = 0; i < 3; ++i) {
+    digits[n++] = '0' + ns % 10;
+    ns /= 10;
+  }
+  digits[n++] = '.';
+  do {
+    digits[n++] = '0' + ns % 10;
+    ns /= 10;
+  } while (ns > 0);
+  while (n > 0) {
+    dump_put(d, &digits[--n], 1, false);
+  }
+}
+
+/**
+ * Appends an integer to the JSON text
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void dump_int(struct dump *d, uint64_t v) {
+  char digits[24];
+  size_t n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v > 0);
+  while (n > 0) {
+    dump_put(d, &digits[--n], 1, false);
+  }
+}
+
+int trace_dump(void) {
+  if (ring == NULL || atomic_flag_test_and_set(&dumping)) {
+    return ring == NULL ? 0 : -1;
+  }
+  int saved_errno = errno;
+  static struct dump d;
+  d.fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  d.len = 0;
+  d.failed = d.fd == -1;
+  dump_str(&d, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":");
+  dump_int(&d, trace_pid);
+  dump_str(&d, ",\"args\":{\"name\":\"fish\"}}");
+
+  /* an event is copied, then kept if it wasn't overwritten meanwhile */
+  uint64_t end = atomic_load_explicit(&head, memory_order_acquire);
+  for (uint64_t i = end > TRACE_EVENTS ? end - TRACE_EVENTS : 0; i < end && !d.failed; ++i) {
+    struct trace_event *e = &ring[i & (TRACE_EVENTS - 1)];
+    if (atomic_load_explicit(&e->seq, memory_order_acquire) != i + 1) {
+      continue;
+    }
+    const char *name = e->name;
+    uint64_t start = e->start;
+    uint64_t duration = e->duration;
+    char detail[TRACE_DETAIL];
+    memcpy(detail, e->detail, TRACE_DETAIL);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&e->seq, memory_order_relaxed) != i + 1) {
+      continue;
+    }
+    dump_str(&d, ",\n{\"name\":\"");
+    dump_str(&d, name);
+    dump_str(&d, "\",\"cat\":\"fish\",\"ph\":\"X\",\"ts\":");
+    dump_us(&d, start);
+    dump_str(&d, ",\"dur\":");
+    dump_us(&d, duration);
+    dump_str(&d, ",\"pid\":");
+    dump_int(&d, trace_pid);
+    dump_str(&d, ",\"tid\":");
+    dump_int(&d, trace_pid);
+    if (detail[0] != '\0') {
+      dump_str(&d, ",\"args\":{\"detail\":\"");
+      dump_put(&d, detail, strnlen(detail, TRACE_DETAIL), true);
+      dump_str(&d, "\"}");
+    }
+    dump_str(&d, "}");
+  }
+  dump_str(&d, "\n]}\n");
+  dump_flush(&d);
+  if (d.fd != -1) {
+    close(d.fd);
+  }
+  atomic_flag_clear(&dumping);
+  errno = saved_errno;
+  return d.failed ? -1 : 0;
+}
+
+/**
+ * Writes the trace when SIGUSR1 is received
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void trace_signal(int signal) {
+  (void) signal;
+  trace_dump();
+}
+
+int trace_init(const char *path) {
+  trace_path = strdup(path);
+  ring = calloc(TRACE_EVENTS, sizeof(struct trace_event));
+  if (trace_path == NULL || ring == NULL) {
+    free(trace_path);
+    free(ring);
+    ring = NULL;
+    return -1;
+  }
+  trace_pid = getpid();
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = trace_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, NULL);
+  trace_enabled = true;
+  return 0;
+}
+
+void trace_record(const char *name, uint64_t start, const char *detail) {
+  uint64_t end = trace_begin();
+  uint64_t i = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+  struct trace_event *e = &ring[i & (TRACE_EVENTS - 1)];
+  /* the event is marked as being written before it changes, then as written */
+  atomic_store_explicit(&e->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  e->name = name;
+  e->start = start;
+  e->duration = end - start;
+  if (detail != NULL) {
+    strncpy(e->detail, detail, TRACE_DETAIL - 1);
+    e->detail[TRACE_DETAIL - 1] = '\0';
+  } else {
+    e->detail[0] = '\0';
+  }
+  atomic_store_explicit(&e->seq, i + 1, memory_order_release);
+}
@@ -0,0 +1,82 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_EVENTS (1 << 16)  // capacity of the ring buffer, a power of 2
+#define TRACE_DETAIL 48
+
+/**
+ * Span recorded by the tracing
+ */
+struct trace_event {
+  _Atomic uint64_t seq;        // number of the event plus 1 once written, 0 while it is written
+  const char *name;            // the phase, a string literal
+  uint64_t start;              // in nanoseconds, CLOCK_MONOTONIC
+  uint64_t duration;
+  char detail[TRACE_DETAIL];   // e.g. the command or the file, possibly truncated
+};
+
+/**
+ * True once "trace_init" succeeded : every trace function does nothing until then
+ */
+extern bool trace_enabled;
+
+/**
+ * Start the tracing : the spans are kept in a ring buffer of TRACE_EVENTS events,
+ * the oldest ones being overwritten, and written to a file as a Chrome trace
+ * (JSON, read by chrome://tracing or Perfetto) by "trace_dump" or on SIGUSR1
+ *
+ * @param path the file of the trace
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+int trace_init(const char *path);
+
+/**
+ * Record a span ending now, without lock : it may be called from a signal handler
+ *
+ * @param name the phase, a string literal
+ * @param start when the span started, given by "trace_begin"
+ * @param detail what the span is about, NULL if nothing
+ */
+void trace_record(const char *name, uint64_t start, const char *detail);
+
+/**
+ * Write the spans of the ring buffer to the trace file, using only
+ * async-signal-safe functions
+ *
+ * @return 0 on success, -1 if the file couldn't be written
+ */
+int trace_dump(void);
+
+/**
+ * Give the time a span starts at
+ *
+ * @return the current time in nanoseconds, 0 if the tracing isn't enabled
+ */
+static inline uint64_t trace_begin(void) {
+  if (!trace_enabled) {
+    return 0;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Record a span started by "trace_begin", if the tracing is enabled
+ *
+ * @param name the phase, a string literal
+ * @param start the value given by "trace_begin"
+ * @param detail what the span is about, NULL if nothing
+ */
+static inline void trace_end(const char *name, uint64_t start, const char *detail) {
+  if (trace_enabled) {
+    trace_record(name, start, detail);
+  }
+}
+
+#endif
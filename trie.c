@@ -0,0 +1,221 @@
+#include "trie.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_NODES 256
+#define MAX_WORD 4096
+
+int trie_init(struct trie *t) {
+  assert(t);
+  t->nodes = malloc(MIN_NODES * sizeof(struct trie_node));
+  if (t->nodes == NULL) {
+    return -1;
+  }
+  t->cap_nodes = MIN_NODES;
+  trie_clear(t);
+  return 0;
+}
+
+void trie_destroy(struct trie *t) {
+  assert(t);
+  free(t->nodes);
+  t->nodes = NULL;
+  t->n_nodes = t->cap_nodes = 0;
+}
+
+void trie_clear(struct trie *t) {
+  assert(t);
+  memset(&t->nodes[0], 0, sizeof(struct trie_node));
+  t->n_nodes = 1;
+}
+
+/**
+ * Returns the child of a node labelled by "c", if no word ends below it "live" is true
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the index of the child, 0 if there is none
+ */
+static unsigned trie_child(const struct trie *t, unsigned node, unsigned char c, bool live) {
+  unsigned child = t->nodes[node].child;
+  while (child != 0 && t->nodes[child].label < c) {
+    child = t->nodes[child].sibling;
+  }
+  if (child == 0 || t->nodes[child].label != c || (live && t->nodes[child].words == 0)) {
+    return 0;
+  }
+  return child;
+}
+
+/**
+ * Returns the node of a prefix
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the index of the node, 0 for the empty prefix, -1 if no word starts with the prefix
+ */
+static long trie_find(const struct trie *t, const char *prefix, bool live) {
+  unsigned node = 0;
+  for (const unsigned char *s = (const unsigned char *) prefix; *s; ++s) {
+    node = trie_child(t, node, *s, live);
+    if (node == 0) {
+      return -1;
+    }
+  }
+  return node;
+}
+
+/**
+ * Adds "delta" to the number of words of the nodes of a word, root included
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void trie_count(struct trie *t, const char *word, int delta) {
+  unsigned node = 0;
+  t->nodes[0].words += delta;
+  for (const unsigned char *s = (const unsigned char *) word; *s; ++s) {
+    node = trie_child(t, node, *s, false);
+    t->nodes[node].words += delta;
+  }
+}
+
+int trie_insert(struct trie *t, const char *word) {
+  assert(t);
+  assert(word && *word);
+
+  unsigned node = 0;
+  for (const unsigned char *s = (const unsigned char *) word; *s; ++s) {
+    /* looking for the child, or for the sibling after which it is linked */
+    unsigned prev = 0;
+    unsigned child = t->nodes[node].child;
+    while (child != 0 && t->nodes[child].label < *s) {
+      prev = child;
+      child = t->nodes[child].sibling;
+    }
+    if (child != 0 && t->nodes[child].label == *s) {
+      node = child;
+      continue;
+    }
+    if (t->n_nodes == t->cap_nodes) {
+      struct trie_node *bigger = realloc(t->nodes, 2 * t->cap_nodes * sizeof(struct trie_node));
+      if (bigger == NULL) {
+        return -1;
+      }
+      t->nodes = bigger;
+      t->cap_nodes *= 2;
+    }
+    unsigned fresh = t->n_nodes++;
+    t->nodes[fresh].child = 0;
+    t->nodes[fresh].sibling = child;
+    t->nodes[fresh].words = 0;
+    t->nodes[fresh].refs = 0;
+    t->nodes[fresh].label = *s;
+    if (prev == 0) {
+      t->nodes[node].child = fresh;
+    } else {
+      t->nodes[prev].sibling = fresh;
+    }
+    node = fresh;
+  }
+  if (t->nodes[node].refs++ == 0) {
+    trie_count(t, word, 1);
+  }
+  return 0;
+}
+
+void trie_remove(struct trie *t, const char *word) {
+  assert(t);
+  assert(word);
+
+  long node = trie_find(t, word, false);
+  if (node <= 0 || t->nodes[node].refs == 0) {
+    return;
+  }
+  if (--t->nodes[node].refs == 0) {
+    trie_count(t, word, -1);
+  }
+}
+
+size_t trie_complete(const struct trie *t, const char *prefix, char *common, size_t size) {
+  assert(t);
+  assert(prefix);
+
+  long node = trie_find(t, prefix, true);
+  if (node == -1 || t->nodes[node].words == 0) {
+    if (size > 0) {
+      common[0] = '\0';
+    }
+    return 0;
+  }
+  size_t len = strlen(prefix);
+  if (size == 0) {
+    return t->nodes[node].words;
+  }
+  len = len < size - 1 ? len : size - 1;
+  memcpy(common, prefix, len);
+
+  /* going down while a single way leads to all the words */
+  for (unsigned n = node; len + 1 < size && t->nodes[n].refs == 0;) {
+    unsigned next = 0;
+    for (unsigned child = t->nodes[n].child; child != 0; child = t->nodes[child].sibling) {
+      if (t->nodes[child].words == 0) {
+        continue;
+      }
+      if (next != 0) {
+        next = 0;
+        break;
+      }
+      next = child;
+    }
+    if (next == 0) {
+      break;
+    }
+    common[len++] = t->nodes[next].label;
+    n = next;
+  }
+  common[len] = '\0';
+  return t->nodes[node].words;
+}
+
+/**
+ * Calls "fn" on the words of the subtree of "node", "word" holding the prefix of the node
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static void trie_walk(const struct trie *t, unsigned node, char *word, size_t len, size_t max, size_t *count,
+                      void (*fn)(const char *word, void *data), void *data) {
+  if (t->nodes[node].refs > 0 && *count < max) {
+    word[len] = '\0';
+    fn(word, data);
+    ++*count;
+  }
+  if (len + 1 >= MAX_WORD) {
+    return;
+  }
+  for (unsigned child = t->nodes[node].child; child != 0 && *count < max; child = t->nodes[child].sibling) {
+    if (t->nodes[child].words > 0) {
+      word[len] = t->nodes[child].label;
+      trie_walk(t, child, word, len + 1, max, count, fn, data);
+    }
+  }
+}
+
+size_t trie_list(const struct trie *t, const char *prefix, size_t max,
+                 void (*fn)(const char *word, void *data), void *data) {
+  assert(t);
+  assert(prefix);
+  assert(fn);
+
+  long node = trie_find(t, prefix, true);
+  size_t len = strlen(prefix);
+  if (node == -1 || len >= MAX_WORD) {
+    return 0;
+  }
+  char word[MAX_WORD];
+  memcpy(word, prefix, len);
+  size_t count = 0;
+  trie_walk(t, node, word, len, max, &count, fn, data);
+  return count;
+}
@@ -0,0 +1,95 @@
+#ifndef TRIE_H
+#define TRIE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Node of a trie, labelled by one byte of the words
+ */
+struct trie_node {
+  unsigned child;      // first child, 0 if none : the root is never a child
+  unsigned sibling;    // next sibling, 0 if none, the siblings being sorted by label
+  unsigned words;      // number of words ending in the subtree, this node included
+  unsigned refs;       // number of insertions not removed of the word ending here
+  unsigned char label;
+};
+
+/**
+ * Prefix tree of words, in a single array of nodes
+ *
+ * A word may be inserted several times, e.g. once per directory holding it :
+ * it leaves the trie once removed as many times. The nodes of the removed
+ * words are kept, and skipped since no word ends below them anymore.
+ */
+struct trie {
+  struct trie_node *nodes;  // nodes[0] is the root, standing for the empty prefix
+  size_t n_nodes;
+  size_t cap_nodes;
+};
+
+/**
+ * Init a struct trie
+ *
+ * @param t pointer on the struct trie to initialize
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+int trie_init(struct trie *t);
+
+/**
+ * Free everything allocated by a struct trie
+ *
+ * @param t pointer on the struct trie
+ */
+void trie_destroy(struct trie *t);
+
+/**
+ * Remove all the words of a trie, keeping its memory
+ *
+ * @param t pointer on the struct trie
+ */
+void trie_clear(struct trie *t);
+
+/**
+ * Insert a word in a trie
+ *
+ * @param t pointer on the struct trie
+ * @param word the word, not empty
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+int trie_insert(struct trie *t, const char *word);
+
+/**
+ * Remove one insertion of a word from a trie
+ *
+ * @param t pointer on the struct trie
+ * @param word the word, which does nothing if it isn't in the trie
+ */
+void trie_remove(struct trie *t, const char *word);
+
+/**
+ * Count the words starting with a prefix and find their longest common prefix
+ *
+ * @param t pointer on the struct trie
+ * @param prefix the prefix
+ * @param common buffer receiving the longest common prefix of the words, which starts
+ *        with "prefix", truncated to "size" - 1 bytes ; it may be NULL if "size" is 0
+ * @param size size of "common"
+ * @return the number of words starting with "prefix"
+ */
+size_t trie_complete(const struct trie *t, const char *prefix, char *common, size_t size);
+
+/**
+ * Call a function on the words starting with a prefix, in lexicographic order
+ *
+ * @param t pointer on the struct trie
+ * @param prefix the prefix
+ * @param max maximal number of words
+ * @param fn function called with each word and "data"
+ * @param data passed to "fn"
+ * @return the number of calls of "fn"
+ */
+size_t trie_list(const struct trie *t, const char *prefix, size_t max,
+                 void (*fn)(const char *word, void *data), void *data);
+
+#endif
@@ -1,74 +1,159 @@
+#define _GNU_SOURCE
 #include <stddef.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/wait.h>
 
-#define INIT_CAP 10
+#define INIT_CAP 16
 
 #include "util.h"
 
-void pid_list_create(struct pid_list *newlist){
-	assert(newlist);
-	newlist->data = calloc(INIT_CAP, sizeof(pid_t));
-	newlist->size = 0;
-	newlist->capacity = INIT_CAP;
+void job_table_create(struct job_table *table){
+	assert(table);
+	table->slots = calloc(INIT_CAP, sizeof(struct job));
+	table->capacity = INIT_CAP;
+	table->size = 0;
+	table->used = 0;
 }
 
-void pid_list_destroy(struct pid_list *todestroy){
-	assert(todestroy);
-	free(todestroy->data);
-	todestroy->size = 0;
-	todestroy->capacity = -1;
+void job_table_destroy(struct job_table *table){
+	assert(table);
+	free(table->slots);
+	table->slots = NULL;
+	table->size = 0;
+	table->used = 0;
+	table->capacity = 0;
 }
 
 /**
- * adds a pid inside the list of pid
+ * returns the first slot to probe for a pid (Fibonacci hashing : the high bits
+ * of the product are taken, the low ones barely depending on the pid)
  */
-void pid_list_add(struct pid_list *list, pid_t toadd){
-	assert(list);
-	assert(list->size!=list->capacity);
-	list->data[list->size++]=toadd;
-	//if the dataset is full, double the capacity by reallocationg memory
-	if(list->size == list->capacity){
-		pid_t *newdata = calloc(2*list->capacity,sizeof(pid_t));
-		for(size_t i = 0; i<list->size;++i){
-			newdata[i] = list->data[i];
+static size_t job_hash(const struct job_table *table, pid_t pid){
+	return ((uint64_t) pid * 11400714819323198485ULL) >> (64-__builtin_ctzll(table->capacity));
+}
+
+/**
+ * returns the slot holding the pid, NULL if the pid isn't in the table
+ */
+static struct job *job_find(const struct job_table *table, pid_t pid){
+	size_t mask = table->capacity-1;
+	for(size_t i = job_hash(table, pid);table->slots[i].pid!=JOB_FREE;i = (i+1) & mask){
+		if(table->slots[i].pid==pid){
+			return &table->slots[i];
 		}
-		free(list->data);
-		list->data = newdata;
-		list->capacity*=2;
 	}
+	return NULL;
 }
 
 /**
- * returns the index of the pid if the pid is present, else -1
+ * moves the jobs into a new array of slots, dropping the deleted slots
+ * returns 0 on success, -1 on memory allocation failure
  */
-size_t pid_list_contain(struct pid_list *list, pid_t needle){
-	size_t i = 0;
-	while(i<list->size && list->data[i]!=needle){
-		++i;
+static int job_table_rehash(struct job_table *table, size_t capacity){
+	struct job *slots = calloc(capacity, sizeof(struct job));
+	if(slots==NULL){
+		return -1;
 	}
-	return i==list->size ? -1 : i;
+	struct job_table bigger = { slots, capacity, 0, 0 };
+	for(size_t i = 0; i<table->capacity;++i){
+		pid_t pid = table->slots[i].pid;
+		if(pid!=JOB_FREE && pid!=JOB_DELETED){
+			size_t j = job_hash(&bigger, pid);
+			while(slots[j].pid!=JOB_FREE){
+				j = (j+1) & (capacity-1);
+			}
+			slots[j] = table->slots[i];
+			++bigger.size;
+			++bigger.used;
+		}
+	}
+	free(table->slots);
+	*table = bigger;
+	return 0;
 }
 
 /**
- * returns 0 if the pid has been succesfully removed, else -1
+ * adds a pid inside the table of jobs
  */
-int pid_list_remove(struct pid_list *list, pid_t toremove){
-	size_t pos = pid_list_contain(list, toremove);
-	if(pos!=-1){
-		list->data[pos]=list->data[--list->size];
-		return 0;
+int job_table_add(struct job_table *table, pid_t pid){
+	assert(table);
+	assert(pid>0);
+	//keeping at least a quarter of free slots so that probes stay short
+	if(4*(table->used+1) > 3*table->capacity){
+		size_t capacity = 4*(table->size+1) > table->capacity ? 2*table->capacity : table->capacity;
+		if(job_table_rehash(table, capacity)==-1){
+			return -1;
+		}
+	}
+	size_t mask = table->capacity-1;
+	size_t i = job_hash(table, pid);
+	while(table->slots[i].pid!=JOB_FREE && table->slots[i].pid!=JOB_DELETED){
+		i = (i+1) & mask;
+	}
+	if(table->slots[i].pid==JOB_FREE){
+		++table->used;
 	}
-	return -1;
+	table->slots[i].pid = pid;
+	table->slots[i].pidfd = -1;
+	++table->size;
+	return 0;
 }
 
-void pid_list_print(struct pid_list *list){
-	for(size_t i = 0; i<list->size;++i){
-		printf("pid[%li]=%i\n",i,list->data[i]);
+/**
+ * returns true if the pid is in the table
+ */
+bool job_table_contains(const struct job_table *table, pid_t pid){
+	assert(table);
+	return job_find(table, pid)!=NULL;
+}
+
+struct job *job_table_find(const struct job_table *table, pid_t pid){
+	assert(table);
+	return job_find(table, pid);
+}
+
+/**
+ * returns 0 if the pid has been succesfully removed, else -1
+ */
+int job_table_remove(struct job_table *table, pid_t pid){
+	assert(table);
+	struct job *job = job_find(table, pid);
+	if(job==NULL){
+		return -1;
 	}
+	job->pid = JOB_DELETED;
+	--table->size;
+	return 0;
 }
 
+size_t job_table_reap(struct job_table *table, void (*report)(pid_t pid, int wstatus, const struct rusage *usage)){
+	assert(table);
+	int saved_errno = errno;
+	size_t reaped = 0;
+	int wstatus;
+	struct rusage usage;
+	pid_t child;
+	while((child = wait4(-1,&wstatus,WNOHANG,&usage))>0){
+		++reaped;
+		if(job_table_remove(table, child)==0 && report!=NULL){
+			report(child, wstatus, &usage);
+		}
+	}
+	errno = saved_errno;
+	return reaped;
+}
 
+void job_table_print(const struct job_table *table){
+	for(size_t i = 0; i<table->capacity;++i){
+		pid_t pid = table->slots[i].pid;
+		if(pid!=JOB_FREE && pid!=JOB_DELETED){
+			printf("job[%zu]=%i\n",i,pid);
+		}
+	}
+}
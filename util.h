@@ -1,32 +1,75 @@
+#ifndef UTIL_H
+#define UTIL_H
+
 #include <stddef.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 
-struct pid_list {
-  pid_t *data;
-  size_t capacity;
-  size_t size;
+/**
+ * Slot of the job table
+ */
+struct job {
+  pid_t pid; // JOB_FREE or JOB_DELETED if the slot holds no job
+  int pidfd; // pidfd watched by the event loop, -1 if none
+};
+
+#define JOB_FREE 0
+#define JOB_DELETED (-1)
+
+/**
+ * Hash table of the processes running in background, keyed by pid
+ *
+ * Open addressing with linear probing : removing a job only marks its slot as deleted,
+ * so that "job_table_remove" and "job_table_reap" never allocate. The table is only
+ * used by the event loop of FiSH, between two lines : it isn't meant to be touched
+ * from a signal handler.
+ */
+struct job_table {
+  struct job *slots;
+  size_t capacity; // always a power of 2
+  size_t size;     // number of jobs
+  size_t used;     // number of slots not free, deleted ones included
 };
 
-void pid_list_create(struct pid_list *newlist);
+void job_table_create(struct job_table *table);
+
+void job_table_destroy(struct job_table *table);
 
-void pid_list_destroy(struct pid_list *todestroy);
+/**
+ * returns 0 if the pid has been added, -1 on memory allocation failure
+ */
+int job_table_add(struct job_table *table, pid_t pid);
+
+/**
+ * returns true if the pid is in the table
+ */
+bool job_table_contains(const struct job_table *table, pid_t pid);
 
 /**
- * returns 0 if append succesfull, else -1
+ * returns the slot holding the pid, NULL if the pid isn't in the table
+ * the pointer is valid until the next call to "job_table_add"
  */
-void pid_list_add(struct pid_list *list, pid_t toadd);
+struct job *job_table_find(const struct job_table *table, pid_t pid);
 
 /**
- * returns the index of the pid if the pid is present, else -1
+ * returns 0 if the pid has been removed, -1 if it wasn't in the table
  */
-size_t pid_list_contain(struct pid_list *list, pid_t needle);
+int job_table_remove(struct job_table *table, pid_t pid);
 
 /**
- * returns 0 if the pid has been succesfully removed, else -1
+ * Reaps all the terminated children with wait4(-1, WNOHANG), until none is left,
+ * removing them from the table : SIGCHLD signals coalesce, so one signal may stand
+ * for several children
+ *
+ * @param table the job table
+ * @param report function called for each reaped job of the table, with the resources
+ * it used, may be NULL
+ * @return the number of children reaped
  */
-int pid_list_remove(struct pid_list *list, pid_t toremove);
+size_t job_table_reap(struct job_table *table, void (*report)(pid_t pid, int wstatus, const struct rusage *usage));
 
-void pid_list_print(struct pid_list *list);
+void job_table_print(const struct job_table *table);
 
+#endif
@@ -0,0 +1,374 @@
+#define _GNU_SOURCE
+#include "xargs.h"
+#include "events.h"
+#include "spawn.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define READ_CHUNK (1 << 16)
+#define ARG_HEADROOM 2048
+
+extern char **environ;
+
+/**
+ * Command launched by xargs and not waited yet
+ */
+struct worker {
+  pid_t pid;
+  int pidfd; // -1 if pidfds aren't supported
+};
+
+/**
+ * State of xargs : the input read and not run yet, the batch of items being
+ * filled, and the commands running
+ */
+struct xargs {
+  int fd;
+  bool nul;            // the items are separated by '\0', not by blanks and newlines
+  bool eof;
+  char *buf;           // bytes read, "buf[len]" being always available for a '\0'
+  size_t len;
+  size_t cap;
+  size_t pos;          // first byte not split yet
+  size_t *items;       // offsets in "buf" of the items of the batch
+  size_t n_items;
+  size_t cap_items;
+  size_t size;         // bytes taken by the command and the items of the batch
+  char **argv;         // the command, then room for "cap_items" items and the NULL pointer
+  size_t n_cmd;
+  struct worker *workers;
+  size_t n_workers;
+  size_t max_workers;
+  struct path_hash *hash;
+  const sigset_t *mask;
+  int child_input;
+};
+
+/**
+ * Reads the next chunk of the input, once the bytes before the batch are dropped
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 on failure (the reason is printed)
+ */
+static int xargs_fill(struct xargs *x) {
+  size_t drop = x->n_items > 0 ? x->items[0] : x->pos;
+  if (drop > 0) {
+    memmove(x->buf, x->buf + drop, x->len - drop);
+  }
+  x->len -= drop;
+  x->pos -= drop;
+  for (size_t k = 0; k < x->n_items; ++k) {
+    x->items[k] -= drop;
+  }
+  if (x->cap - x->len < READ_CHUNK + 1) {
+    size_t cap = x->cap ? 2 * x->cap : READ_CHUNK + 1;
+    char *bigger = realloc(x->buf, cap);
+    if (bigger == NULL) {
+      fprintf(stderr, "Memory allocation failure\n");
+      return -1;
+    }
+    x->buf = bigger;
+    x->cap = cap;
+  }
+  ssize_t n;
+  while ((n = read(x->fd, x->buf + x->len, x->cap - x->len - 1)) == -1 && errno == EINTR) {
+  }
+  if (n == -1) {
+    perror("xargs");
+    return -1;
+  }
+  x->eof = n == 0;
+  x->len += n;
+  return 0;
+}
+
+/**
+ * Tells whether a byte separates the items
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static inline bool xargs_separator(const struct xargs *x, char c) {
+  return x->nul ? c == '\0' : isspace((unsigned char) c);
+}
+
+/**
+ * Splits the next item of the input in place, by writing a '\0' after it
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @param item set to the offset of the item
+ * @return true if an item is found, false if the input must be read further or is over
+ */
+static bool xargs_next(struct xargs *x, size_t *item) {
+  size_t i = x->pos;
+  while (i < x->len && xargs_separator(x, x->buf[i])) {
+    ++i;
+  }
+  x->pos = i;
+  size_t end = i;
+  while (end < x->len && !xargs_separator(x, x->buf[end])) {
+    ++end;
+  }
+  /* the last item may go on in the bytes not read yet */
+  if (i == x->len || (end == x->len && !x->eof)) {
+    return false;
+  }
+  x->buf[end] = '\0';
+  x->pos = end < x->len ? end + 1 : end;
+  *item = i;
+  return true;
+}
+
+/**
+ * Appends an item to the batch
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return 0 on success, -1 if a memory allocation failure occurs
+ */
+static int xargs_add(struct xargs *x, size_t item, size_t cost) {
+  if (x->n_items == x->cap_items) {
+    size_t cap = x->cap_items ? 2 * x->cap_items : 64;
+    size_t *items = realloc(x->items, cap * sizeof(size_t));
+    if (items != NULL) {
+      x->items = items;
+    }
+    char **argv = realloc(x->argv, (x->n_cmd + cap + 1) * sizeof(char *));
+    if (argv != NULL) {
+      x->argv = argv;
+    }
+    if (items == NULL || argv == NULL) {
+      fprintf(stderr, "Memory allocation failure\n");
+      return -1;
+    }
+    x->cap_items = cap;
+  }
+  x->items[x->n_items++] = item;
+  x->size += cost;
+  return 0;
+}
+
+/**
+ * Returns the number of bytes available for the arguments of a command : ARG_MAX minus
+ * the size of the environment, each string costing its length, its '\0' and its pointer
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static size_t xargs_limit(void) {
+  long arg_max = sysconf(_SC_ARG_MAX);
+  size_t limit = arg_max > 0 ? (size_t) arg_max : 131072;
+  for (char **env = environ; *env != NULL; ++env) {
+    limit -= strlen(*env) + 1 + sizeof(char *);
+  }
+  return limit > ARG_HEADROOM ? limit - ARG_HEADROOM : 0;
+}
+
+/**
+ * Converts the termination status of a command into the exit status of xargs
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ */
+static int xargs_status(int wstatus) {
+  if (WIFSIGNALED(wstatus)) {
+    return 125;
+  }
+  switch (WEXITSTATUS(wstatus)) {
+    case 0:
+      return 0;
+    case 255:
+      return 124;
+    default:
+      return 123;
+  }
+}
+
+/**
+ * Waits for one of the running commands, the first one to terminate when
+ * they all have a pidfd, the oldest one otherwise
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the exit status of xargs for this command
+ */
+static int xargs_wait(struct xargs *x) {
+  struct worker *workers = x->workers;
+  size_t n = x->n_workers;
+  size_t i = 0;
+  bool polled = true;
+  for (size_t j = 0; j < n; ++j) {
+    polled &= workers[j].pidfd != -1;
+  }
+  if (polled && n > 1) {
+    struct pollfd pfds[n];
+    for (size_t j = 0; j < n; ++j) {
+      pfds[j].fd = workers[j].pidfd;
+      pfds[j].events = POLLIN;
+    }
+    while (poll(pfds, n, -1) == -1 && errno == EINTR) {
+    }
+    while (i + 1 < n && pfds[i].revents == 0) {
+      ++i;
+    }
+  }
+  int wstatus = 0;
+  while (waitpid(workers[i].pid, &wstatus, 0) == -1 && errno == EINTR) {
+  }
+  if (workers[i].pidfd != -1) {
+    close(workers[i].pidfd);
+  }
+  /* keeping the oldest commands first */
+  memmove(workers + i, workers + i + 1, (n - i - 1) * sizeof(struct worker));
+  --x->n_workers;
+  return xargs_status(wstatus);
+}
+
+/**
+ * Runs the command with the items of the batch, which is emptied,
+ * once a command is waited for if "max_workers" are running
+ *
+ * This function is static : it means that it is a local function, accessible only in this source file
+ *
+ * @return the exit status of xargs for the command waited for, 0 if none, 127 if the command can't be run
+ */
+static int xargs_launch(struct xargs *x, size_t base) {
+  for (size_t k = 0; k < x->n_items; ++k) {
+    x->argv[x->n_cmd + k] = x->buf + x->items[k];
+  }
+  x->argv[x->n_cmd + x->n_items] = NULL;
+  x->n_items = 0;
+  x->size = base;
+  int status = x->n_workers == x->max_workers ? xargs_wait(x) : 0;
+  fflush(stdout);
+  /* posix_spawn returns once the command has been executed : the items can be overwritten */
+  pid_t pid = spawn_cmd(x->hash, x->argv, x->child_input, 1, NULL, 0, x->mask);
+  if (pid == -1) {
+    return 127;
+  }
+  x->workers[x->n_workers].pid = pid;
+  x->workers[x->n_workers].pidfd = x->max_workers > 1 ? ev_pidfd(pid) : -1;
+  ++x->n_workers;
+  return status;
+}
+
+int xargs_main(char **args, struct path_hash *hash, const sigset_t *mask) {
+  assert(args);
+
+  bool nul = false;
+  size_t max_items = SIZE_MAX;
+  size_t max_workers = 1;
+  const char *file = NULL;
+  size_t i = 1;
+  for (; args[i] && args[i][0] == '-'; ++i) {
+    if (strcmp(args[i], "-0") == 0) {
+      nul = true;
+    } else if (strcmp(args[i], "-n") == 0 && args[i + 1] && atol(args[i + 1]) > 0) {
+      max_items = atol(args[++i]);
+    } else if (strcmp(args[i], "-P") == 0 && args[i + 1] && atol(args[i + 1]) > 0) {
+      max_workers = atol(args[++i]);
+    } else if (strcmp(args[i], "-a") == 0 && args[i + 1]) {
+      file = args[++i];
+    } else {
+      fprintf(stderr, "usage: xargs [-0] [-n max] [-P workers] [-a file] [command [arg...]]\n");
+      return 1;
+    }
+  }
+  char *echo[] = { "echo", NULL };
+  char **cmd = args[i] ? args + i : echo;
+  size_t n_cmd = 0;
+  size_t base = 0;
+  for (; cmd[n_cmd]; ++n_cmd) {
+    base += strlen(cmd[n_cmd]) + 1 + sizeof(char *);
+  }
+  size_t limit = xargs_limit();
+  if (base >= limit) {
+    fprintf(stderr, "xargs: argument list too long\n");
+    return 1;
+  }
+
+  /* the commands read /dev/null rather than the items */
+  struct xargs x = { 0 };
+  x.nul = nul;
+  x.n_cmd = n_cmd;
+  x.size = base;
+  x.max_workers = max_workers;
+  x.hash = hash;
+  x.mask = mask;
+  x.fd = file ? open(file, O_RDONLY | O_CLOEXEC) : 0;
+  if (x.fd == -1) {
+    perror(file);
+    return 1;
+  }
+  x.child_input = file ? 0 : open("/dev/null", O_RDONLY | O_CLOEXEC);
+  x.argv = malloc((n_cmd + 1) * sizeof(char *));
+  x.workers = malloc(max_workers * sizeof(struct worker));
+  int status = 0;
+  if (x.child_input == -1) {
+    perror("/dev/null");
+    status = 1;
+  } else if (x.argv == NULL || x.workers == NULL) {
+    fprintf(stderr, "Memory allocation failure\n");
+    status = 1;
+  } else {
+    memcpy(x.argv, cmd, n_cmd * sizeof(char *));
+  }
+
+  /* a batch runs as soon as it is full, while the input is still being read */
+  while (status < 124 && status != 1) {
+    size_t item = 0;
+    bool found = xargs_next(&x, &item);
+    if (!found && !x.eof) {
+      status = xargs_fill(&x) == -1 ? 1 : status;
+      continue;
+    }
+    size_t cost = found ? strlen(x.buf + item) + 1 + sizeof(char *) : 0;
+    if (x.n_items > 0 && (!found || x.size + cost > limit)) {
+      int s = xargs_launch(&x, base);
+      status = s > status ? s : status;
+    }
+    if (!found || status >= 124) {
+      break;
+    }
+    if (base + cost > limit) {
+      /* even alone, the item wouldn't fit : exec would fail with E2BIG */
+      fprintf(stderr, "xargs: argument list too long\n");
+      status = 1;
+      break;
+    }
+    if (xargs_add(&x, item, cost) == -1) {
+      status = 1;
+    } else if (x.n_items == max_items) {
+      int s = xargs_launch(&x, base);
+      status = s > status ? s : status;
+    }
+  }
+  while (x.n_workers > 0) {
+    int s = xargs_wait(&x);
+    if (status != 127) {
+      status = s > status ? s : status;
+    }
+  }
+
+  if (x.fd != 0) {
+    close(x.fd);
+  }
+  if (x.child_input > 0) {
+    close(x.child_input);
+  }
+  free(x.workers);
+  free(x.argv);
+  free(x.items);
+  free(x.buf);
+  return status;
+}
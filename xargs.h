@@ -0,0 +1,29 @@
+#ifndef XARGS_H
+#define XARGS_H
+
+#include <signal.h>
+
+#include "pathhash.h"
+
+/**
+ * xargs [-0] [-n max] [-P workers] [-a file] [command [arg...]] : runs the command
+ * (echo by default) with the items read on the standard input (or in the file)
+ * as additional arguments
+ *
+ * The items are separated by blanks and newlines, or by '\0' with -0 ; no quoting
+ * is interpreted. They are packed into as few commands as possible, each argument
+ * list fitting in ARG_MAX once the environment is counted, with at most "max" items
+ * per command with -n. Up to "workers" commands run at once (1 by default), launched
+ * by "spawn_cmd" with the command hash table of FiSH. A command starts as soon as
+ * its list is full, while the input is still being read : only the items of the
+ * list being filled are kept in memory.
+ *
+ * @param args the arguments of the internal command, args[0] being "xargs"
+ * @param hash the command hash table
+ * @param mask signal mask of the commands
+ * @return 0 on success, 123 if a command failed, 124 if one exited with status 255,
+ * 125 if one was killed, 127 if the command can't be run, 1 on a usage error
+ */
+int xargs_main(char **args, struct path_hash *hash, const sigset_t *mask);
+
+#endif